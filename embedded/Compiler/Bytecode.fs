@@ -46,6 +46,22 @@ type Instruction =
     | AttachISR | DetachISR
     | Milliseconds
     | PulseIn
+    | Profile
+    | Trace
+    | Yield
+    | Spawn
+    | Kill
+    | Tasks
+    | Every
+    | Cancel
+    | Timing
+    | IsrPin
+    | IsrEvent
+    | EventDelta
+    | Keyframe
+    | Snapshot
+    | Paging
+    | Compact
     | Word of int16 * string
     | User of byte // user defined instruction
     | NoOperation
@@ -292,31 +308,48 @@ let parse source =
    assembled straightforwardly. Quotations have a special case when they contain a single Word.
    In this case, we emit the Word address directly rather than a Quote 1 Word Return; saving a few
    bytes and also making expressions like 'foo setLoop valid for immediate execution (otherwise
-   you'd be setting a temporarily allocated anonymous quotation address as the loop word. *)
+   you'd be setting a temporarily allocated anonymous quotation address as the loop word.
 
-let eagerAssemble dict parsed =
-    let rec assemble' bytecode = function
+   Along with the bytecode, the offsets of a couple of things are marked that can't be told by
+   looking at it afterward: literals that are such quote references rather than numbers, and
+   quotation bodies beginning with a return, which can run no further and so are data (variables,
+   '(return) for example). 'compact' is told of them (see compactDictionary below). *)
+
+type Mark =
+    | Reference   // literal holding a quote reference
+    | Data of int // quotation body used as data (of length)
+
+let assembleMarked dict parsed =
+    let length = List.sumBy List.length
+    let rec assemble' bytecode marks = function
         | Token tok :: t ->
             match findWord tok dict with
             | Some word ->
                 let code = word.Code.Force() |> List.ofSeq
-                assemble' (code :: bytecode) t
+                assemble' (code :: bytecode) marks t
             | None -> sprintf "Unrecognized token: %s" tok |> failwith
         | Address addr :: t ->
             let call = [Word (int16 addr, "")] |> assembleBrief dict
-            assemble' (call :: bytecode) t // TODO: address to name
-        | Number n :: t -> assemble' (assembleBrief dict [Literal n] :: bytecode) t
+            assemble' (call :: bytecode) marks t // TODO: address to name
+        | Number n :: t -> assemble' (assembleBrief dict [Literal n] :: bytecode) marks t
         | Quotation quote :: t ->
-            let q = assemble' [] quote
+            let q, m = assemble' [] [] quote
             match disassembleBrief dict q with
             | [Word (addr, _)] -> // special case for single secondary
-                assemble' (assembleBrief dict [Literal addr] :: bytecode) t // emit address directly
+                let marks' = (length bytecode, Reference) :: marks
+                assemble' (assembleBrief dict [Literal addr] :: bytecode) marks' t // emit address directly
             | _ ->
                 let q' = assembleBrief dict [Quote (1 + Array.length q |> byte)]
                 let ret = assembleBrief dict [Return]
-                assemble' (ret :: (q' @ List.ofArray q) :: bytecode) t
-        | [] -> bytecode |> List.rev |> List.concat |> Array.ofList
-    assemble' [] parsed
+                let body = length bytecode + List.length q'
+                let m' =
+                    if Array.isEmpty q || q.[0] = 0uy then [body, Data (1 + Array.length q)]
+                    else List.map (fun (o, k) -> body + o, k) m
+                assemble' (ret :: (q' @ List.ofArray q) :: bytecode) (m' @ marks) t
+        | [] -> (bytecode |> List.rev |> List.concat |> Array.ofList), List.rev marks
+    assemble' [] [] parsed
+
+let eagerAssemble dict = assembleMarked dict >> fst
 
 let eagerCompile dict = parse >> eagerAssemble dict
 
@@ -346,17 +379,29 @@ let shrink dict addr (code : byte array) =
    To avoid this, as we've talked about in the section covering the dictionary mechanics above, we
    store bytecode in the dictionary as a Lazy<byte array>. Forcing these lazy values causes
    compilation, assembly or IL translation at that moment. We call the compiler/assembler/translator
-   function a 'generator', a unit -> byte array function. *)
+   function a 'generator', a unit -> byte array function.
+
+   Each definition sent down is noted (placed) along with the marks made in assembling it, for
+   'compact' (see compactDictionary below). *)
 
-let lazyGenerate dict generator address pending = lazy (
-    let code, addr, def = generator () |> shrink dict !address
+type Placement = {
+    Address : int                 // where sent down to
+    Length  : int                 // including the Return
+    Marks   : (int * Mark) list } // by offset
+
+let lazyPlace dict generator address pending placed = lazy (
+    let bytecode, marks = generator ()
+    let code, addr, def = bytecode |> shrink dict !address
+    if def.Length > 0 then placed := { Address = !address; Length = def.Length; Marks = marks } :: !placed
     address := addr
     pending := Seq.append !pending def
     code)
 
-let lazyCompile dict source = lazyGenerate dict (fun () -> eagerCompile dict source)
+let lazyGenerate dict generator = lazyPlace dict (fun () -> generator (), [])
+
+let lazyCompile dict source = lazyPlace dict (fun () -> parse source |> assembleMarked dict)
 
-let lazyAssemble dict ast = lazyGenerate dict (fun () -> eagerAssemble dict ast)
+let lazyAssemble dict ast = lazyPlace dict (fun () -> assembleMarked dict ast)
 
 (* Below is a function to initialize a dictionary with mappings for all of the Brief primitives
    as well as a library of useful words which can be thought of as being part of the language.
@@ -365,7 +410,7 @@ let lazyAssemble dict ast = lazyGenerate dict (fun () -> eagerAssemble dict ast)
    relationship). A ref to a Definition list (dict) and the current free address is given and
    will be updated as definitions are reified. *)
 
-let initDictionary dict address pending =
+let initDictionary dict address pending placed =
     let defineBytecode (b, w, c) = define dict (Some b) w None (lazy [|byte c|])
     List.iter defineBytecode
         [Return,                "(return)",              0   //             -  (from return)
@@ -428,9 +473,25 @@ let initDictionary dict address pending =
          AttachISR,             "attachISR",             62  // addr i mode -
          DetachISR,             "detachISR",             63  // i           -
          Milliseconds,          "milliseconds",          64  //             - millis
-         PulseIn,               "pulseIn",               65] // val pin     - duration
-
-    let library (w, d) = lazyCompile dict d address pending |> define dict None w None
+         PulseIn,               "pulseIn",               65  // val pin     - duration
+         Profile,               "profile",               77  // clear       -  (BRIEF_PROFILE builds)
+         Trace,                 "trace",                 78  // arm         -  (BRIEF_TRACE builds)
+         Yield,                 "yield",                 79  //             -  (BRIEF_TASKS, BRIEF_SLICED builds)
+         Spawn,                 "spawn",                 80  // word budget - id
+         Kill,                  "kill",                  81  // id          -
+         Tasks,                 "tasks",                 82  //             -
+         Every,                 "every",                 83  // word period priority - id  (BRIEF_PERIODIC builds)
+         Cancel,                "cancel",                84  // id          -
+         Timing,                "timing",                85  // clear       -
+         IsrPin,                "isrPin",                86  // pin i       -  (BRIEF_DEFERRED builds)
+         IsrEvent,              "isrEvent",              87  //             - value time
+         EventDelta,            "eventDelta",            88  // value channel -  (BRIEF_DELTAS builds)
+         Keyframe,              "keyframe",              89  // channel     -
+         Snapshot,              "snapshot",              90  //             -  (BRIEF_SNAPSHOT builds)
+         Paging,                "paging",                91  // clear       -  (BRIEF_PAGED builds)
+         Compact,               "compact",               92] // into from to table - reclaimed  (BRIEF_COMPACT builds)
+
+    let library (w, d) = lazyCompile dict d address pending placed |> define dict None w None
     List.iter library
         ["square"       , "dup *"
          "cube"         , "dup dup * *"
@@ -509,3 +570,62 @@ let initDictionary dict address pending =
          "either?"      , "[bi@ or]"
          *)
          ]
+
+(* Boards built with BRIEF_ROM (see Brief.h) carry the library in flash at ROM_BASE, rather than
+   being sent it upon first use. Here it is reified there all at once, before anything else has
+   been, giving the image to build into the firmware as rom[]. Library words then compile to calls
+   into ROM and nothing of them goes down to the MCU; definitions made since go to the dictionary
+   as ever. *)
+
+let romLibrary dict address pending romBase =
+    let start = !address
+    address := romBase
+    !dict |> List.rev |> List.iter (fun d -> d.Code.Force() |> ignore)
+    address := start
+    let image = !pending |> Array.ofSeq
+    pending := Seq.empty
+    image
+
+(* Boards built with BRIEF_COMPACT (see Brief.h) take a word out of the midst of the dictionary
+   with 'compact', sliding down all above it. Which spans are code to walk for calls, which are data
+   to leave be and which literals are quote references can't be told on the board by looking, so a
+   relocation table of them is made here from what's been placed (see Brief.cpp for the layout), to
+   be sent as a definition just before the code to run 'compact' (leaving the bytes reclaimed). The
+   same is then done here to the calls reified so far: those into what moved are relocated, those to
+   the word taken out going to the one standing in for it (its redefinition; -1 for none), and the
+   next free address comes down to match.
+
+   Code two bytes or fewer is inlined rather than placed, and may hold a quote reference as an 8-bit
+   literal (to an address beneath 128) that can't be told from a number wherever it's inlined. So
+   nothing beneath 128 is taken out; addresses there never move. *)
+
+let compactDictionary dict address placed into from until =
+    if from < 128 || from >= until || until > !address then failwith "Cannot compact below 128 or beyond the dictionary."
+    let word a = [a >>> 8 |> byte; byte a]
+    let sent = !placed |> List.filter (fun p -> p.Address < !address) |> List.sortBy (fun p -> p.Address) // (not ROM)
+    let spans p =
+        let data = p.Marks |> List.choose (function o, Data n -> Some (p.Address + o, n) | _ -> None) |> List.sort
+        p.Address :: List.collect (fun (a, n) -> [a ||| 0x8000; a + n]) data
+    let references p = p.Marks |> List.choose (function o, Reference -> Some (p.Address + o) | _ -> None)
+    let spans' = List.collect spans sent |> List.filter (fun a -> a &&& 0x7FFF < !address)
+    let table = List.length spans' :: spans' @ List.collect references sent |> List.collect word |> Array.ofList
+    let code = [Literal (int16 into); Literal (int16 from); Literal (int16 until); Literal (int16 !address); Compact]
+    let code' = assembleBrief dict code |> Array.ofList
+    let moved a = if a >= until && a < !address then a - (until - from) else a
+    let relocate a = if a = from && into >= 0 then moved into else moved a
+    let relocateCode (code : byte array) =
+        match code with
+        | [|hi; lo|] when hi &&& 0x80uy <> 0uy -> // call
+            let a = relocate (int (hi &&& 0x7Fuy) <<< 8 ||| int lo)
+            [|byte (a >>> 8) ||| 0x80uy; byte a|]
+        | _ -> code // inlined (no references to move; see above)
+    let relocateDefinition d =
+        if d.Code.IsValueCreated then { d with Code = Lazy<byte array>.CreateFromValue(d.Code.Force() |> relocateCode) }
+        else d // (reified later, at addresses as they'll be by then)
+    let relocatePlacement p = if p.Address >= until && p.Address < !address then [{ p with Address = moved p.Address }]
+                              elif p.Address >= from && p.Address < until then [] // (taken out)
+                              else [p]
+    dict := List.map relocateDefinition !dict
+    placed := List.collect relocatePlacement !placed
+    address := !address - (until - from)
+    code', table
@@ -31,6 +31,7 @@ type Compiler() =
     let dict = ref []
     let address = ref 0
     let pending = ref Seq.empty
+    let placed = ref []
 
     let getPending () =
         let p = !pending |> Array.ofSeq
@@ -38,17 +39,17 @@ type Compiler() =
 
     let token (memb : MemberInfo) = Some (memb.Module.FullyQualifiedName, memb.MetadataToken)
 
-    do initDictionary dict address pending
+    do initDictionary dict address pending placed
 
-    member x.Reset() = dict := []; address := 0; pending := Seq.empty; initDictionary dict address pending
+    member x.Reset() = dict := []; address := 0; pending := Seq.empty; placed := []; initDictionary dict address pending placed
 
     member x.EagerCompile(source) = eagerCompile   dict source, getPending ()
     member x.EagerTranslate(meth) = eagerTranslate dict meth,   getPending ()
     member x.EagerAssemble(ast)   = eagerAssemble  dict ast,    getPending ()
 
-    member x.LazyCompile(source) = lazyCompile   dict source address pending
-    member x.LazyTranslate(meth) = lazyTranslate dict meth   address pending
-    member x.LazyAssemble(ast)   = lazyAssemble  dict ast    address pending
+    member x.LazyCompile(source) = lazyCompile   dict source address pending placed
+    member x.LazyTranslate(meth) = lazyTranslate dict meth   address pending placed
+    member x.LazyAssemble(ast)   = lazyAssemble  dict ast    address pending placed
 
     member x.Reify(lazycode : Lazy<byte array>) = lazycode.Force(), getPending ()
 
@@ -61,6 +62,12 @@ type Compiler() =
 
     member x.Address = !address
 
+    member x.Rom(romBase : int) = romLibrary dict address pending romBase // library image for a BRIEF_ROM board (first thing)
+
+    member x.Compact(into : int, from : int, until : int) = // for a BRIEF_COMPACT board; the relocation table last among the definitions
+        let code, table = compactDictionary dict address placed into from until
+        code, Array.append (getPending ()) table
+
     member x.Disassemble(bytecode) =
         bytecode
         |> disassembleBrief dict
@@ -0,0 +1,304 @@
+/* Arduino.cpp (host)
+
+   Simulated board behind the Arduino.h stand-ins. State is that of the board selected by the
+   calling thread; one per process (just like the real thing) unless host code selects others. */
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include "Simulator.h"
+
+HardwareSerial Serial;
+
+namespace simulator
+{
+    Board process; // the board to begin with
+    thread_local Board* board = &process; // selected
+
+    Board::Board() : eepromMapped(NULL), eepromWrites(0), rxCapacity(0), rxLost(0), txCapacity(0), simulatedTime(false), now(0)
+    {
+        Board* selected = board;
+        board = this;
+        reset();
+        board = selected;
+        memset(eeprom, 0xFF, sizeof(eeprom));
+    }
+
+    Board::~Board()
+    {
+        if (eepromMapped != NULL) munmap(eepromMapped, E2END + 1);
+    }
+
+    void select(Board& b)
+    {
+        board = &b;
+    }
+
+    void reset()
+    {
+        memset(board->modes, 0, sizeof(board->modes));
+        memset(board->digitalIn, 0, sizeof(board->digitalIn));
+        memset(board->digitalOut, 0, sizeof(board->digitalOut));
+        memset(board->analogIn, 0, sizeof(board->analogIn));
+        memset(board->analogOut, 0, sizeof(board->analogOut));
+        memset(board->pulses, 0, sizeof(board->pulses));
+        memset(board->isrs, 0, sizeof(board->isrs));
+        board->rx.clear();
+        board->tx.clear();
+    }
+
+    void setDigital(uint8_t pin, int value)
+    {
+        if (pin < NUM_DIGITAL_PINS) board->digitalIn[pin] = value;
+    }
+
+    void setAnalog(uint8_t pin, int value)
+    {
+        if (pin < NUM_ANALOG_PINS) board->analogIn[pin] = value;
+    }
+
+    void setPulse(uint8_t pin, unsigned long micros)
+    {
+        if (pin < NUM_DIGITAL_PINS) board->pulses[pin] = micros;
+    }
+
+    int mode(uint8_t pin)
+    {
+        return pin < NUM_DIGITAL_PINS ? board->modes[pin] : 0;
+    }
+
+    int digital(uint8_t pin)
+    {
+        return pin < NUM_DIGITAL_PINS ? board->digitalOut[pin] : 0;
+    }
+
+    int analog(uint8_t pin)
+    {
+        return pin < NUM_DIGITAL_PINS ? board->analogOut[pin] : 0;
+    }
+
+    bool attached(uint8_t interrupt)
+    {
+        return interrupt < NUM_INTERRUPTS && board->isrs[interrupt] != NULL;
+    }
+
+    void raise(uint8_t interrupt)
+    {
+        if (attached(interrupt)) board->isrs[interrupt]();
+    }
+
+    void receive(const uint8_t* data, size_t length)
+    {
+        size_t room = board->rxCapacity == 0 ? length : board->rxCapacity - min(board->rx.size(), board->rxCapacity);
+        if (room > length) room = length;
+        board->rx.insert(board->rx.end(), data, data + room);
+        board->rxLost += length - room;
+    }
+
+    std::vector<uint8_t>& transmitted()
+    {
+        return board->tx;
+    }
+
+    bool mapEeprom(const char* path)
+    {
+        int fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0) return false;
+        struct stat st;
+        bool fresh = fstat(fd, &st) == 0 && st.st_size < E2END + 1;
+        if (fresh && ftruncate(fd, E2END + 1) != 0)
+        {
+            close(fd);
+            return false;
+        }
+        void* p = mmap(NULL, E2END + 1, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return false;
+        if (board->eepromMapped != NULL) munmap(board->eepromMapped, E2END + 1);
+        board->eepromMapped = (uint8_t*)p;
+        if (fresh) memset(board->eepromMapped, 0xFF, E2END + 1); // (erased)
+        return true;
+    }
+
+    uint8_t* eeprom()
+    {
+        return board->eepromMapped != NULL ? board->eepromMapped : board->eeprom;
+    }
+
+    void advance(unsigned long micros)
+    {
+        board->simulatedTime = true;
+        board->now += micros;
+    }
+}
+
+using namespace simulator;
+
+// String
+
+void String::getBytes(unsigned char* buf, unsigned int bufsize) const
+{
+    if (bufsize == 0) return;
+    unsigned int n = min(str.length(), bufsize - 1);
+    memcpy(buf, str.data(), n);
+    buf[n] = 0;
+}
+
+// Serial
+
+void HardwareSerial::begin(unsigned long speed) {}
+
+void HardwareSerial::end() {}
+
+int HardwareSerial::available()
+{
+    return board->rx.size();
+}
+
+int HardwareSerial::availableForWrite()
+{
+    if (board->txCapacity == 0) return 64; // never backs up
+    return board->txCapacity - min(board->tx.size(), board->txCapacity);
+}
+
+int HardwareSerial::peek()
+{
+    return board->rx.empty() ? -1 : board->rx.front();
+}
+
+int HardwareSerial::read()
+{
+    if (board->rx.empty()) return -1;
+    int b = board->rx.front();
+    board->rx.pop_front();
+    return b;
+}
+
+size_t HardwareSerial::readBytes(uint8_t* buffer, size_t length)
+{
+    size_t n = min(length, board->rx.size());
+    for (size_t i = 0; i < n; i++) buffer[i] = board->rx[i];
+    board->rx.erase(board->rx.begin(), board->rx.begin() + n);
+    return n;
+}
+
+size_t HardwareSerial::write(uint8_t b)
+{
+    board->tx.push_back(b);
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+    board->tx.insert(board->tx.end(), buffer, buffer + size);
+    return size;
+}
+
+void HardwareSerial::flush() {}
+
+// Time
+
+static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+unsigned long micros()
+{
+    if (board->simulatedTime) return board->now;
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now() - start).count();
+}
+
+unsigned long millis()
+{
+    return micros() / 1000;
+}
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+// Digital and analog I/O
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    if (pin < NUM_DIGITAL_PINS) board->modes[pin] = mode;
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pin < NUM_DIGITAL_PINS && board->digitalIn[pin] ? HIGH : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    if (pin < NUM_DIGITAL_PINS) board->digitalOut[pin] = value;
+}
+
+int analogRead(uint8_t pin)
+{
+    return pin < NUM_ANALOG_PINS ? board->analogIn[pin] : 0;
+}
+
+void analogWrite(uint8_t pin, int value)
+{
+    if (pin < NUM_DIGITAL_PINS) board->analogOut[pin] = value;
+}
+
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout)
+{
+    if (pin >= NUM_DIGITAL_PINS || board->pulses[pin] > timeout) return 0;
+    return board->pulses[pin];
+}
+
+// Interrupts
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode)
+{
+    if (interrupt < NUM_INTERRUPTS) board->isrs[interrupt] = isr;
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+    if (interrupt < NUM_INTERRUPTS) board->isrs[interrupt] = NULL;
+}
+
+void interrupts() {}
+
+void noInterrupts() {}
+
+// EEPROM (avr/eeprom.h); addresses beyond E2END wrap, as on the part
+
+uint8_t eeprom_read_byte(const uint8_t* address)
+{
+    return simulator::eeprom()[(uintptr_t)address & E2END];
+}
+
+void eeprom_update_byte(uint8_t* address, uint8_t value)
+{
+    uint8_t& cell = simulator::eeprom()[(uintptr_t)address & E2END];
+    if (cell == value) return; // (unchanged bytes aren't written)
+    cell = value;
+    board->eepromWrites++;
+}
+
+void eeprom_read_block(void* destination, const void* source, size_t length)
+{
+    for (size_t i = 0; i < length; i++) ((uint8_t*)destination)[i] = eeprom_read_byte((const uint8_t*)source + i);
+}
+
+void eeprom_update_block(const void* source, void* destination, size_t length)
+{
+    for (size_t i = 0; i < length; i++) eeprom_update_byte((uint8_t*)destination + i, ((const uint8_t*)source)[i]);
+}
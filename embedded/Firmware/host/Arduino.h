@@ -0,0 +1,106 @@
+/* Arduino.h (host)
+
+   Stand-ins for the parts of the Arduino core used by the Brief and Reflecta libraries so that the
+   firmware builds and runs as an ordinary PC process. Nothing here talks to real hardware: pins,
+   analog channels, interrupts and the serial port are simulated and may be driven from host code
+   through Simulator.h. */
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define NUM_DIGITAL_PINS 64 // simulated digital pins
+#define NUM_ANALOG_PINS  16 // simulated analog channels
+#define NUM_INTERRUPTS   8  // simulated external interrupts
+#define E2END            0x3FF // last EEPROM address (1KB, as an Uno's; see avr/eeprom.h)
+
+// The Arduino core defines these as macros, which would break the C++ standard headers.
+
+template <typename T, typename U> inline T min(T a, U b) { return a < b ? a : (T)b; }
+template <typename T, typename U> inline T max(T a, U b) { return a > b ? a : (T)b; }
+
+// Just enough of Arduino's String for Reflecta messages
+
+class String
+{
+  public:
+    String(const char* s = "") : str(s) {}
+    String(const std::string& s) : str(s) {}
+
+    unsigned int length() const { return str.length(); }
+    const char* c_str() const { return str.c_str(); }
+    void getBytes(unsigned char* buf, unsigned int bufsize) const;
+
+    bool operator==(const String& other) const { return str == other.str; }
+
+  private:
+    std::string str;
+};
+
+// Serial port; receives whatever the host injects and records everything written
+
+class HardwareSerial
+{
+  public:
+    void begin(unsigned long speed);
+    void end();
+    int available();
+    int availableForWrite();
+    int peek();
+    int read();
+    size_t readBytes(uint8_t* buffer, size_t length);
+    size_t write(uint8_t b);
+    size_t write(const uint8_t* buffer, size_t size);
+    void flush();
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// Program memory (flash on AVR) is ordinary memory here
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+
+// Time (measured from process start)
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Digital and analog I/O
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
+
+// Interrupts
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+void interrupts();
+void noInterrupts();
+
+#endif // ARDUINO_H
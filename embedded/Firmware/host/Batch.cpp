@@ -0,0 +1,313 @@
+/* Batch.cpp (host)
+
+   The lockstep interpreter behind Batch.h. Stack depths, return addresses and the program counter
+   are the same in every lane while in lockstep, so only the cells themselves are vectors. Lanes
+   short of a full group mirror the first lane, so that uniformity is simply all lanes alike. */
+
+#include "Batch.h"
+
+namespace brief
+{
+    extern void (*instructions[MAX_PRIMITIVES])();
+
+    void ret(); void lit8(); void lit16(); void branch(); void zbranch(); void quote();
+    void add(); void sub(); void mul(); void andb(); void orb(); void xorb();
+    void eq(); void neq(); void gt(); void geq(); void lt(); void leq();
+    void notb(); void neg(); void inc(); void dec(); void drop(); void dup(); void swap();
+    void pushr(); void popr(); void peekr(); void choice(); void chooseIf();
+}
+
+namespace batch
+{
+    typedef void (*Instruction)();
+
+    // Instructions done by vector, by number; stepped lane by lane once rebound by the hosting project
+    static const Instruction vectorized[] = {
+        brief::ret, brief::lit8, brief::lit16, brief::branch, brief::zbranch, brief::quote,  // 0-5
+        0, 0, 0, 0, 0, 0, 0, 0, 0,                                                          // 6-14
+        brief::add, brief::sub, brief::mul, 0, 0, brief::andb, brief::orb, brief::xorb, 0,  // 15-23
+        brief::eq, brief::neq, brief::gt, brief::geq, brief::lt, brief::leq,                // 24-29
+        brief::notb, brief::neg, brief::inc, brief::dec, brief::drop, brief::dup, brief::swap, // 30-36
+        0, 0, 0, brief::pushr, brief::popr, brief::peekr,                                   // 37-42
+        0, 0, 0, 0, 0, 0, 0, 0, brief::choice, brief::chooseIf };                           // 43-52
+
+    static inline void splat(Vector& v, brief::Cell x) // every lane x
+    {
+        Vector zero = {};
+        v = zero + x;
+    }
+
+    static inline bool uniform(const Vector& v) // every lane alike?
+    {
+        for (uint8_t k = 1; k < LANES; k++)
+        {
+            if (v[k] != v[0]) return false;
+        }
+        return true;
+    }
+
+    Batch::Batch() : steps(0), laneSteps(0), divergences(0), depth(0), rdepth(0), pc(-1)
+    {
+    }
+
+    void Batch::exec(brief::Machine* const* machines, uint32_t count, int16_t address)
+    {
+        brief::Machine* selected = brief::vm;
+        for (uint32_t i = 0; i < count; i += LANES)
+        {
+            group(machines + i, count - i < LANES ? count - i : LANES, address);
+        }
+        brief::select(*selected);
+    }
+
+    void Batch::group(brief::Machine* const* lanes, uint8_t count, int16_t address)
+    {
+        brief::Machine* first = lanes[0];
+        for (uint8_t l = 0; l < count; l++) // as exec()
+        {
+            brief::Machine* m = lanes[l];
+            m->r = m->rstack;
+            *m->r = -1; // causing run() to fall through upon completion
+            m->p = address;
+            if (m->s != m->dstackCells + (first->s - first->dstackCells))
+            {
+                diverge(lanes, count); // not even starting out alike
+                return;
+            }
+        }
+        gather(lanes, count);
+        const uint8_t* code = first->memory;
+        for (;;)
+        {
+            if (lockstep(code))
+            {
+                steps++;
+                if (pc < 0) // returned from the word
+                {
+                    scatter(lanes, count);
+                    return;
+                }
+            }
+            else
+            {
+                laneSteps++;
+                if (!stepLanes(lanes, count)) return;
+            }
+        }
+    }
+
+    void Batch::gather(brief::Machine* const* lanes, uint8_t count) // machines' state into vectors
+    {
+        for (uint8_t l = 0; l < LANES; l++)
+        {
+            brief::Machine* m = lanes[l < count ? l : 0];
+            for (uint8_t k = 0; k <= DATA_STACK_SIZE; k++) d[k][l] = m->dstackCells[k];
+            for (uint8_t k = 0; k < RETURN_STACK_SIZE; k++) r[k][l] = m->rstack[k];
+        }
+        depth = lanes[0]->s - lanes[0]->dstackCells;
+        rdepth = lanes[0]->r - lanes[0]->rstack + 1;
+        pc = lanes[0]->p;
+    }
+
+    void Batch::scatter(brief::Machine* const* lanes, uint8_t count) // and back again
+    {
+        for (uint8_t l = 0; l < count; l++)
+        {
+            brief::Machine* m = lanes[l];
+            for (uint8_t k = 0; k <= DATA_STACK_SIZE; k++) m->dstackCells[k] = d[k][l];
+            for (uint8_t k = 0; k < RETURN_STACK_SIZE; k++) m->rstack[k] = r[k][l];
+            m->s = m->dstackCells + depth;
+            m->r = m->rstack + rdepth - 1;
+            m->p = pc;
+        }
+    }
+
+    bool Batch::stepLanes(brief::Machine* const* lanes, uint8_t count) // false once no longer in lockstep
+    {
+        scatter(lanes, count);
+        brief::Machine* first = lanes[0];
+        bool alike = true;
+        for (uint8_t l = 0; l < count; l++)
+        {
+            brief::Machine* m = lanes[l];
+            brief::select(*m);
+            brief::step();
+            alike = alike && m->p == first->p && m->s - m->dstackCells == first->s - first->dstackCells &&
+                    m->r - m->rstack == first->r - first->rstack;
+        }
+        if (!alike)
+        {
+            diverge(lanes, count);
+            return false;
+        }
+        if (first->p < 0) return false; // returned from the word (left in the machines)
+        gather(lanes, count);
+        return true;
+    }
+
+    void Batch::diverge(brief::Machine* const* lanes, uint8_t count) // each on its own from here
+    {
+        divergences++;
+        for (uint8_t l = 0; l < count; l++)
+        {
+            brief::Machine* m = lanes[l];
+            if (m->p < 0) continue; // already returned
+            brief::select(*m);
+            brief::run();
+        }
+    }
+
+#define NEED(n) if (depth < (n)) return false
+#define ROOM(n) if (depth + (n) > DATA_STACK_SIZE) return false
+#define RNEED   if (rdepth == 0) return false
+#define RROOM   if (rdepth >= RETURN_STACK_SIZE) return false
+#define UNARY(e)  NEED(1); d[depth] = e; pc++; return true
+#define BINARY(e) NEED(2); depth--; d[depth] = e; pc++; return true
+#define A d[depth]
+#define B d[depth + 1]
+
+    bool Batch::lockstep(const uint8_t* code) // one instruction for all lanes (false if it can't be)
+    {
+        if ((uint16_t)pc >= MEM_SIZE - 2) return false; // operands may run off the end (checked lane by lane)
+        uint8_t i = code[pc];
+        if (i & 0x80) // address to call
+        {
+            if (code[pc + 2] != 0) // not followed by return (TCO)
+            {
+                RROOM;
+                splat(r[rdepth++], pc + 2);
+            }
+            pc = ((i << 8) & 0x7F00) | code[pc + 1];
+            return true;
+        }
+        if (i >= sizeof(vectorized) / sizeof(vectorized[0]) || vectorized[i] == 0 || brief::instructions[i] != vectorized[i])
+        {
+            return false; // (stepped lane by lane; fetches, stores, I/O, events, rebound, etc.)
+        }
+        Vector x;
+        switch (i)
+        {
+            case 0: // ret
+                RNEED;
+                if (!uniform(r[rdepth - 1])) return false;
+                pc = r[--rdepth][0];
+                return true;
+            case 1: // lit8
+                ROOM(1);
+                splat(d[++depth], (int8_t)code[pc + 1]);
+                pc += 2;
+                return true;
+            case 2: // lit16
+                ROOM(1);
+                splat(d[++depth], (int16_t)(code[pc + 1] << 8 | code[pc + 2]));
+                pc += 3;
+                return true;
+            case 3: // branch
+                pc += 1 + (int8_t)code[pc + 1];
+                return true;
+            case 4: // zbranch
+                NEED(1);
+                x = d[depth] == 0;
+                if (!uniform(x)) return false;
+                pc += x[0] ? 1 + (int8_t)code[pc + 1] : 2;
+                depth--;
+                return true;
+            case 5: // quote
+                ROOM(1);
+                splat(d[++depth], pc + 2);
+                pc += 2 + code[pc + 1];
+                return true;
+            case 15: BINARY(A + B); // add
+            case 16: BINARY(A - B); // sub
+            case 17: BINARY(A * B); // mul
+            case 20: BINARY(A & B); // andb
+            case 21: BINARY(A | B); // orb
+            case 22: BINARY(A ^ B); // xorb
+            case 24: BINARY(A == B); // eq (comparisons are -1/0 per lane; boolval)
+            case 25: BINARY(A != B); // neq
+            case 26: BINARY(A > B); // gt
+            case 27: BINARY(A >= B); // geq
+            case 28: BINARY(A < B); // lt
+            case 29: BINARY(A <= B); // leq
+            case 30: UNARY(~A); // notb
+            case 31: UNARY(-A); // neg
+            case 32: UNARY(A + 1); // inc
+            case 33: UNARY(A - 1); // dec
+            case 34: // drop
+                NEED(1);
+                depth--;
+                pc++;
+                return true;
+            case 35: // dup
+                NEED(1);
+                ROOM(1);
+                d[depth + 1] = d[depth];
+                depth++;
+                pc++;
+                return true;
+            case 36: // swap
+                NEED(2);
+                x = d[depth];
+                d[depth] = d[depth - 1];
+                d[depth - 1] = x;
+                pc++;
+                return true;
+            case 40: // pushr
+                NEED(1);
+                RROOM;
+                r[rdepth++] = d[depth--];
+                pc++;
+                return true;
+            case 41: // popr
+                RNEED;
+                ROOM(1);
+                d[++depth] = r[--rdepth];
+                pc++;
+                return true;
+            case 42: // peekr
+                RNEED;
+                ROOM(1);
+                d[++depth] = r[rdepth - 1];
+                pc++;
+                return true;
+            case 51: // choice
+                NEED(3);
+                RROOM;
+                x = d[depth - 2] == 0;
+                x = (x & d[depth]) | (~x & d[depth - 1]); // false or true quotation, per lane
+                if (!uniform(x)) return false;
+                splat(r[rdepth++], pc + 1);
+                pc = x[0];
+                depth -= 3;
+                return true;
+            case 52: // chooseIf
+                NEED(2);
+                x = d[depth - 1] != 0;
+                if (!uniform(x)) return false;
+                if (x[0])
+                {
+                    RROOM;
+                    if (!uniform(d[depth])) return false;
+                    splat(r[rdepth++], pc + 1);
+                    pc = d[depth][0];
+                }
+                else
+                {
+                    pc++;
+                }
+                depth -= 2;
+                return true;
+            default: // fetches, stores, I/O, events, etc.
+                return false;
+        }
+    }
+
+#undef NEED
+#undef ROOM
+#undef RNEED
+#undef RROOM
+#undef UNARY
+#undef BINARY
+#undef A
+#undef B
+}
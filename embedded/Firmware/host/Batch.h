@@ -0,0 +1,61 @@
+/* Batch.h (host)
+
+   Runs a word on many machines at once in lockstep; for simulations running the same dictionary
+   against different inputs. The code is decoded once for a group of LANES machines and their
+   data and return stacks are held as vectors (structure of arrays), so that arithmetic, logic and
+   comparisons cost a single SIMD instruction for the whole group; sixteen 16-bit cells being one
+   AVX2 register (build with SIMD=-mavx2 or -march=native; SSE2 otherwise).
+
+   Comparisons give all bits on or off per lane (exactly Brief's true and false) and so serve as
+   lane masks. Branches (zbranch, choice, chooseIf and returns) go on in lockstep as long as every
+   lane goes the same way. Once they really differ, each machine carries on through the scalar
+   run() alone from there until the word returns.
+
+   Instructions not done by vector (fetches and stores, I/O, events, division, shifts, anything
+   bound by the hosting project, and any stack error) are stepped through lane by lane with
+   brief::step() upon each machine's own state, rejoining lockstep if all end up in the same
+   place.
+
+   Code is read from the first machine's dictionary; the others must hold the same code (their
+   data may differ). Machines need not be in any particular order and groups short of LANES are
+   fine. */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <Brief.h>
+
+namespace batch
+{
+    const uint8_t LANES = 16; // machines per group
+
+    typedef brief::Cell Vector __attribute__((vector_size(LANES * sizeof(brief::Cell)))); // cell per lane
+
+    class Batch
+    {
+      public:
+        Batch();
+
+        void exec(brief::Machine* const* machines, uint32_t count, int16_t address); // as brief::exec() on each
+
+        uint32_t steps; // instructions run once for a whole group
+        uint32_t laneSteps; // instructions stepped lane by lane
+        uint32_t divergences; // groups finished by the scalar run()
+
+      private:
+        Vector d[DATA_STACK_SIZE + 1]; // data stacks (a spare below the bottom, as brief::VM)
+        Vector r[RETURN_STACK_SIZE]; // return stacks
+        uint8_t depth, rdepth; // items on each (the same in every lane in lockstep)
+        int16_t pc;
+
+        void group(brief::Machine* const* lanes, uint8_t count, int16_t address);
+        bool lockstep(const uint8_t* code);
+        void gather(brief::Machine* const* lanes, uint8_t count);
+        void scatter(brief::Machine* const* lanes, uint8_t count);
+        bool stepLanes(brief::Machine* const* lanes, uint8_t count);
+        void diverge(brief::Machine* const* lanes, uint8_t count);
+    };
+}
+
+#endif // BATCH_H
@@ -0,0 +1,694 @@
+/* BriefJit.cpp (host)
+
+   Template JIT from Brief bytecode to x86-64, selected with BRIEF_JIT (host build only; see
+   Brief.h). Brief.cpp calls jitRun() upon each call and exec; once an address has been called
+   JIT_THRESHOLD times, the code reachable from it is translated, instruction by instruction, into
+   native code in mmap'd executable memory and from then on runs natively.
+
+   Compiled code works on the primary machine's own stacks and memory (other machines are only ever
+   interpreted); the data and return stack pointers live in registers (rbx and r13) while running. Every instruction checks the same preconditions the
+   interpreter does; when one doesn't hold (and for anything not translated) the native frames are
+   abandoned and run() carries on from that very instruction, which then behaves exactly as it
+   always has, errors and all. This is also how unsupported instructions fall back to run().
+
+   Calls between compiled words are native calls. The return address is pushed to the Brief return
+   stack as well, so the two never disagree, and a compiled word returns the address popped by its
+   'ret' in eax; the caller checks this is where it expects to continue (leaving to run() if code
+   has juggled the return stack). Calls to words not (yet) compiled leave to run() likewise. Bound
+   primitives (analogRead, events, user instructions, ...) are called through instructions[] with
+   the VM state synced; call, choice and chooseIf continue natively if their target is compiled.
+
+   Stores into compiled code (memory tracked per byte) flush all compiled code; the store itself is
+   left to run() (via memset), as are forget, reset and rebinding instructions. Flushing while
+   compiled code is still on the native stack only drops the bookkeeping; the buffer is reused once
+   everything has returned.
+
+   Registers:  rbx  data stack pointer (top cell)       r12  memory
+               r13  return stack pointer (top cell)     r14  last data stack cell
+               rbp  dispatch count (BRIEF_BENCH)        r15  first data stack cell */
+
+#include <Arduino.h>
+#include <Brief.h>
+
+#ifdef BRIEF_JIT
+
+#if !defined(__x86_64__) || !defined(__GNUC__)
+#error BRIEF_JIT targets x86-64 hosts (GCC or Clang)
+#endif
+
+#include <string.h>
+#include <sys/mman.h>
+#include <initializer_list>
+#include <vector>
+
+#define JIT_BUFFER (1 << 20) // bytes of executable memory
+
+namespace brief
+{
+    // VM internals (Brief.cpp); compiled code addresses the primary machine directly
+
+    uint8_t* const memory = primary.memory;
+    int16_t* const dstackCells = primary.dstackCells;
+    int16_t* const rstack = primary.rstack;
+    int16_t*& s = primary.s;
+    int16_t*& r = primary.r;
+    int16_t& p = primary.p;
+    int16_t& here = primary.here;
+    int16_t& locals = primary.locals;
+    extern void (*instructions[MAX_PRIMITIVES])();
+    uint8_t length(uint8_t i);
+
+    void ret(); void lit8(); void lit16(); void branch(); void zbranch(); void quote();
+    void fetch8(); void store8(); void fetch16(); void store16();
+    void add(); void sub(); void mul(); void andb(); void orb(); void xorb();
+    void eq(); void neq(); void gt(); void geq(); void lt(); void leq();
+    void notb(); void neg(); void inc(); void dec(); void drop(); void dup(); void swap();
+    void pushr(); void popr(); void peekr(); void local(); void localFetch16(); void localStore16();
+    void call(); void choice(); void chooseIf();
+
+    void* natives[MEM_SIZE]; // compiled code by address
+    uint16_t heat[MEM_SIZE]; // calls by address (up to JIT_THRESHOLD)
+    uint8_t jitBytes[MEM_SIZE / 8]; // bit per address; compiled
+    uint32_t jitEpoch = 0; // bumped upon each flush
+    void* jitFrame = 0; // native stack upon entering compiled code
+    int jitDepth = 0; // nested entries (bound primitives may exec)
+
+    uint8_t* buffer = 0; // executable memory
+    uint8_t* at; // emitting here
+    uint8_t* top; // end of code in use
+    uint8_t* header; // end of enter/deopt stubs (compiled code follows)
+    void (*enter)(void* native);
+    uint8_t* deopt; // leave to run() at edi
+    uint8_t* deoptKeep; // leave to run() at p (already set)
+    bool pendingReset = false; // buffer to be reused once nothing compiled is running
+
+    // Emitting machine code
+
+    void emit(std::initializer_list<uint8_t> bytes)
+    {
+        for (const uint8_t* b = bytes.begin(); b != bytes.end(); b++) *at++ = *b;
+    }
+
+    void emit16(uint16_t x) { memcpy(at, &x, 2); at += 2; }
+    void emit32(uint32_t x) { memcpy(at, &x, 4); at += 4; }
+    void emit64(const void* x) { memcpy(at, &x, 8); at += 8; }
+
+    void patch(uint8_t* rel32, uint8_t* target)
+    {
+        int32_t x = target - (rel32 + 4);
+        memcpy(rel32, &x, 4);
+    }
+
+    void movRax(const void* x) { emit({ 0x48, 0xB8 }); emit64(x); } // mov rax, imm64
+
+    struct Fixup
+    {
+        uint8_t* rel32;
+        int16_t pc; // label, or value for p when leaving
+    };
+
+    std::vector<Fixup> jumps; // to labels within the word being compiled
+    std::vector<Fixup> stubs; // leaving to run()
+    uint8_t* labels[MEM_SIZE];
+
+    void leaveIf(uint8_t cc, int16_t pc) // jcc leaving to run() at pc
+    {
+        emit({ 0x0F, cc });
+        Fixup f = { at, pc };
+        stubs.push_back(f);
+        emit32(0);
+    }
+
+    void leaveKeepIf(uint8_t cc) // jcc leaving to run() at p as already set
+    {
+        emit({ 0x0F, cc });
+        emit32(0);
+        patch(at - 4, deoptKeep);
+    }
+
+    void jumpTo(int16_t pc) // jmp to label
+    {
+        emit({ 0xE9 });
+        Fixup f = { at, pc };
+        jumps.push_back(f);
+        emit32(0);
+    }
+
+    void jumpIf(uint8_t cc, int16_t pc) // jcc to label
+    {
+        emit({ 0x0F, cc });
+        Fixup f = { at, pc };
+        jumps.push_back(f);
+        emit32(0);
+    }
+
+#define JB  0x82
+#define JAE 0x83
+#define JE  0x84
+#define JNE 0x85
+#define JA  0x87
+
+    void need(int16_t n, int16_t pc) // n items on the data stack
+    {
+        if (n == 1)
+        {
+            emit({ 0x4C, 0x39, 0xFB }); // cmp rbx, r15
+        }
+        else
+        {
+            emit({ 0x48, 0x8D, 0x43, (uint8_t)(-2 * (n - 1)) }); // lea rax, [rbx - 2(n-1)]
+            emit({ 0x4C, 0x39, 0xF8 }); // cmp rax, r15
+        }
+        leaveIf(JB, pc);
+    }
+
+    void room(int16_t pc) // space to push one item
+    {
+        emit({ 0x48, 0x8D, 0x43, 0x02 }); // lea rax, [rbx + 2]
+        emit({ 0x4C, 0x39, 0xF0 }); // cmp rax, r14
+        leaveIf(JA, pc);
+    }
+
+    void rneed(int16_t pc) // item on the return stack
+    {
+        movRax(rstack);
+        emit({ 0x49, 0x39, 0xC5 }); // cmp r13, rax
+        leaveIf(JB, pc);
+    }
+
+    void rroom(int16_t pc) // space to push one return stack item
+    {
+        movRax(rstack + RETURN_STACK_SIZE - 1);
+        emit({ 0x49, 0x39, 0xC5 }); // cmp r13, rax
+        leaveIf(JAE, pc);
+    }
+
+    void address(uint8_t bytes, int16_t pc) // eax (zero extended) must index memory
+    {
+        emit({ 0x3D }); emit32(MEM_SIZE - bytes + 1); // cmp eax, imm32
+        leaveIf(JAE, pc);
+    }
+
+    void notCompiled(uint8_t bytes, int16_t pc) // bytes at eax aren't compiled code
+    {
+        emit({ 0x48, 0xBA }); emit64(jitBytes); // mov rdx, jitBytes
+        emit({ 0x0F, 0xA3, 0x02 }); // bt [rdx], eax
+        leaveIf(JB, pc);
+        if (bytes == 2)
+        {
+            emit({ 0x8D, 0x48, 0x01 }); // lea ecx, [rax + 1]
+            emit({ 0x0F, 0xA3, 0x0A }); // bt [rdx], ecx
+            leaveIf(JB, pc);
+        }
+    }
+
+    void push16(int16_t x) // push constant
+    {
+        emit({ 0x48, 0x83, 0xC3, 0x02 }); // add rbx, 2
+        emit({ 0x66, 0xC7, 0x03 }); emit16(x); // mov word [rbx], imm16
+    }
+
+    void binary(int16_t pc) // ax = TOS, popped; [rbx] = NOS
+    {
+        need(2, pc);
+        emit({ 0x66, 0x8B, 0x03 }); // mov ax, [rbx]
+        emit({ 0x48, 0x83, 0xEB, 0x02 }); // sub rbx, 2
+    }
+
+    void compare(uint8_t setcc, int16_t pc)
+    {
+        binary(pc);
+        emit({ 0x66, 0x39, 0x03 }); // cmp [rbx], ax
+        emit({ 0x0F, setcc, 0xC0 }); // setcc al
+        emit({ 0x0F, 0xB6, 0xC0 }); // movzx eax, al
+        emit({ 0xF7, 0xD8 }); // neg eax
+        emit({ 0x66, 0x89, 0x03 }); // mov [rbx], ax
+    }
+
+    void fetch16At(int16_t pc) // [rbx] = memory[eax] (16-bit, big endian)
+    {
+        address(2, pc);
+        emit({ 0x66, 0x41, 0x8B, 0x0C, 0x04 }); // mov cx, [r12 + rax]
+        emit({ 0x66, 0xC1, 0xC1, 0x08 }); // rol cx, 8
+        emit({ 0x66, 0x89, 0x0B }); // mov [rbx], cx
+    }
+
+    void store16At(int16_t pc) // memory[eax] = NOS (16-bit, big endian); pop both
+    {
+        address(2, pc);
+        notCompiled(2, pc);
+        emit({ 0x66, 0x8B, 0x4B, 0xFE }); // mov cx, [rbx - 2]
+        emit({ 0x66, 0xC1, 0xC1, 0x08 }); // rol cx, 8
+        emit({ 0x66, 0x41, 0x89, 0x0C, 0x04 }); // mov [r12 + rax], cx
+        emit({ 0x48, 0x83, 0xEB, 0x04 }); // sub rbx, 4
+    }
+
+    void localAddress() // eax = locals + TOS (zero extended)
+    {
+        movRax(&locals);
+        emit({ 0x0F, 0xB7, 0x00 }); // movzx eax, word [rax]
+        emit({ 0x66, 0x03, 0x03 }); // add ax, [rbx]
+        emit({ 0x0F, 0xB7, 0xC0 }); // movzx eax, ax
+    }
+
+    void* lookup(int16_t address); // (below)
+
+    void callNative(int16_t resume, bool tail) // native call to rax, returning to resume
+    {
+        if (tail)
+        {
+            emit({ 0x48, 0x83, 0xC4, 0x08 }); // add rsp, 8
+            emit({ 0xFF, 0xE0 }); // jmp rax
+        }
+        else
+        {
+            emit({ 0xFF, 0xD0 }); // call rax
+            emit({ 0x3D }); emit32(resume); // cmp eax, resume
+            emit({ 0x74, 0x07 }); // je (continue)
+            emit({ 0x89, 0xC7 }); // mov edi, eax
+            emit({ 0xE9 }); emit32(0); patch(at - 4, deopt); // leave to run() at eax
+        }
+    }
+
+    void staticCall(int16_t target, int16_t resume, bool tail, int16_t pc)
+    {
+        if (!tail)
+        {
+            rroom(pc);
+            emit({ 0x49, 0x83, 0xC5, 0x02 }); // add r13, 2
+            emit({ 0x66, 0x41, 0xC7, 0x45, 0x00 }); emit16(resume); // mov word [r13], resume
+        }
+        movRax(&natives[target]);
+        emit({ 0x48, 0x8B, 0x00 }); // mov rax, [rax]
+        emit({ 0x48, 0x85, 0xC0 }); // test rax, rax
+        emit({ 0x75, 0x1A }); // jnz (compiled)
+        emit({ 0xBF }); emit32(target); // mov edi, target
+        movRax((void*)lookup);
+        emit({ 0xFF, 0xD0 }); // call rax
+        emit({ 0x48, 0x85, 0xC0 }); // test rax, rax
+        leaveIf(JE, target); // not compiled; run() carries on as if called
+        callNative(resume, tail);
+    }
+
+    void trampoline(uint8_t i, int16_t pc, int16_t next) // call bound function through instructions[]
+    {
+        movRax(&s); emit({ 0x48, 0x89, 0x18 }); // mov [s], rbx
+        movRax(&r); emit({ 0x4C, 0x89, 0x28 }); // mov [r], r13
+        movRax(&p); emit({ 0x66, 0xC7, 0x00 }); emit16(pc + 1); // mov word [p], pc + 1
+        movRax(&instructions[i]); emit({ 0xFF, 0x10 }); // call [rax]
+        movRax(&s); emit({ 0x48, 0x8B, 0x18 }); // mov rbx, [s]
+        movRax(&r); emit({ 0x4C, 0x8B, 0x28 }); // mov r13, [r]
+        movRax(&jitEpoch); emit({ 0x81, 0x38 }); emit32(jitEpoch); // cmp dword [epoch], current
+        leaveKeepIf(JNE); // flushed (maybe this very code)
+        movRax(&p); emit({ 0x0F, 0xBF, 0x00 }); // movsx eax, word [p]
+        emit({ 0x3D }); emit32(next); // cmp eax, next
+        uint8_t* done = at + 2;
+        emit({ 0x74, 0x00 }); // je (continue)
+        void (*f)() = instructions[i];
+        if (f == call || f == choice || f == chooseIf) // called; carry on natively if compiled
+        {
+            emit({ 0x89, 0xC7 }); // mov edi, eax
+            movRax((void*)lookup);
+            emit({ 0xFF, 0xD0 }); // call rax
+            emit({ 0x48, 0x85, 0xC0 }); // test rax, rax
+            leaveKeepIf(JE);
+            callNative(next, false);
+        }
+        else
+        {
+            emit({ 0xE9 }); emit32(0); patch(at - 4, deoptKeep);
+        }
+        done[-1] = at - done;
+    }
+
+    bool reached[MEM_SIZE];
+    int16_t compiling; // start of the word being compiled
+
+    void mark(int16_t address)
+    {
+        jitBytes[address >> 3] |= 1 << (address & 7);
+    }
+
+    bool instruction(int16_t pc, int16_t* fall) // emit instruction at pc; *fall is the fall through (or -1)
+    {
+        uint8_t i = memory[pc];
+        *fall = pc + length(i);
+#ifdef BRIEF_BENCH
+        emit({ 0xFF, 0xC5 }); // inc ebp
+#endif
+        if (i & 0x80) // call
+        {
+            int16_t target = ((i << 8) & 0x7F00) | memory[pc + 1];
+            bool tail = memory[pc + 2] == 0;
+            if (tail) *fall = -1;
+            if (tail && target == compiling) jumpTo(target); // tail call to self
+            else staticCall(target, pc + 2, tail, pc);
+            return true;
+        }
+
+        void (*f)() = instructions[i];
+        int8_t operand = pc + 1 < MEM_SIZE ? memory[pc + 1] : 0;
+        if (f == ret && i == 0)
+        {
+            rneed(pc);
+            emit({ 0x41, 0x0F, 0xBF, 0x45, 0x00 }); // movsx eax, word [r13]
+            emit({ 0x49, 0x83, 0xED, 0x02 }); // sub r13, 2
+            emit({ 0x48, 0x83, 0xC4, 0x08 }); // add rsp, 8
+            emit({ 0xC3 }); // ret
+            *fall = -1;
+        }
+        else if (f == lit8 && i == 1) { room(pc); push16(operand); }
+        else if (f == lit16 && i == 2) { room(pc); push16(memory[pc + 1] << 8 | memory[pc + 2]); }
+        else if (f == branch && i == 3) { *fall = -1; jumpTo(pc + 1 + operand); }
+        else if (f == zbranch && i == 4)
+        {
+            need(1, pc);
+            emit({ 0x66, 0x8B, 0x03 }); // mov ax, [rbx]
+            emit({ 0x48, 0x83, 0xEB, 0x02 }); // sub rbx, 2
+            emit({ 0x66, 0x85, 0xC0 }); // test ax, ax
+            jumpIf(JE, pc + 1 + operand);
+        }
+        else if (f == quote && i == 5)
+        {
+            room(pc);
+            push16(pc + 2);
+            *fall = pc + 2 + (uint8_t)operand;
+        }
+        else if (f == fetch8)
+        {
+            need(1, pc);
+            emit({ 0x0F, 0xB7, 0x03 }); // movzx eax, word [rbx]
+            address(1, pc);
+            emit({ 0x41, 0x0F, 0xB6, 0x04, 0x04 }); // movzx eax, byte [r12 + rax]
+            emit({ 0x66, 0x89, 0x03 }); // mov [rbx], ax
+        }
+        else if (f == store8)
+        {
+            need(2, pc);
+            emit({ 0x0F, 0xB7, 0x03 }); // movzx eax, word [rbx]
+            address(1, pc);
+            notCompiled(1, pc);
+            emit({ 0x66, 0x8B, 0x4B, 0xFE }); // mov cx, [rbx - 2]
+            emit({ 0x41, 0x88, 0x0C, 0x04 }); // mov [r12 + rax], cl
+            emit({ 0x48, 0x83, 0xEB, 0x04 }); // sub rbx, 4
+        }
+        else if (f == fetch16)
+        {
+            need(1, pc);
+            emit({ 0x0F, 0xB7, 0x03 }); // movzx eax, word [rbx]
+            fetch16At(pc);
+        }
+        else if (f == store16)
+        {
+            need(2, pc);
+            emit({ 0x0F, 0xB7, 0x03 }); // movzx eax, word [rbx]
+            store16At(pc);
+        }
+        else if (f == add)  { binary(pc); emit({ 0x66, 0x01, 0x03 }); } // add [rbx], ax
+        else if (f == sub)  { binary(pc); emit({ 0x66, 0x29, 0x03 }); } // sub [rbx], ax
+        else if (f == andb) { binary(pc); emit({ 0x66, 0x21, 0x03 }); } // and [rbx], ax
+        else if (f == orb)  { binary(pc); emit({ 0x66, 0x09, 0x03 }); } // or [rbx], ax
+        else if (f == xorb) { binary(pc); emit({ 0x66, 0x31, 0x03 }); } // xor [rbx], ax
+        else if (f == mul)
+        {
+            binary(pc);
+            emit({ 0x66, 0x0F, 0xAF, 0x03 }); // imul ax, [rbx]
+            emit({ 0x66, 0x89, 0x03 }); // mov [rbx], ax
+        }
+        else if (f == eq)  compare(0x94, pc); // sete
+        else if (f == neq) compare(0x95, pc); // setne
+        else if (f == gt)  compare(0x9F, pc); // setg
+        else if (f == geq) compare(0x9D, pc); // setge
+        else if (f == lt)  compare(0x9C, pc); // setl
+        else if (f == leq) compare(0x9E, pc); // setle
+        else if (f == notb) { need(1, pc); emit({ 0x66, 0xF7, 0x13 }); } // not word [rbx]
+        else if (f == neg)  { need(1, pc); emit({ 0x66, 0xF7, 0x1B }); } // neg word [rbx]
+        else if (f == inc)  { need(1, pc); emit({ 0x66, 0xFF, 0x03 }); } // inc word [rbx]
+        else if (f == dec)  { need(1, pc); emit({ 0x66, 0xFF, 0x0B }); } // dec word [rbx]
+        else if (f == drop) { need(1, pc); emit({ 0x48, 0x83, 0xEB, 0x02 }); } // sub rbx, 2
+        else if (f == dup)
+        {
+            need(1, pc);
+            room(pc);
+            emit({ 0x66, 0x8B, 0x03 }); // mov ax, [rbx]
+            emit({ 0x48, 0x83, 0xC3, 0x02 }); // add rbx, 2
+            emit({ 0x66, 0x89, 0x03 }); // mov [rbx], ax
+        }
+        else if (f == swap)
+        {
+            need(2, pc);
+            emit({ 0x66, 0x8B, 0x03 }); // mov ax, [rbx]
+            emit({ 0x66, 0x8B, 0x4B, 0xFE }); // mov cx, [rbx - 2]
+            emit({ 0x66, 0x89, 0x0B }); // mov [rbx], cx
+            emit({ 0x66, 0x89, 0x43, 0xFE }); // mov [rbx - 2], ax
+        }
+        else if (f == pushr)
+        {
+            need(1, pc);
+            rroom(pc);
+            emit({ 0x66, 0x8B, 0x03 }); // mov ax, [rbx]
+            emit({ 0x48, 0x83, 0xEB, 0x02 }); // sub rbx, 2
+            emit({ 0x49, 0x83, 0xC5, 0x02 }); // add r13, 2
+            emit({ 0x66, 0x41, 0x89, 0x45, 0x00 }); // mov [r13], ax
+        }
+        else if (f == popr || f == peekr)
+        {
+            rneed(pc);
+            room(pc);
+            emit({ 0x66, 0x41, 0x8B, 0x45, 0x00 }); // mov ax, [r13]
+            if (f == popr) emit({ 0x49, 0x83, 0xED, 0x02 }); // sub r13, 2
+            emit({ 0x48, 0x83, 0xC3, 0x02 }); // add rbx, 2
+            emit({ 0x66, 0x89, 0x03 }); // mov [rbx], ax
+        }
+        else if (f == local)
+        {
+            need(1, pc);
+            movRax(&locals);
+            emit({ 0x66, 0x8B, 0x00 }); // mov ax, [rax]
+            emit({ 0x66, 0x01, 0x03 }); // add [rbx], ax
+        }
+        else if (f == localFetch16)
+        {
+            need(1, pc);
+            localAddress();
+            fetch16At(pc);
+        }
+        else if (f == localStore16)
+        {
+            need(2, pc);
+            localAddress();
+            store16At(pc);
+        }
+        else if (length(i) == 1) // anything else through the table
+        {
+            trampoline(i, pc, pc + 1);
+        }
+        else
+        {
+            return false; // unknown operands
+        }
+        return true;
+    }
+
+    bool reachable(int16_t start, int16_t* count) // mark instructions reachable from start
+    {
+        std::vector<int16_t> work(1, start);
+        *count = 0;
+        while (!work.empty())
+        {
+            int16_t pc = work.back();
+            work.pop_back();
+            if (pc < 0 || pc >= here || reached[pc]) continue;
+            uint8_t i = memory[pc];
+            int16_t len = length(i);
+            if (pc + len + ((i & 0x80) ? 1 : 0) > here) continue; // (calls look at the next byte)
+            reached[pc] = true;
+            (*count)++;
+            for (int16_t a = pc; a < pc + len + ((i & 0x80) ? 1 : 0); a++) mark(a);
+            int8_t operand = memory[pc + 1];
+            if (i & 0x80)
+            {
+                if (memory[pc + 2] != 0) work.push_back(pc + 2); // (TCO otherwise)
+            }
+            else if (i == 0 && instructions[i] == ret) continue;
+            else if (i == 3 && instructions[i] == branch) work.push_back(pc + 1 + operand);
+            else if (i == 4 && instructions[i] == zbranch)
+            {
+                work.push_back(pc + 1 + operand);
+                work.push_back(pc + 2);
+            }
+            else if (i == 5 && instructions[i] == quote) work.push_back(pc + 2 + (uint8_t)operand);
+            else work.push_back(pc + len);
+        }
+        return *count > 0;
+    }
+
+    void flushNow() // forget all compiled code
+    {
+        memset(natives, 0, sizeof(natives));
+        memset(heat, 0, sizeof(heat));
+        memset(jitBytes, 0, sizeof(jitBytes));
+        jitEpoch++;
+        if (jitDepth == 0) top = header;
+        else pendingReset = true;
+    }
+
+    void* compile(int16_t start)
+    {
+        memset(reached, 0, sizeof(reached));
+        memset(labels, 0, sizeof(labels));
+        int16_t count;
+        if (!reachable(start, &count)) return 0;
+        if (top + 256 * count + 64 > buffer + JIT_BUFFER) // full
+        {
+            if (jitDepth > 0) return 0;
+            flushNow(); // (dropped marks too)
+            memset(reached, 0, sizeof(reached));
+            memset(labels, 0, sizeof(labels));
+            reachable(start, &count);
+        }
+
+        at = top;
+        compiling = start;
+        jumps.clear();
+        stubs.clear();
+        uint8_t* native = at;
+        emit({ 0x48, 0x83, 0xEC, 0x08 }); // sub rsp, 8 (keeping native calls aligned)
+        int16_t first = 0;
+        while (!reached[first]) first++;
+        if (first != start) jumpTo(start);
+        for (int16_t pc = first; pc < here; pc++)
+        {
+            if (!reached[pc]) continue;
+            labels[pc] = at;
+            int16_t fall;
+            if (!instruction(pc, &fall))
+            {
+                at = labels[pc];
+                emit({ 0xBF }); emit32(pc); // mov edi, pc
+                emit({ 0xE9 }); emit32(0); patch(at - 4, deopt);
+                continue;
+            }
+            int16_t next = pc + 1;
+            while (next < here && !reached[next]) next++;
+            if (fall >= 0 && fall != next) jumpTo(fall);
+        }
+        for (size_t j = 0; j < jumps.size(); j++)
+        {
+            int16_t pc = jumps[j].pc;
+            if (pc >= 0 && pc < MEM_SIZE && reached[pc] && labels[pc] != 0)
+            {
+                patch(jumps[j].rel32, labels[pc]);
+            }
+            else
+            {
+                Fixup f = { jumps[j].rel32, pc };
+                stubs.push_back(f);
+            }
+        }
+        for (size_t j = 0; j < stubs.size(); j++) // leaving to run() at pc
+        {
+            patch(stubs[j].rel32, at);
+            emit({ 0xBF }); emit32(stubs[j].pc); // mov edi, pc
+            emit({ 0xE9 }); emit32(0); patch(at - 4, deopt);
+        }
+        top = at;
+        natives[start] = native;
+        return native;
+    }
+
+    void* lookup(int16_t address) // compiled code for address (compiling once hot enough)
+    {
+        if ((uint16_t)address >= MEM_SIZE) return 0;
+        void* native = natives[address];
+        if (native == 0 && heat[address] < JIT_THRESHOLD && ++heat[address] == JIT_THRESHOLD)
+        {
+            native = compile(address);
+            if (native == 0 && jitDepth > 0) heat[address]--; // try again later
+        }
+        return native;
+    }
+
+    void init() // executable memory and the enter/leave stubs at its start
+    {
+        buffer = (uint8_t*)mmap(0, JIT_BUFFER, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer == MAP_FAILED)
+        {
+            buffer = 0;
+            return;
+        }
+        at = buffer;
+
+        enter = (void (*)(void*))at;
+        emit({ 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 }); // push rbx, rbp, r12-r15
+        movRax(&jitFrame);
+        emit({ 0xFF, 0x30 }); // push [rax] (outer frame, when nested)
+        emit({ 0x48, 0x89, 0x20 }); // mov [rax], rsp
+        movRax(&s); emit({ 0x48, 0x8B, 0x18 }); // mov rbx, [s]
+        movRax(&r); emit({ 0x4C, 0x8B, 0x28 }); // mov r13, [r]
+        emit({ 0x49, 0xBC }); emit64(memory); // mov r12, memory
+        emit({ 0x49, 0xBE }); emit64(dstackCells + DATA_STACK_SIZE); // mov r14, last cell
+        emit({ 0x49, 0xBF }); emit64(dstackCells + 1); // mov r15, first cell
+        emit({ 0x31, 0xED }); // xor ebp, ebp
+        emit({ 0xFF, 0xD7 }); // call rdi
+        emit({ 0x89, 0xC7 }); // mov edi, eax (returned; carry on from there)
+
+        deopt = at;
+        movRax(&p); emit({ 0x66, 0x89, 0x38 }); // mov [p], di
+        movRax(&s); emit({ 0x48, 0x89, 0x18 }); // mov [s], rbx
+        movRax(&r); emit({ 0x4C, 0x89, 0x28 }); // mov [r], r13
+#ifdef BRIEF_BENCH
+        movRax(&dispatches); emit({ 0x01, 0x28 }); // add [dispatches], ebp
+#endif
+        movRax(&jitFrame);
+        emit({ 0x48, 0x8B, 0x20 }); // mov rsp, [rax] (abandoning native frames)
+        emit({ 0x8F, 0x00 }); // pop [rax]
+        emit({ 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B }); // pop r15-r12, rbp, rbx
+        emit({ 0xC3 }); // ret
+
+        deoptKeep = at;
+        movRax(&p); emit({ 0x0F, 0xBF, 0x38 }); // movsx edi, word [p]
+        emit({ 0xE9 }); emit32(0); patch(at - 4, deopt);
+
+        header = top = at;
+    }
+
+#undef JB
+#undef JAE
+#undef JE
+#undef JNE
+#undef JA
+
+    // Hooks (Brief.cpp)
+
+    void jitRun() // run compiled code at p if there is (or now should be) some; p left where it ends
+    {
+        if (vm != &primary) return;
+        if (buffer == 0)
+        {
+            init();
+            if (buffer == 0) return;
+        }
+        void* native = lookup(p);
+        if (native == 0) return;
+        jitDepth++;
+        enter(native);
+        if (--jitDepth == 0 && pendingReset)
+        {
+            top = header;
+            pendingReset = false;
+        }
+    }
+
+    bool jitCode(int16_t address) // is address within compiled code?
+    {
+        return vm == &primary && (uint16_t)address < MEM_SIZE && (jitBytes[address >> 3] >> (address & 7)) & 1;
+    }
+
+    void jitFlush()
+    {
+        if (buffer != 0) flushNow();
+    }
+}
+
+#endif // BRIEF_JIT
@@ -0,0 +1,210 @@
+/* Farm.cpp (host)
+
+   Instances and the work-stealing pool behind Farm.h. */
+
+#include <Arduino.h>
+#include <string.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "Farm.h"
+
+namespace farm
+{
+    // Instances
+
+    thread_local Instance* current = 0; // selected by the calling thread
+
+    void deliver(uint8_t* event, uint16_t length) // (machine's sendEvent)
+    {
+        if (length > 0 && event[0] == VM_EVENT_ID) current->errors++;
+        if (current->event != 0) current->event(*current, event, length);
+    }
+
+    Instance::Instance() : event(0), context(0), errors(0)
+    {
+        machine.sendEvent = deliver;
+    }
+
+    void Instance::select()
+    {
+        brief::select(machine);
+        simulator::select(board);
+        current = this;
+    }
+
+    void Instance::load(const uint8_t* image, int16_t length)
+    {
+        if (length < 0 || length > MEM_SIZE) length = 0;
+        memcpy(machine.memory, image, length);
+        machine.here = machine.last = length;
+    }
+
+    void Instance::exec(int16_t address)
+    {
+        select();
+        brief::exec(address);
+    }
+
+    void Instance::loop(unsigned long micros)
+    {
+        select();
+        brief::loop();
+        simulator::advance(micros);
+    }
+
+    // Pool
+
+    struct Farm::Pool
+    {
+        std::mutex lock; // guards the below
+        std::condition_variable started; // new generation (or stopping)
+        std::condition_variable finished; // busy reached zero
+        uint32_t generation; // bumped by each run()
+        unsigned busy; // workers yet to finish this generation
+        bool stopping;
+        Job job;
+        void* context;
+    };
+
+    struct Farm::Worker
+    {
+        std::thread thread;
+        std::mutex lock; // guards begin/end (thieves take from the end)
+        uint32_t begin, end; // indices yet to run
+        unsigned index;
+    };
+
+    thread_local unsigned self = 0; // index of the calling worker
+
+    Farm::Farm(unsigned threads) : pool(new Pool)
+    {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+        pool->generation = 0;
+        pool->busy = 0;
+        pool->stopping = false;
+        pool->job = 0;
+        pool->context = 0;
+
+        // Lazily built shared state (the threaded core's dispatch table) is built here, once, on
+        // a machine of our own before any worker runs.
+        brief::Machine* selected = brief::vm;
+        brief::Machine scratch; // (memory zeroed; a lone 'ret')
+        brief::select(scratch);
+        brief::exec(0);
+        brief::select(*selected);
+
+        for (unsigned i = 0; i < threads; i++)
+        {
+            Worker* w = new Worker;
+            w->begin = w->end = 0;
+            w->index = i;
+            workers.push_back(w);
+        }
+        for (unsigned i = 0; i < threads; i++)
+        {
+            workers[i]->thread = std::thread(&Farm::serve, this, workers[i]);
+        }
+    }
+
+    Farm::~Farm()
+    {
+        {
+            std::lock_guard<std::mutex> guard(pool->lock);
+            pool->stopping = true;
+        }
+        pool->started.notify_all();
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            workers[i]->thread.join();
+            delete workers[i];
+        }
+        delete pool;
+    }
+
+    unsigned Farm::worker()
+    {
+        return self;
+    }
+
+    void Farm::run(uint32_t count, Job job, void* context)
+    {
+        uint32_t n = workers.size();
+        for (uint32_t i = 0; i < n; i++) // equal shares to begin with
+        {
+            std::lock_guard<std::mutex> guard(workers[i]->lock);
+            workers[i]->begin = (uint64_t)count * i / n;
+            workers[i]->end = (uint64_t)count * (i + 1) / n;
+        }
+        std::unique_lock<std::mutex> guard(pool->lock);
+        pool->job = job;
+        pool->context = context;
+        pool->busy = n;
+        pool->generation++;
+        pool->started.notify_all();
+        while (pool->busy > 0) pool->finished.wait(guard);
+    }
+
+    void Farm::serve(Worker* w) // worker thread
+    {
+        self = w->index;
+        uint32_t generation = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> guard(pool->lock);
+                while (!pool->stopping && pool->generation == generation) pool->started.wait(guard);
+                if (pool->stopping) return;
+                generation = pool->generation;
+            }
+            work(w);
+            std::lock_guard<std::mutex> guard(pool->lock);
+            if (--pool->busy == 0) pool->finished.notify_all();
+        }
+    }
+
+    void Farm::work(Worker* w)
+    {
+        Job job = pool->job; // (set before the generation was bumped)
+        void* context = pool->context;
+        uint32_t index;
+        while (take(w, &index) || steal(w, &index))
+        {
+            job(index, context);
+        }
+    }
+
+    bool Farm::take(Worker* w, uint32_t* index) // from the front of our own share
+    {
+        std::lock_guard<std::mutex> guard(w->lock);
+        if (w->begin == w->end) return false;
+        *index = w->begin++;
+        return true;
+    }
+
+    bool Farm::steal(Worker* w, uint32_t* index) // back half of another's share
+    {
+        uint32_t n = workers.size();
+        for (uint32_t k = 1; k < n; k++)
+        {
+            Worker* victim = workers[(w->index + k) % n];
+            uint32_t begin, end;
+            {
+                std::lock_guard<std::mutex> guard(victim->lock);
+                uint32_t left = victim->end - victim->begin;
+                if (left == 0) continue;
+                begin = victim->end - (left + 1) / 2;
+                end = victim->end;
+                victim->end = begin;
+            }
+            // (one lock at a time; thieves may be stealing from each other)
+            std::lock_guard<std::mutex> guard(w->lock);
+            *index = begin;
+            w->begin = begin + 1;
+            w->end = end;
+            return true;
+        }
+        return false; // nothing left anywhere (or only in flight to another thief)
+    }
+}
@@ -0,0 +1,83 @@
+/* Farm.h (host)
+
+   Runs many isolated Brief machines at once across all cores; for parameter sweeps and Monte-Carlo
+   runs of control programs against simulated plants. The VM must be built with BRIEF_THREADS (see
+   Brief.h) and brief::setup() called (binding the instructions) before any farming.
+
+   An Instance is a machine along with the simulated board it runs on; its own pins, analog
+   channels, interrupts, serial port and clock. Instances share nothing and any number may run at
+   once, one per thread at a time. Events the machine sends up (VM errors included) go to the
+   instance's event handler rather than through Reflecta.
+
+   A Farm runs a job for each index of a range on a pool of worker threads. Typically a job builds
+   an Instance, loads a dictionary image, sets parameters from its index, ticks loop() against a
+   plant model and leaves its result in a slot of its own (or accumulates into a slot per worker;
+   see Farm::worker()), so that gathering results takes no locking at all.
+
+   Scheduling is by work stealing. Each worker begins with an equal share of the range and takes
+   indices one at a time from the front of its own share; a worker running dry steals the back half
+   of another's. Jobs of very different lengths (diverging simulations) thus keep every core busy,
+   while workers only ever contend when stealing. */
+
+#ifndef FARM_H
+#define FARM_H
+
+#include <stdint.h>
+#include <vector>
+#include <Brief.h>
+#include "Simulator.h"
+
+#ifndef BRIEF_THREADS
+#error Farm.h needs the VM built with BRIEF_THREADS
+#endif
+
+namespace farm
+{
+    class Instance // a machine and the simulated board it runs on
+    {
+      public:
+        Instance();
+
+        void load(const uint8_t* image, int16_t length); // dictionary image (as the PC built it)
+        void exec(int16_t address); // run word to completion
+        void loop(unsigned long micros); // one loop() tick, then simulated time moves along
+        void select(); // make this the calling thread's machine and board (the above do so)
+
+        brief::Machine machine;
+        simulator::Board board;
+
+        void (*event)(Instance& instance, const uint8_t* payload, uint16_t length); // (if set)
+        void* context; // for use by the event handler
+        uint32_t errors; // VM error events sent up
+    };
+
+    class Farm
+    {
+      public:
+        typedef void (*Job)(uint32_t index, void* context);
+
+        explicit Farm(unsigned threads = 0); // 0 for one per core
+        ~Farm();
+
+        void run(uint32_t count, Job job, void* context); // job(i) for i in [0, count); returns when all are done
+        unsigned threads() const { return workers.size(); }
+        static unsigned worker(); // index of the calling worker thread (0 on any other)
+
+      private:
+        struct Pool; // (see Farm.cpp)
+        struct Worker;
+
+        Pool* pool;
+        std::vector<Worker*> workers;
+
+        void serve(Worker* self);
+        void work(Worker* self);
+        bool take(Worker* self, uint32_t* index);
+        bool steal(Worker* self, uint32_t* index);
+
+        Farm(const Farm&); // (not copyable)
+        Farm& operator=(const Farm&);
+    };
+}
+
+#endif // FARM_H
@@ -0,0 +1,229 @@
+/* ReflectaHost.cpp
+
+   See ReflectaHost.h. SLIP constants match ReflectaFramesSerial.cpp. */
+
+#include <deque>
+#include <Brief.h>
+#include "ReflectaHost.h"
+#include "Simulator.h"
+
+#define END            0xC0
+#define ESCAPE         0xDB
+#define ESCAPED_END    0xDC
+#define ESCAPED_ESCAPE 0xDD
+
+namespace reflectaHost
+{
+    uint8_t writeSequence = 0;
+    std::deque<std::vector<uint8_t> > unbatched; // events from a batch not yet taken
+
+    void reset()
+    {
+        writeSequence = 0;
+        unbatched.clear();
+    }
+
+    void writeEscaped(std::vector<uint8_t>& out, uint8_t b)
+    {
+        switch (b)
+        {
+            case END:
+                out.push_back(ESCAPE);
+                out.push_back(ESCAPED_END);
+                break;
+            case ESCAPE:
+                out.push_back(ESCAPE);
+                out.push_back(ESCAPED_ESCAPE);
+                break;
+            default:
+                out.push_back(b);
+                break;
+        }
+    }
+
+    void sendFrame(const uint8_t* frame, size_t frameLength)
+    {
+        sendFrame(++writeSequence, frame, frameLength); // MCU expects the first frame to be 1
+    }
+
+    void sendFrame(uint8_t sequence, const uint8_t* frame, size_t frameLength)
+    {
+        std::vector<uint8_t> out;
+        uint8_t checksum = sequence;
+        writeEscaped(out, sequence);
+        for (size_t i = 0; i < frameLength; i++)
+        {
+            writeEscaped(out, frame[i]);
+            checksum ^= frame[i];
+        }
+        writeEscaped(out, checksum);
+        out.push_back(END);
+        simulator::receive(&out[0], out.size());
+    }
+
+    bool receiveFrame(std::vector<uint8_t>& frame)
+    {
+        std::vector<uint8_t>& tx = simulator::transmitted();
+        size_t start = 0;
+        while (start < tx.size())
+        {
+            size_t end = start;
+            while (end < tx.size() && tx[end] != END) end++;
+            if (end == tx.size()) break; // incomplete
+
+            frame.clear();
+            uint8_t checksum = 0;
+            bool escaped = false;
+            for (size_t i = start; i < end; i++)
+            {
+                uint8_t b = tx[i];
+                if (escaped)
+                {
+                    b = b == ESCAPED_END ? END : ESCAPE;
+                    escaped = false;
+                }
+                else if (b == ESCAPE)
+                {
+                    escaped = true;
+                    continue;
+                }
+                frame.push_back(b);
+                checksum ^= b;
+            }
+            start = end + 1;
+
+            if (frame.size() >= 2 && checksum == 0)
+            {
+                frame.pop_back(); // checksum
+                frame.erase(frame.begin()); // sequence
+                tx.erase(tx.begin(), tx.begin() + start);
+                return true;
+            }
+        }
+        tx.erase(tx.begin(), tx.begin() + start);
+        return false;
+    }
+
+    bool receiveEvent(std::vector<uint8_t>& event)
+    {
+        while (unbatched.empty())
+        {
+            if (!receiveFrame(event)) return false;
+            if (event.empty() || event[0] != BATCH_EVENT_ID) return true;
+            for (size_t i = 1; i + 2 <= event.size(); i += 2 + event[i + 1]) // ID, length, data
+            {
+                size_t end = i + 2 + event[i + 1];
+                if (end > event.size()) break; // (truncated)
+                std::vector<uint8_t> e(event.begin() + i + 1, event.begin() + end);
+                e[0] = event[i]; // (ID over length)
+                unbatched.push_back(e);
+            }
+        }
+        event = unbatched.front();
+        unbatched.pop_front();
+        return true;
+    }
+
+    Deltas::Deltas() : keyframes(0)
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            previous[i] = 0;
+            synced[i] = false;
+        }
+    }
+
+    bool Deltas::next(const std::vector<uint8_t>& event, size_t& at, uint8_t channel, int16_t& value)
+    {
+        uint32_t u = 0;
+        for (int shift = 0; ; shift += 7) // varint
+        {
+            if (at >= event.size() || shift > 14) return false;
+            uint8_t b = event[at++];
+            u |= (uint32_t)(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) break;
+        }
+        bool key = u & 1;
+        uint16_t z = u >> 1;
+        int16_t d = (int16_t)(z >> 1 ^ -(z & 1)); // zigzag
+        if (key)
+        {
+            keyframes++;
+            previous[channel] = d;
+            synced[channel] = true;
+        }
+        else
+        {
+            previous[channel] = (int16_t)(previous[channel] + d); // (wrapping, as sent)
+        }
+        value = previous[channel];
+        return synced[channel];
+    }
+
+    Reliable::Reliable(uint8_t window, unsigned long timeout, unsigned long perByte)
+        : sent(0), resent(0), timeouts(0), inFlight(0), everSent(0), window(window), timeout(timeout),
+          perByte(perByte), progress(0), owed(0)
+    {
+    }
+
+    void Reliable::sending()
+    {
+        owed = 0;
+        for (size_t i = 0; i < inFlight; i++) owed += (unacknowledged[i].data.size() + 3) * perByte; // (sequence, checksum, END)
+    }
+
+    void Reliable::queue(const uint8_t* frame, size_t frameLength)
+    {
+        Frame f;
+        f.sequence = ++writeSequence;
+        f.data.assign(frame, frame + frameLength);
+        unacknowledged.push_back(f);
+    }
+
+    void Reliable::service(unsigned long now)
+    {
+        if (inFlight == 0) progress = now; // (nothing awaiting acknowledgement)
+        else if (now - progress >= timeout + owed)
+        {
+            inFlight = 0;
+            progress = now;
+            timeouts++;
+        }
+        while (inFlight < window && inFlight < unacknowledged.size())
+        {
+            const Frame& f = unacknowledged[inFlight++];
+            sendFrame(f.sequence, f.data.empty() ? 0 : &f.data[0], f.data.size());
+            sent++;
+            if (inFlight <= everSent) resent++;
+            else everSent = inFlight;
+        }
+        sending();
+    }
+
+    bool Reliable::acknowledged(const std::vector<uint8_t>& frame, unsigned long now)
+    {
+        if (frame.size() < 3 || frame[0] != FRAMES_ACK) return false;
+        if (frame[2] > 0 && frame[2] < window) window = frame[2];
+        if (unacknowledged.empty()) return true;
+        uint8_t taken = frame[1] - (uint8_t)(unacknowledged.front().sequence - 1); // (wrapping)
+        if (taken > 0 && taken <= everSent)
+        {
+            unacknowledged.erase(unacknowledged.begin(), unacknowledged.begin() + taken);
+            inFlight = inFlight > taken ? inFlight - taken : 0;
+            everSent -= taken;
+            progress = now;
+            sending();
+        }
+        else if (taken == 0 && inFlight > 0) // dropping those after a gap; from the first again
+        {
+            inFlight = 0;
+            progress = now;
+        }
+        return true;
+    }
+
+    bool Reliable::done() const
+    {
+        return unacknowledged.empty();
+    }
+}
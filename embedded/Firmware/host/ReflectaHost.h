@@ -0,0 +1,93 @@
+/* ReflectaHost.h
+
+   The PC end of Reflecta framing, talking to the firmware through the simulated serial port. This
+   is what the .NET ReflectaClient does over a real port: frames going down are sequenced,
+   checksummed and SLIP escaped; frames coming up are unescaped and checked. */
+
+#ifndef REFLECTA_HOST_H
+#define REFLECTA_HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <vector>
+#include <ReflectaFramesSerial.h>
+
+namespace reflectaHost
+{
+    void reset(); // zero the sequence numbers (as does reflectaFrames::reset())
+
+    // Send a frame to the MCU; delivered upon the next reflectaFrames::loop()
+    void sendFrame(const uint8_t* frame, size_t frameLength);
+
+    // Send a frame with the given sequence number (one sent before, to send it again), leaving the
+    // sequence numbers of those to come as they are
+    void sendFrame(uint8_t sequence, const uint8_t* frame, size_t frameLength);
+
+    // Take the next complete frame sent up by the MCU (payload only; sequence and checksum
+    // stripped). Returns false when there is none. Frames failing the checksum are skipped.
+    bool receiveFrame(std::vector<uint8_t>& frame);
+
+    // Take the next event sent up by the MCU; as receiveFrame, but unpacking events coalesced into
+    // one frame (BATCH_EVENT_ID; see flushEvents() in Brief.cpp) into each in turn.
+    bool receiveEvent(std::vector<uint8_t>& event);
+
+    // Values sent with 'eventDelta' (BRIEF_DELTAS; see Brief.cpp), reconstructed channel by channel
+    class Deltas
+    {
+      public:
+        Deltas();
+
+        // Read the sample at 'at' within an event (moving past it) as the given channel's next;
+        // false if truncated, or if the channel is yet to see a keyframe (value not known)
+        bool next(const std::vector<uint8_t>& event, size_t& at, uint8_t channel, int16_t& value);
+
+        uint32_t keyframes; // samples that were keyframes
+
+      private:
+        int16_t previous[256];
+        bool synced[256];
+    };
+
+    // Frames sent to an MCU built with FRAMES_RELIABLE (see ReflectaFramesSerial.h), up to a window of
+    // them ahead of acknowledgement. Upon a repeated acknowledgement (the MCU dropping frames after a
+    // gap), or none for 'timeout' microseconds (and 'perByte' more for each byte of those in flight,
+    // long frames taking a while to go down), those unacknowledged are sent again, from the first.
+    // Once one is constructed, frames go down through it alone.
+    class Reliable
+    {
+      public:
+        Reliable(uint8_t window = FRAMES_WINDOW, unsigned long timeout = 100000, unsigned long perByte = 0);
+
+        void queue(const uint8_t* frame, size_t frameLength); // to be sent in turn
+
+        // Send what the window allows by now (microseconds), first sending again if it's time to
+        void service(unsigned long now);
+
+        // Deal with a frame sent up; false if it's not an acknowledgement
+        bool acknowledged(const std::vector<uint8_t>& frame, unsigned long now);
+
+        bool done() const; // every frame queued acknowledged
+
+        uint32_t sent; // frames sent (counting those sent again)
+        uint32_t resent; // frames sent again
+        uint32_t timeouts; // times gone back for want of acknowledgement
+
+      private:
+        struct Frame
+        {
+            uint8_t sequence;
+            std::vector<uint8_t> data;
+        };
+        std::deque<Frame> unacknowledged; // queued, in sequence
+        size_t inFlight; // of those, sent (since last going back)
+        size_t everSent; // of those, sent at least once
+        uint8_t window; // least of ours and the MCU's
+        unsigned long timeout, perByte, progress; // microseconds; when last acknowledged (or gone back)
+        unsigned long owed; // microseconds (perByte) for those in flight
+
+        void sending(); // owed for those in flight
+    };
+}
+
+#endif // REFLECTA_HOST_H
@@ -0,0 +1,84 @@
+/* Simulator.h
+
+   Host-side controls for the simulated board behind the Arduino.h stand-ins. Host code uses these
+   to play the part of the outside world: setting input pins and analog channels, raising
+   interrupts, feeding bytes to the serial port and collecting whatever the firmware sends.
+
+   There is one board per process to begin with. Host code simulating several (see Farm.h) gives
+   each its own Board and selects it; the Arduino functions and the controls below act upon the
+   board selected by the calling thread. */
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <vector>
+#include <Arduino.h>
+
+namespace simulator
+{
+    struct Board // state of one simulated board
+    {
+        uint8_t modes[NUM_DIGITAL_PINS];
+        int digitalIn[NUM_DIGITAL_PINS];
+        int digitalOut[NUM_DIGITAL_PINS];
+        int analogIn[NUM_ANALOG_PINS];
+        int analogOut[NUM_DIGITAL_PINS];
+        unsigned long pulses[NUM_DIGITAL_PINS];
+        void (*isrs[NUM_INTERRUPTS])();
+        uint8_t eeprom[E2END + 1]; // (erased to 0xFF; kept over reset, as on the board)
+        uint8_t* eepromMapped; // EEPROM in a file instead, if mapped (see mapEeprom)
+        unsigned long eepromWrites; // bytes written (changed) so far; some 3.3ms each on AVR
+
+        std::deque<uint8_t> rx; // PC -> MCU
+        std::vector<uint8_t> tx; // MCU -> PC
+        size_t rxCapacity; // serial receive buffer (bytes arriving beyond it are lost; 0 for no limit)
+        unsigned long rxLost; // bytes lost so far
+        size_t txCapacity; // serial transmit buffer (bytes sent the host has yet to take; 0 for no limit)
+
+        bool simulatedTime; // millis/micros from 'now' rather than the process clock
+        unsigned long now; // microseconds (see advance)
+
+        Board();
+        ~Board();
+    };
+
+    void select(Board& board); // act upon this board from now on (calling thread only)
+
+    void reset(); // all pins low, channels zero, interrupts detached, serial buffers empty
+
+    // Inputs seen by digitalRead/analogRead/pulseIn
+
+    void setDigital(uint8_t pin, int value);
+    void setAnalog(uint8_t pin, int value);
+    void setPulse(uint8_t pin, unsigned long micros);
+
+    // Outputs left by pinMode/digitalWrite/analogWrite
+
+    int mode(uint8_t pin);
+    int digital(uint8_t pin);
+    int analog(uint8_t pin);
+
+    // Interrupts attached with attachInterrupt
+
+    bool attached(uint8_t interrupt);
+    void raise(uint8_t interrupt); // call the ISR (if any) as the hardware would
+
+    // Serial port
+
+    void receive(const uint8_t* data, size_t length); // bytes arriving from the PC (see rxCapacity)
+    std::vector<uint8_t>& transmitted(); // bytes sent to the PC (host may consume/clear; see txCapacity)
+
+    // EEPROM seen by eeprom_read_block/eeprom_update_block (avr/eeprom.h)
+
+    bool mapEeprom(const char* path); // keep EEPROM in a file (created erased), surviving the process
+    uint8_t* eeprom(); // E2END + 1 bytes, wherever they are
+
+    // Simulated time
+
+    void advance(unsigned long micros); // switch millis/micros to simulated time, moving it along
+}
+
+#endif // SIMULATOR_H
@@ -0,0 +1,288 @@
+/* aot.cpp
+
+   Ahead-of-time translator from a Brief dictionary image to C++ (see BRIEF_AOT in Brief.h).
+
+   The image is the dictionary as the PC has built it; the raw bytes from address 0 up to 'here'.
+   Given the entry points wanted natively (the loop word, words the PC execs, ...), each becomes a
+   C++ function, along with every word they call and every quotation they push (potentially called
+   by 'call', 'choice' or 'if'). Instructions become calls to the very same primitives Brief.cpp
+   binds; literals, branches and calls become plain C++. Calls between translated words are native
+   calls; anything else (dynamic calls to words not translated, code running off the image) goes
+   through callWord(), which interprets when there's nothing compiled.
+
+   The generated source carries the image itself, loaded into the dictionary upon setup, and the
+   table of compiled words by which exec() and calls from interpreted code find them. Link it into
+   the firmware (or host) build with BRIEF_AOT defined.
+
+     brief-aot [-f] image entry ... > words.cpp
+
+   Entries are addresses (decimal or 0x hex). Pass -f when the image came from a BRIEF_FUSED build;
+   fused instructions (66-76) are then translated as the pairs they stand for. Otherwise
+   instructions above the built-ins are taken to be custom and called through instructions[]. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const char* primitives[] = { // bound in brief::setup() (6 up; 0-5 and 50-52 are translated)
+        0, 0, 0, 0, 0, 0,
+        "eventHeader", "eventBody8", "eventBody16", "eventFooter", "eventOp",
+        "fetch8", "store8", "fetch16", "store16",
+        "add", "sub", "mul", "div", "mod", "andb", "orb", "xorb", "shift",
+        "eq", "neq", "gt", "geq", "lt", "leq",
+        "notb", "neg", "inc", "dec",
+        "drop", "dup", "swap", "pick", "roll", "clr",
+        "pushr", "popr", "peekr",
+        "forget", "alloc", "free", "tail", "local", "localFetch16", "localStore16",
+        0, 0, 0, "loopTicks", "setLoop", "stopLoop", "resetBoard",
+        "pinMode", "digitalRead", "digitalWrite", "analogRead", "analogWrite",
+        "attachISR", "detachISR", "milliseconds", "pulseIn" };
+
+    const int BUILT_INS = sizeof(primitives) / sizeof(primitives[0]);
+
+    const uint8_t unfused[] = { 1, 1, 35, 47, 47, 24, 25, 26, 27, 28, 29 }; // first of each pair (66-76)
+
+    std::vector<uint8_t> image;
+    bool fused = false;
+
+    int size() { return image.size(); }
+
+    uint8_t opcode(int pc) // instruction at pc (fused instructions as the first of their pair)
+    {
+        uint8_t i = image[pc];
+        if (fused && i >= 66 && i <= 76) return unfused[i - 66];
+        return i;
+    }
+
+    int length(uint8_t i) // bytes taken by instruction or call
+    {
+        if ((i & 0x80) || i == 1 || (i >= 3 && i <= 5)) return 2; // call, lit8, branch, zbranch, quote
+        return i == 2 ? 3 : 1; // lit16 or otherwise no operands
+    }
+
+    int target(int pc) { return ((image[pc] << 8) & 0x7F00) | image[pc + 1]; } // of call at pc
+    int relative(int pc) { return pc + 1 + (int8_t)image[pc + 1]; } // of branch at pc
+
+    bool decodable(int pc) // whole instruction (and the byte following a call) within the image
+    {
+        uint8_t i = opcode(pc);
+        return pc >= 0 && pc + length(i) + ((i & 0x80) ? 1 : 0) <= size();
+    }
+
+    std::set<int> words; // to be translated
+    std::vector<int> pending;
+
+    void want(int address)
+    {
+        if (address >= 0 && address < size() && words.insert(address).second) pending.push_back(address);
+    }
+
+    struct Word
+    {
+        int address;
+        std::set<int> reached; // instructions
+        std::set<int> labels; // jumped to
+        int low, high; // bytes translated
+    };
+
+    Word scan(int address) // instructions reachable from address (finding further words to translate)
+    {
+        Word w;
+        w.address = address;
+        w.low = address;
+        w.high = address;
+        std::vector<int> work(1, address);
+        while (!work.empty())
+        {
+            int pc = work.back();
+            work.pop_back();
+            if (pc < 0 || pc >= size() || !decodable(pc) || !w.reached.insert(pc).second) continue;
+            uint8_t i = opcode(pc);
+            int end = pc + length(i) + ((i & 0x80) ? 1 : 0);
+            if (pc < w.low) w.low = pc;
+            if (end > w.high) w.high = end;
+            if (i & 0x80)
+            {
+                if (target(pc) != address) want(target(pc));
+                if (image[pc + 2] != 0) work.push_back(pc + 2); // (TCO otherwise)
+                else if (target(pc) == address) w.labels.insert(address); // tail call to self
+            }
+            else if (i == 0) continue; // ret
+            else if (i == 3) work.push_back(relative(pc)); // branch
+            else if (i == 4) // zbranch
+            {
+                work.push_back(relative(pc));
+                work.push_back(pc + 2);
+            }
+            else if (i == 5) // quote
+            {
+                want(pc + 2);
+                work.push_back(pc + 2 + image[pc + 1]);
+            }
+            else work.push_back(pc + length(i));
+        }
+        return w;
+    }
+
+    void jump(const Word& w, int pc) // continue at pc
+    {
+        if (w.reached.count(pc)) printf("        goto a%d;\n", pc);
+        else printf("        callWord(%d); return; // beyond the image\n", pc);
+    }
+
+    void translate(Word w, int index) // (index in compiled[])
+    {
+        for (std::set<int>::const_iterator it = w.reached.begin(); it != w.reached.end(); ++it)
+        {
+            uint8_t i = opcode(*it);
+            if ((i == 3 || i == 4) && w.reached.count(relative(*it))) w.labels.insert(relative(*it));
+        }
+        if (!w.reached.empty() && *w.reached.begin() != w.address) w.labels.insert(w.address);
+
+        printf("    void word%d() // %d-%d\n    {\n", w.address, w.low, w.high - 1);
+        printf("        if (compiled[%d].stale) { callWord(%d); return; } // interpreted instead\n", index, w.address);
+        if (w.reached.empty())
+        {
+            printf("        callWord(%d); // beyond the image\n    }\n\n", w.address);
+            return;
+        }
+        if (*w.reached.begin() != w.address) printf("        goto a%d;\n", w.address);
+        for (std::set<int>::const_iterator it = w.reached.begin(); it != w.reached.end(); ++it)
+        {
+            int pc = *it;
+            std::set<int>::const_iterator next = it;
+            ++next;
+            if (w.labels.count(pc)) printf("    a%d:\n", pc);
+            uint8_t i = opcode(pc);
+            int fall = pc + length(i); // -1 when not falling through
+            if (i & 0x80)
+            {
+                int t = target(pc);
+                bool tail = image[pc + 2] == 0;
+                if (tail && t == w.address) printf("        goto a%d; // tail call\n", t);
+                else if (words.count(t)) printf("        word%d();%s\n", t, tail ? " return;" : "");
+                else printf("        callWord(%d);%s\n", t, tail ? " return;" : "");
+                if (tail) fall = -1;
+            }
+            else if (i == 0)
+            {
+                printf("        return;\n");
+                fall = -1;
+            }
+            else if (i == 1) printf("        push(%d);\n", (int8_t)image[pc + 1]);
+            else if (i == 2) printf("        push(%d);\n", (int16_t)(image[pc + 1] << 8 | image[pc + 2]));
+            else if (i == 3)
+            {
+                jump(w, relative(pc));
+                fall = -1;
+            }
+            else if (i == 4)
+            {
+                if (w.reached.count(relative(pc))) printf("        if (pop() == 0) goto a%d;\n", relative(pc));
+                else printf("        if (pop() == 0) { callWord(%d); return; } // beyond the image\n", relative(pc));
+            }
+            else if (i == 5)
+            {
+                printf("        push(%d); // quotation\n", pc + 2);
+                fall = pc + 2 + image[pc + 1];
+            }
+            else if (i == 50) printf("        callWord(pop()); // call\n");
+            else if (i == 51) printf("        { int16_t f = pop(), t = pop(); callWord(pop() == 0 ? f : t); } // choice\n");
+            else if (i == 52) printf("        { int16_t t = pop(); if (pop() != 0) callWord(t); } // if\n");
+            else if (i < BUILT_INS) printf("        %s();\n", primitives[i]);
+            else printf("        instructions[%d]();\n", i);
+            if (fall >= 0 && (next == w.reached.end() || *next != fall)) jump(w, fall);
+        }
+        printf("    }\n\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int arg = 1;
+    if (arg < argc && std::string(argv[arg]) == "-f")
+    {
+        fused = true;
+        arg++;
+    }
+    if (argc - arg < 2)
+    {
+        fprintf(stderr, "usage: brief-aot [-f] image entry ... > words.cpp\n");
+        return 1;
+    }
+
+    const char* name = argv[arg++];
+    FILE* file = fopen(name, "rb");
+    if (file == 0)
+    {
+        fprintf(stderr, "cannot read %s\n", name);
+        return 1;
+    }
+    for (int c; (c = fgetc(file)) != EOF; ) image.push_back((uint8_t)c);
+    fclose(file);
+    if (image.empty() || image.size() > 0x8000)
+    {
+        fprintf(stderr, "%s is not a dictionary image\n", name);
+        return 1;
+    }
+
+    for (; arg < argc; arg++)
+    {
+        int address = strtol(argv[arg], 0, 0);
+        if (address < 0 || address >= size())
+        {
+            fprintf(stderr, "entry %s is outside the image\n", argv[arg]);
+            return 1;
+        }
+        want(address);
+    }
+
+    std::vector<Word> translated;
+    while (!pending.empty())
+    {
+        int address = pending.back();
+        pending.pop_back();
+        translated.push_back(scan(address));
+    }
+
+    printf("// Generated by brief-aot from %s; do not edit.\n\n", name);
+    printf("#include <Arduino.h>\n#include <Brief.h>\n\nnamespace brief\n{\n");
+
+    std::set<uint8_t> used;
+    for (size_t w = 0; w < translated.size(); w++)
+        for (std::set<int>::const_iterator it = translated[w].reached.begin(); it != translated[w].reached.end(); ++it)
+            used.insert(opcode(*it));
+    bool custom = false;
+    for (std::set<uint8_t>::const_iterator it = used.begin(); it != used.end(); ++it)
+    {
+        if (*it < BUILT_INS && primitives[*it] != 0) printf("    void %s();\n", primitives[*it]);
+        else if (*it >= BUILT_INS && *it < 0x80) custom = true;
+    }
+    if (custom) printf("    extern void (*instructions[MAX_PRIMITIVES])();\n");
+    printf("\n");
+
+    printf("    const uint8_t image[] PROGMEM = {");
+    for (int a = 0; a < size(); a++) printf("%s0x%02X", a % 16 == 0 ? (a == 0 ? "\n        " : ",\n        ") : ", ", image[a]);
+    printf(" };\n\n    const int16_t imageSize = %d;\n\n", size());
+
+    for (std::set<int>::const_iterator it = words.begin(); it != words.end(); ++it) printf("    void word%d();\n", *it);
+    printf("\n");
+    int index = 0;
+    for (std::set<int>::const_iterator it = words.begin(); it != words.end(); ++it, index++)
+        for (size_t w = 0; w < translated.size(); w++)
+            if (translated[w].address == *it) translate(translated[w], index);
+
+    printf("    Compiled compiled[] = {");
+    int n = 0;
+    for (std::set<int>::const_iterator it = words.begin(); it != words.end(); ++it, n++)
+        for (size_t w = 0; w < translated.size(); w++)
+            if (translated[w].address == *it)
+                printf("%s        { %d, %d, %d, word%d, false }", n == 0 ? "\n" : ",\n", *it, translated[w].low, translated[w].high, *it);
+    printf(" };\n\n    const uint8_t compiledCount = %d;\n}\n", n);
+    return 0;
+}
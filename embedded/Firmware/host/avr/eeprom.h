@@ -0,0 +1,17 @@
+/* avr/eeprom.h (host)
+
+   Stand-in for avr-libc's EEPROM routines, upon the simulated board's EEPROM (see Simulator.h).
+   Addresses are offsets into EEPROM, passed as pointers just as avr-libc has them. */
+
+#ifndef AVR_EEPROM_H
+#define AVR_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+uint8_t eeprom_read_byte(const uint8_t* address);
+void eeprom_update_byte(uint8_t* address, uint8_t value); // written only if it differs
+void eeprom_read_block(void* destination, const void* source, size_t length);
+void eeprom_update_block(const void* source, void* destination, size_t length);
+
+#endif // AVR_EEPROM_H
@@ -0,0 +1,166 @@
+/* batches.cpp
+
+   Measures lockstep batches (see Batch.h) against running each machine one after the other with
+   exec(), over words that stay in lockstep throughout, that step lane by lane now and then and that
+   diverge (a data-dependent choice), checking that every machine ends up exactly as exec() left it.
+   The first is run again with 'add' rebound by the hosting project (saturating at +/-1000), which
+   lockstep must leave to the lanes rather than adding by vector.
+
+     brief-batch [machines [repetitions]] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <Brief.h>
+#include "Batch.h"
+
+namespace
+{
+    const uint8_t program[] = {
+        // 0: arithmetic; x -> (3x² - 5x + 7) & 127, 16 times over
+        1, 16, 40,                  // lit8 16 pushr (counter)
+        35, 35, 17,                 // dup dup mul
+        1, 3, 17,                   // lit8 3 mul
+        36,                         // swap
+        1, 5, 17, 16,               // lit8 5 mul sub
+        1, 7, 15,                   // lit8 7 add
+        1, 127, 20,                 // lit8 127 andb
+        41, 33, 35, 40,             // popr dec dup pushr
+        1, 0, 24,                   // lit8 0 eq
+        4, (uint8_t)-25,            // zbranch (to 3)
+        41, 34, 0,                  // popr drop ret
+
+        // 32: collatz; x -> odd? [3x + 1] [x / 2] choice, 16 times over
+        1, 16, 40,                  // lit8 16 pushr
+        35, 1, 1, 20,               // dup lit8 1 andb
+        5, 5, 1, 3, 17, 32, 0,      // quote [lit8 3 mul inc]
+        5, 4, 1, 1, 23, 0,          // quote [lit8 1 shift]
+        51,                         // choice
+        41, 33, 35, 40,             // popr dec dup pushr
+        1, 0, 24,                   // lit8 0 eq
+        4, (uint8_t)-26,            // zbranch (to 35)
+        41, 34, 0,                  // popr drop ret
+        0,
+
+        // 66: stepped; as arithmetic, but mod 100 rather than and 127 (stepped lane by lane)
+        1, 16, 40,
+        35, 35, 17,
+        1, 3, 17,
+        36,
+        1, 5, 17, 16,
+        1, 7, 15,
+        1, 100, 19,                 // lit8 100 mod
+        41, 33, 35, 40,
+        1, 0, 24,
+        4, (uint8_t)-25,
+        41, 34, 0 };
+
+    struct Word
+    {
+        const char* name;
+        int16_t address;
+        int16_t (*input)(uint32_t i);
+        bool rebound; // add (15) bound to addSaturating
+    };
+
+    void addSaturating() // hosting project's own add (saturating at +/-1000)
+    {
+        int32_t y = brief::pop();
+        int32_t x = brief::pop() + y;
+        brief::push(x > 1000 ? 1000 : x < -1000 ? -1000 : x);
+    }
+
+    int16_t spread(uint32_t i) { return (int16_t)(i * 37 % 200) - 50; }
+    int16_t positive(uint32_t i) { return i % 97 + 1; }
+
+    const Word words[] = {
+        { "arithmetic", 0, spread, false },
+        { "collatz", 32, positive, false },
+        { "stepped", 66, spread, false },
+        { "rebound", 0, spread, true } };
+
+    void prepare(std::vector<brief::Machine>& machines, const Word& word)
+    {
+        for (uint32_t i = 0; i < machines.size(); i++)
+        {
+            machines[i].s = machines[i].dstackCells;
+            *++machines[i].s = word.input(i);
+        }
+    }
+
+    double seconds(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t count = argc > 1 ? atoi(argv[1]) : 1024;
+    uint32_t repetitions = argc > 2 ? atoi(argv[2]) : 50;
+    if (count == 0) count = 1;
+
+    brief::setup(); // binds instructions
+    std::vector<brief::Machine> machines(count);
+    std::vector<brief::Machine*> lanes(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        memcpy(machines[i].memory, program, sizeof(program));
+        machines[i].here = machines[i].last = sizeof(program);
+        lanes[i] = &machines[i];
+    }
+
+    printf("%-12s %10s %10s %8s %10s %10s\n", "word", "exec ns", "batch ns", "speedup", "lockstep", "diverged");
+    int failures = 0;
+    for (size_t w = 0; w < sizeof(words) / sizeof(words[0]); w++)
+    {
+        const Word& word = words[w];
+        brief::select(brief::primary);
+        brief::setup(); // (built-ins bound afresh)
+        if (word.rebound) brief::bind(15, addSaturating);
+        std::vector<brief::Cell> expected(count);
+        std::vector<long> depths(count);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (uint32_t k = 0; k < repetitions; k++)
+        {
+            prepare(machines, word);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                brief::select(machines[i]);
+                brief::exec(word.address);
+            }
+        }
+        double scalar = seconds(start);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            expected[i] = *machines[i].s;
+            depths[i] = machines[i].s - machines[i].dstackCells;
+        }
+
+        batch::Batch batch;
+        start = std::chrono::steady_clock::now();
+        for (uint32_t k = 0; k < repetitions; k++)
+        {
+            prepare(machines, word);
+            batch.exec(&lanes[0], count, word.address);
+        }
+        double batched = seconds(start);
+
+        bool ok = true;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            ok = ok && machines[i].s - machines[i].dstackCells == depths[i] && *machines[i].s == expected[i];
+        }
+        double lockstep = batch.steps + batch.laneSteps == 0 ? 0 : 100.0 * batch.steps / (batch.steps + batch.laneSteps);
+        double n = (double)count * repetitions;
+        printf("%-12s %10.1f %10.1f %7.2fx %9.1f%% %10.1f%%  %s\n", word.name, scalar / n * 1e9, batched / n * 1e9,
+            scalar / batched, lockstep, 100.0 * batch.divergences / ((count + batch::LANES - 1) / batch::LANES * repetitions),
+            ok ? "ok" : "FAILED");
+        if (!ok) failures++;
+    }
+    brief::select(brief::primary);
+    return failures == 0 ? 0 : 1;
+}
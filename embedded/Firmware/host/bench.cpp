@@ -0,0 +1,440 @@
+/* bench.cpp
+
+   Dispatch benchmarks for the Brief VM, built against the host stand-ins for Arduino and serial.
+
+   A handful of canonical programs (arithmetic loops, quotation/choice dispatch, deep call chains
+   and IL-style alloc/local code) are uploaded as definitions through Reflecta, exactly as the PC
+   would, then executed repeatedly. Each reports instructions per second and nanoseconds per
+   dispatch. Following that, each primitive is measured in a small kernel repeated within a loop;
+   the loop overhead is measured separately and subtracted to give the cost of the kernel alone.
+
+   Results are checked against the same computation done natively, and any VM error event sent up
+   fails the run.
+
+     brief-bench [name ...]    run only benchmarks whose names contain any of the given strings
+
+   Built with BRIEF_PAIRS, the most frequent pairs of adjacent instructions run (over whichever
+   benchmarks were selected) are listed at the end; candidates for fusing (see BRIEF_FUSED). */
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Brief.h>
+#include "ReflectaHost.h"
+#include "Simulator.h"
+
+namespace
+{
+    enum Op // bytecodes as bound in brief::setup()
+    {
+        RET, LIT8, LIT16, BRANCH, ZBRANCH, QUOTE,
+        EVENT_HEADER, EVENT_BODY8, EVENT_BODY16, EVENT_FOOTER, EVENT,
+        FETCH8, STORE8, FETCH16, STORE16,
+        ADD, SUB, MUL, DIV, MOD, AND, OR, XOR, SHIFT,
+        EQ, NEQ, GT, GEQ, LT, LEQ,
+        NOT, NEG, INC, DEC,
+        DROP, DUP, SWAP, PICK, ROLL, CLR,
+        PUSHR, POPR, PEEKR,
+        FORGET, ALLOC, FREE, TAIL, LOCAL, LOCAL_FETCH16, LOCAL_STORE16,
+        CALL, CHOICE, CHOOSE_IF
+    };
+
+#ifdef BRIEF_PAIRS
+    const char* names[] = {
+        "ret", "lit8", "lit16", "branch", "zbranch", "quote",
+        "eventHeader", "eventBody8", "eventBody16", "eventFooter", "eventOp",
+        "fetch8", "store8", "fetch16", "store16",
+        "add", "sub", "mul", "div", "mod", "andb", "orb", "xorb", "shift",
+        "eq", "neq", "gt", "geq", "lt", "leq",
+        "notb", "neg", "inc", "dec",
+        "drop", "dup", "swap", "pick", "roll", "clr",
+        "pushr", "popr", "peekr",
+        "forget", "alloc", "free", "tail", "local", "localFetch16", "localStore16",
+        "call", "choice", "chooseIf", "loopTicks", "setLoop", "stopLoop", "resetBoard",
+        "pinMode", "digitalRead", "digitalWrite", "analogRead", "analogWrite",
+        "attachISR", "detachISR", "milliseconds", "pulseIn" };
+#endif
+
+    // Tiny assembler (labels are code offsets; branches are patched when bound)
+
+    struct Code
+    {
+        std::vector<uint8_t> bytes;
+
+        Code& op(uint8_t i) { bytes.push_back(i); return *this; }
+        Code& lit(int16_t x)
+        {
+            if (x >= -128 && x <= 127) { op(LIT8); op((uint8_t)x); }
+            else { op(LIT16); op((uint8_t)(x >> 8)); op((uint8_t)x); }
+            return *this;
+        }
+        Code& call(int16_t address) { op(0x80 | (address >> 8)); op((uint8_t)address); return *this; }
+        int label() { return bytes.size(); }
+        Code& jump(uint8_t i, int target) { op(i); op(0); return patch(label() - 1, target); }
+        int forward(uint8_t i) { op(i); op(0); return label() - 1; } // patch later with bind()
+        Code& bind(int operand) { return patch(operand, label()); }
+        Code& patch(int operand, int target) // relative branch offsets are a signed byte
+        {
+            int x = target - operand;
+            if (x < INT8_MIN || x > INT8_MAX)
+            {
+                fprintf(stderr, "branch out of range\n");
+                exit(1);
+            }
+            bytes[operand] = (uint8_t)x;
+            return *this;
+        }
+        int quote() { op(QUOTE); op(0); return label() - 1; } // close with endQuote()
+        Code& endQuote(int operand) { bytes[operand] = (uint8_t)(label() - operand - 1); return *this; }
+    };
+
+    int16_t here = 0; // mirror of the MCU dictionary pointer (as the PC keeps)
+
+    bool errors = false;
+
+    void drain() // consume events sent up, flagging VM/protocol errors
+    {
+        std::vector<uint8_t> frame;
+        while (reflectaHost::receiveFrame(frame))
+        {
+            if (frame.size() > 0 && (frame[0] == VM_EVENT_ID || frame[0] == FRAMES_ERROR))
+            {
+                if (!errors) fprintf(stderr, "error event %02X %02X\n", frame[0], frame.size() > 1 ? frame[1] : 0);
+                errors = true;
+            }
+        }
+        simulator::transmitted().clear();
+    }
+
+    int16_t define(const Code& code) // upload as definition, returning its address
+    {
+        std::vector<uint8_t> frame(code.bytes);
+        frame.push_back(1); // definition flag
+        reflectaHost::sendFrame(&frame[0], frame.size());
+        reflectaFrames::loop();
+        int16_t address = here;
+        here += code.bytes.size();
+        return address;
+    }
+
+    void reset()
+    {
+        uint8_t frame[] = { 56 /* resetBoard */, 0 };
+        reflectaHost::sendFrame(frame, sizeof(frame));
+        reflectaFrames::loop();
+        reflectaHost::reset(); // resetBoard zeroes the MCU sequence numbers
+        here = 0;
+        drain();
+        errors = false;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Sample
+    {
+        double ns; // per exec
+        double dispatches; // per exec
+    };
+
+    Sample measure(int16_t word, int16_t arg, int execs, int16_t* result)
+    {
+        Sample best = { 1e300, 0 };
+        for (int round = 0; round < 5; round++)
+        {
+            uint32_t d = brief::dispatches;
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < execs; i++)
+            {
+                brief::push(arg);
+                brief::exec(word);
+                *result = brief::pop();
+            }
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            if (ns / execs < best.ns)
+            {
+                best.ns = ns / execs;
+                best.dispatches = (double)(brief::dispatches - d) / execs;
+            }
+            drain();
+        }
+        return best;
+    }
+
+    std::vector<std::string> filters;
+
+    bool selected(const char* name)
+    {
+        if (filters.empty()) return true;
+        for (size_t i = 0; i < filters.size(); i++)
+            if (strstr(name, filters[i].c_str())) return true;
+        return false;
+    }
+
+    int failures = 0;
+
+    void report(const char* name, const Sample& s, int16_t result, int16_t expected)
+    {
+        bool ok = result == expected && !errors;
+        printf("%-16s %12.1f %10.0f %10.2f %10.1f  %s\n",
+            name, s.dispatches, s.ns, s.ns / s.dispatches, s.dispatches / s.ns * 1000.0,
+            ok ? "ok" : "FAILED");
+        if (!ok)
+        {
+            printf("  result %d, expected %d\n", result, expected);
+            failures++;
+        }
+    }
+
+/*  Canonical programs. Each is a word taking n and leaving a result. */
+
+    const int16_t N = 1000;
+
+    void arithmetic() // sum of 3i+1 for i = n..1; data stack only, IL-style branches
+    {
+        reset();
+        Code c;
+        c.lit(0).op(SWAP); // acc n
+        int top = c.label();
+        c.op(DUP).lit(3).op(MUL).op(INC); // acc i t
+        c.lit(2).op(ROLL).op(ADD).op(SWAP); // acc' i
+        c.op(DEC).op(DUP);
+        int exit = c.forward(ZBRANCH);
+        c.jump(BRANCH, top);
+        c.bind(exit).op(DROP).op(RET);
+        int16_t word = define(c);
+
+        int16_t acc = 0;
+        for (int16_t i = N; i > 0; i--) acc += 3 * i + 1;
+
+        int16_t result;
+        Sample s = measure(word, N, 200, &result);
+        report("arithmetic", s, result, acc);
+    }
+
+    void choice() // sum of (i odd ? 5 : 7) via quotations and choice; accumulator on return stack
+    {
+        reset();
+        Code c;
+        c.lit(0).op(PUSHR); // n
+        int top = c.label();
+        c.op(DUP).lit(1).op(AND); // i odd
+        int t = c.quote(); c.lit(5).op(RET); c.endQuote(t);
+        int f = c.quote(); c.lit(7).op(RET); c.endQuote(f);
+        c.op(CHOICE); // i v
+        c.op(POPR).op(ADD).op(PUSHR);
+        c.op(DEC).op(DUP);
+        int exit = c.forward(ZBRANCH);
+        c.jump(BRANCH, top);
+        c.bind(exit).op(DROP).op(POPR).op(RET);
+        int16_t word = define(c);
+
+        int16_t acc = 0;
+        for (int16_t i = N; i > 0; i--) acc += (i & 1) ? 5 : 7;
+
+        int16_t result;
+        Sample s = measure(word, N, 200, &result);
+        report("choice", s, result, acc);
+    }
+
+    int16_t chain(int16_t x) // native equivalent of w1 below
+    {
+        // w4: 3 xor; w3: inc w4 (tail); w2: w3 w3; w1: w2 dec
+        for (int i = 0; i < 2; i++) x = (x + 1) ^ 3;
+        return x - 1;
+    }
+
+    void calls() // nested calls three deep (the return stack holds four) plus a tail call
+    {
+        reset();
+        Code w4; w4.lit(3).op(XOR).op(RET);
+        int16_t a4 = define(w4);
+        Code w3; w3.op(INC).call(a4).op(RET); // tail call
+        int16_t a3 = define(w3);
+        Code w2; w2.call(a3).call(a3).op(RET);
+        int16_t a2 = define(w2);
+        Code w1; w1.call(a2).op(DEC).op(RET);
+        int16_t a1 = define(w1);
+
+        Code c;
+        c.lit(0).op(SWAP); // acc n
+        int top = c.label();
+        c.op(SWAP).call(a1).op(SWAP); // acc' i
+        c.op(DEC).op(DUP);
+        int exit = c.forward(ZBRANCH);
+        c.jump(BRANCH, top);
+        c.bind(exit).op(DROP).op(RET);
+        int16_t word = define(c);
+
+        int16_t acc = 0;
+        for (int16_t i = N; i > 0; i--) acc = chain(acc);
+
+        int16_t result;
+        Sample s = measure(word, N, 200, &result);
+        report("calls", s, result, acc);
+    }
+
+    void locals() // sum of 1..n in IL style; alloc'd locals, localFetch16/localStore16
+    {
+        reset();
+        Code c;
+        c.lit(4).op(ALLOC); // i@0 acc@2
+        c.lit(0).op(LOCAL_STORE16); // i = n
+        int top = c.label();
+        c.lit(2).op(LOCAL_FETCH16).lit(0).op(LOCAL_FETCH16).op(ADD).lit(2).op(LOCAL_STORE16);
+        c.lit(0).op(LOCAL_FETCH16).op(DEC).op(DUP).lit(0).op(LOCAL_STORE16);
+        int exit = c.forward(ZBRANCH);
+        c.jump(BRANCH, top);
+        c.bind(exit).lit(2).op(LOCAL_FETCH16).op(FREE).op(RET);
+        int16_t word = define(c);
+
+        int16_t acc = 0;
+        for (int16_t i = N; i > 0; i--) acc += i;
+
+        int16_t result;
+        Sample s = measure(word, N, 200, &result);
+        report("locals", s, result, acc);
+    }
+
+/*  Per-opcode kernels. Each kernel is repeated (up to) 16 times per iteration of a loop counted down in a
+    memory cell. The setup code runs once before the loop and teardown once after, leaving the
+    stacks as they were. The same loop with an empty kernel gives the overhead to subtract. */
+
+    struct Kernel
+    {
+        const char* name;
+        std::vector<uint8_t> setup, body, teardown;
+    };
+
+    void kernel(std::vector<Kernel>& ks, const char* name, const Code& setup, const Code& body, const Code& teardown)
+    {
+        Kernel k = { name, setup.bytes, body.bytes, teardown.bytes };
+        ks.push_back(k);
+    }
+
+    const int REPS = 16; // fewer for kernels too long to branch back over
+
+    int reps(const Kernel& k)
+    {
+        return min(REPS, 100 / (int)k.body.size());
+    }
+
+    const int16_t COUNTER = 480; // loop counter cell (above the code, below any alloc'd locals)
+    const int16_t SCRATCH = 478; // cell for memory kernels (likewise)
+
+    int16_t kernelWord(const Kernel& k, bool empty)
+    {
+        Code c;
+        c.lit(COUNTER).op(STORE16); // n
+        c.bytes.insert(c.bytes.end(), k.setup.begin(), k.setup.end());
+        int top = c.label();
+        for (int i = 0; i < (empty ? 0 : reps(k)); i++)
+            c.bytes.insert(c.bytes.end(), k.body.begin(), k.body.end()); // position independent
+        c.lit(COUNTER).op(FETCH16).op(DEC).lit(COUNTER).op(STORE16).lit(COUNTER).op(FETCH16);
+        int exit = c.forward(ZBRANCH);
+        c.jump(BRANCH, top);
+        c.bind(exit);
+        c.bytes.insert(c.bytes.end(), k.teardown.begin(), k.teardown.end());
+        c.lit(0).op(RET); // result
+        return define(c);
+    }
+
+    void kernels()
+    {
+        const int16_t nop = 0; // [ret] defined first after each reset
+
+        std::vector<Kernel> ks;
+
+        kernel(ks, "lit8 drop", Code(), Code().lit(1).op(DROP), Code());
+        kernel(ks, "lit16 drop", Code(), Code().lit(1000).op(DROP), Code());
+        kernel(ks, "dup drop", Code().lit(1), Code().op(DUP).op(DROP), Code().op(DROP));
+        kernel(ks, "swap", Code().lit(1).lit(2), Code().op(SWAP), Code().op(DROP).op(DROP));
+        kernel(ks, "lit8 add", Code().lit(1), Code().lit(3).op(ADD), Code().op(DROP));
+        kernel(ks, "lit8 sub", Code().lit(1), Code().lit(3).op(SUB), Code().op(DROP));
+        kernel(ks, "lit8 mul", Code().lit(1), Code().lit(3).op(MUL), Code().op(DROP));
+        kernel(ks, "lit8 div", Code().lit(1000), Code().lit(3).op(DIV), Code().op(DROP));
+        kernel(ks, "lit8 mod", Code().lit(1000), Code().lit(3).op(MOD), Code().op(DROP));
+        kernel(ks, "lit8 and", Code().lit(1), Code().lit(3).op(AND), Code().op(DROP));
+        kernel(ks, "lit8 shift", Code().lit(1), Code().lit(-1).op(SHIFT), Code().op(DROP));
+        kernel(ks, "lit8 eq", Code().lit(1), Code().lit(3).op(EQ), Code().op(DROP));
+        kernel(ks, "lit8 lt", Code().lit(1), Code().lit(3).op(LT), Code().op(DROP));
+        kernel(ks, "not", Code().lit(1), Code().op(NOT), Code().op(DROP));
+        kernel(ks, "inc", Code().lit(1), Code().op(INC), Code().op(DROP));
+        kernel(ks, "pushr popr", Code().lit(1), Code().op(PUSHR).op(POPR), Code().op(DROP));
+        kernel(ks, "lit8 fetch8 drop", Code(), Code().lit(0).op(FETCH8).op(DROP), Code());
+        kernel(ks, "fetch16 store16", Code(), Code().lit(SCRATCH).op(FETCH16).lit(SCRATCH).op(STORE16), Code());
+        kernel(ks, "local fetch16", Code().lit(4).op(ALLOC), Code().lit(2).op(LOCAL_FETCH16).op(DROP), Code().op(FREE));
+        kernel(ks, "local store16", Code().lit(4).op(ALLOC), Code().lit(7).lit(2).op(LOCAL_STORE16), Code().op(FREE));
+        kernel(ks, "local fetch16 (pair)", Code().lit(4).op(ALLOC), Code().lit(2).op(LOCAL).op(FETCH16).op(DROP), Code().op(FREE));
+        kernel(ks, "branch", Code(), Code().op(BRANCH).op(1), Code());
+        kernel(ks, "lit8 zbranch", Code(), Code().lit(0).op(ZBRANCH).op(1), Code());
+        kernel(ks, "dup zbranch", Code().lit(1), Code().op(DUP).op(ZBRANCH).op(1), Code().op(DROP));
+        kernel(ks, "lit8 lt zbranch", Code().lit(1), Code().op(DUP).lit(3).op(LT).op(ZBRANCH).op(1), Code().op(DROP));
+        kernel(ks, "quote drop", Code(), Code().op(QUOTE).op(0).op(DROP), Code());
+        kernel(ks, "quote if ret", Code(), Code().lit(-1).op(QUOTE).op(1).op(RET).op(CHOOSE_IF), Code());
+        kernel(ks, "quote choice ret", Code(), Code().lit(-1).op(QUOTE).op(1).op(RET).op(QUOTE).op(1).op(RET).op(CHOICE), Code());
+        kernel(ks, "call ret", Code().lit(0), Code().call(nop).op(INC), Code().op(DROP)); // inc: not a tail call
+        kernel(ks, "lit8 event", Code(), Code().lit(1).lit(20).op(EVENT), Code());
+
+        printf("\n%-20s %10s %10s %10s\n", "kernel", "disp/iter", "ns/iter", "ns/disp");
+
+        const int16_t loops = 200;
+        int16_t result;
+        for (size_t i = 0; i < ks.size(); i++)
+        {
+            if (!selected(ks[i].name)) continue;
+            reset();
+            Code ret; ret.op(RET);
+            define(ret);
+            int16_t empty = kernelWord(ks[i], true);
+            int16_t full = kernelWord(ks[i], false);
+            Sample base = measure(empty, loops, 50, &result);
+            Sample s = measure(full, loops, 50, &result);
+            double iters = (double)loops * reps(ks[i]);
+            double ns = (s.ns - base.ns) / iters;
+            double d = (s.dispatches - base.dispatches) / iters;
+            printf("%-20s %10.1f %10.2f %10.2f  %s\n", ks[i].name, d, ns, ns / d, errors ? "FAILED" : "ok");
+            if (errors) failures++;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++) filters.push_back(argv[i]);
+
+    brief::setup();
+    reflectaFrames::setup(19200);
+    drain(); // boot event
+
+    printf("%-16s %12s %10s %10s %10s\n", "program", "disp/exec", "ns/exec", "ns/disp", "Minstr/s");
+    if (selected("arithmetic")) arithmetic();
+    if (selected("choice")) choice();
+    if (selected("calls")) calls();
+    if (selected("locals")) locals();
+
+    kernels();
+
+#ifdef BRIEF_PAIRS
+    printf("\n%-28s %12s\n", "pair", "count");
+    for (int n = 0; n < 16; n++)
+    {
+        int first = 0, second = 0;
+        for (int i = 0; i < MAX_PRIMITIVES; i++)
+            for (int j = 0; j < MAX_PRIMITIVES; j++)
+                if (brief::pairs[i][j] > brief::pairs[first][second]) { first = i; second = j; }
+        if (brief::pairs[first][second] == 0) break;
+        std::string pair = std::string(first < 66 ? names[first] : "?") + " " + (second < 66 ? names[second] : "?");
+        printf("%-28s %12u\n", pair.c_str(), brief::pairs[first][second]);
+        brief::pairs[first][second] = 0;
+    }
+#endif
+
+    if (failures > 0)
+    {
+        printf("\n%d FAILED\n", failures);
+        return 1;
+    }
+    return 0;
+}
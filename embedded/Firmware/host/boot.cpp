@@ -0,0 +1,161 @@
+/* boot.cpp
+
+   Coming back up after a reset without the PC (BRIEF_SNAPSHOT). A program is uploaded (a couple
+   of variables, a loop word counting passes, an ISR counting interrupts), saved with 'snapshot',
+   and the board power cycled: a new board over the same EEPROM (kept in a file), with the VM
+   starting over from nothing. Once setup() is done, it must be running just as before, loop word
+   and ISR attached, without a byte from the PC. The time taken to restore is reported against
+   that taken to upload the program again at 19200 baud.
+
+   Then an image with a byte of it corrupted must not be restored (the board coming up empty, as
+   it would with nothing saved), nor one from after 'resetBoard snapshot'.
+
+     brief-boot [image]     EEPROM file (default a temporary one, removed afterward) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include <Brief.h>
+#include <avr/eeprom.h>
+#include "ReflectaHost.h"
+#include "Simulator.h"
+
+#ifndef BRIEF_SNAPSHOT
+#error brief-boot needs Brief built with BRIEF_SNAPSHOT
+#endif
+
+namespace
+{
+    const unsigned long BYTE = 521; // microseconds per byte at 19200 baud (10 bits)
+    const int PASSES = 100;
+
+    const char* image;
+    bool good = true;
+
+    void check(bool ok, const char* what)
+    {
+        printf("%s  %s\n", what, ok ? "ok" : "FAILED");
+        good = good && ok;
+    }
+
+    void frame(const std::vector<uint8_t>& code, bool definition, size_t& bytes)
+    {
+        std::vector<uint8_t> f(code);
+        f.push_back(definition ? 1 : 0);
+        size_t before = simulator::transmitted().size();
+        reflectaHost::sendFrame(&f[0], f.size());
+        reflectaFrames::loop();
+        bytes += f.size() + 3; // (sequence, checksum and END; escaping aside)
+        simulator::transmitted().resize(before); // (nothing to answer)
+    }
+
+    int16_t cell(int16_t address)
+    {
+        return (int16_t)(brief::vm->memory[address] << 8 | brief::vm->memory[address + 1]);
+    }
+
+    void run() // loop word PASSES times, interrupt 0 raised every other pass
+    {
+        for (int i = 0; i < PASSES; i++)
+        {
+            brief::loop();
+            if (i % 2 == 0) simulator::raise(0);
+        }
+    }
+
+    double powerCycle(simulator::Board*& board) // a new board over the same EEPROM; microseconds in setup()
+    {
+        delete board; // (unmapping)
+        board = new simulator::Board();
+        simulator::select(*board);
+        if (!simulator::mapEeprom(image))
+        {
+            fprintf(stderr, "cannot map %s\n", image);
+            exit(1);
+        }
+        *brief::vm = brief::Machine();
+        reflectaHost::reset();
+        auto start = std::chrono::steady_clock::now();
+        brief::setup();
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        reflectaFrames::setup(19200);
+        simulator::transmitted().clear(); // (boot event)
+        return us;
+    }
+
+    void flip(uint16_t address) // a bit of EEPROM
+    {
+        uint8_t* a = (uint8_t*)(uintptr_t)address;
+        eeprom_update_byte(a, eeprom_read_byte(a) ^ 0x10);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    char temporary[] = "/tmp/brief-boot-XXXXXX";
+    if (argc > 1) image = argv[1];
+    else
+    {
+        int fd = mkstemp(temporary);
+        if (fd < 0)
+        {
+            perror("mkstemp");
+            return 1;
+        }
+        close(fd);
+        remove(temporary); // (created afresh, erased)
+        image = temporary;
+    }
+
+    simulator::Board* board = NULL;
+    powerCycle(board);
+
+    size_t bytes = 0;
+    frame(std::vector<uint8_t>(4, 0), true, bytes); // variables: passes at 0, interrupts at 2
+    const uint8_t counting[] = { 2, 0, 0, 13, 32, 2, 0, 0, 14, 0 }; // lit16 0 fetch16 inc lit16 0 store16 ret
+    const uint8_t isr[] = { 2, 0, 2, 13, 32, 2, 0, 2, 14, 0 }; // likewise at 2
+    frame(std::vector<uint8_t>(counting, counting + sizeof(counting)), true, bytes); // at 4
+    frame(std::vector<uint8_t>(isr, isr + sizeof(isr)), true, bytes); // at 14
+    const uint8_t start[] = { 2, 0, 4, 54, 2, 0, 14, 1, 0, 1, RISING, 62 }; // lit16 4 setLoop lit16 14 lit8 0 lit8 RISING attachISR
+    frame(std::vector<uint8_t>(start, start + sizeof(start)), false, bytes);
+    const uint8_t save[] = { 90 }; // snapshot
+    unsigned long writes = board->eepromWrites;
+    frame(std::vector<uint8_t>(save, save + 1), false, bytes);
+    writes = board->eepromWrites - writes;
+
+    std::vector<uint8_t> memory(brief::vm->memory, brief::vm->memory + brief::vm->here); // (as saved)
+    int16_t here = brief::vm->here, last = brief::vm->last, loopword = brief::vm->loopword;
+    printf("uploaded %u bytes of code in %u bytes of frames (%.1fms at 19200 baud)\n",
+        (unsigned)here, (unsigned)bytes, bytes * BYTE / 1000.0);
+    printf("snapshot wrote %lu EEPROM bytes (%.0fms at 3.3ms each on AVR)\n", writes, writes * 3.3);
+
+    double us = powerCycle(board);
+    check(brief::vm->here == here && brief::vm->last == last && brief::vm->loopword == loopword &&
+          memcmp(brief::vm->memory, &memory[0], here) == 0, "restored dictionary");
+    check(simulator::attached(0), "ISR reattached");
+    run();
+    check(cell(0) == PASSES && cell(2) == PASSES / 2, "running as before");
+    printf("setup() took %.1fus on the host, reading the image from EEPROM rather than %u bytes from the PC\n",
+        us, (unsigned)bytes);
+
+    uint16_t within = SNAPSHOT_ADDRESS; // (a byte of the ISR word, past the header)
+    while (within < E2END && memcmp(simulator::eeprom() + within, isr, sizeof(isr)) != 0) within++;
+    flip(within + 4);
+    powerCycle(board);
+    check(brief::vm->here == 0 && brief::vm->loopword == -1 && !simulator::attached(0), "corrupted image not restored");
+    flip(within + 4);
+    powerCycle(board);
+    check(brief::vm->here == here && simulator::attached(0), "restored once mended");
+
+    const uint8_t erase[] = { 56, 90 }; // resetBoard snapshot
+    frame(std::vector<uint8_t>(erase, erase + sizeof(erase)), false, bytes);
+    powerCycle(board);
+    check(brief::vm->here == 0 && brief::vm->loopword == -1 && !simulator::attached(0), "empty after resetBoard snapshot");
+
+    delete board;
+    if (argc <= 1) remove(image);
+    return good ? 0 : 1;
+}
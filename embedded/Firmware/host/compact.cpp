@@ -0,0 +1,239 @@
+/* compact.cpp
+
+   Redefining a word in the midst of the dictionary (BRIEF_COMPACT). A program is uploaded: a
+   variable, 'sq', 'off' (adding 10), a second variable holding what would read as a call, 'f'
+   calling both words, a chain of WORDS words each calling the one before (from 'f'), 'h' running
+   the last of them as a quotation (a 16-bit literal), and a loop word calling the last and 'h'
+   (along with a number that happens to be the address of 'off'). Then 'off' is redefined (adding
+   20) at the end of the dictionary and 'compact' takes the old one out, everything above slid down
+   and relocated, references to it going to the new one; as the PC would, the relocation table
+   says which spans are code and which literal is a quote reference. The loop word must then run
+   with the new 'off', the variable and the number left as they were.
+
+   The bytes sent to do so (the table included) are reported against those of forgetting back to
+   'off' and uploading everything since again (the only way to redefine it without compaction),
+   at 19200 baud.
+
+   Compacting a word still called, with nothing to stand in for it, must change nothing and
+   reclaim nothing; a dead word nobody calls is then taken out from beneath the rest.
+
+     brief-compact */
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <Brief.h>
+#include "ReflectaHost.h"
+#include "Simulator.h"
+
+#ifndef BRIEF_COMPACT
+#error brief-compact needs Brief built with BRIEF_COMPACT
+#endif
+
+namespace
+{
+    const unsigned long BYTE = 521; // microseconds per byte at 19200 baud (10 bits)
+    const int WORDS = 50;
+    const int16_t R = 0; // variable
+
+    bool good = true;
+    std::vector<int16_t> spans; // relocation table kept as the PC would (high bit set for data)
+    std::vector<int16_t> references; // literals holding quote references
+
+    void check(bool ok, const char* what)
+    {
+        printf("%s  %s\n", what, ok ? "ok" : "FAILED");
+        good = good && ok;
+    }
+
+    size_t frame(std::vector<uint8_t> code, bool definition) // bytes on the wire
+    {
+        code.push_back(definition ? 1 : 0);
+        reflectaHost::sendFrame(&code[0], code.size());
+        reflectaFrames::loop();
+        return code.size() + 3; // (sequence, checksum and END; escaping aside)
+    }
+
+    int16_t define(std::vector<uint8_t> code, size_t& bytes) // address defined at (returning)
+    {
+        int16_t at = brief::vm->here;
+        spans.push_back(at);
+        code.push_back(0);
+        bytes += frame(code, true);
+        return at;
+    }
+
+    int16_t variable(uint8_t hi, uint8_t lo, size_t& bytes) // address of its cell
+    {
+        int16_t at = brief::vm->here;
+        spans.push_back(0x8000 | at);
+        std::vector<uint8_t> cell(1, hi);
+        cell.push_back(lo);
+        bytes += frame(cell, true);
+        return at;
+    }
+
+    void call(std::vector<uint8_t>& code, int16_t address)
+    {
+        code.push_back(0x80 | address >> 8);
+        code.push_back(address & 0xFF);
+    }
+
+    void lit16(std::vector<uint8_t>& code, int16_t value)
+    {
+        code.push_back(2);
+        code.push_back(value >> 8);
+        code.push_back(value & 0xFF);
+    }
+
+    void cell(std::vector<uint8_t>& code, int16_t value)
+    {
+        code.push_back(value >> 8);
+        code.push_back(value & 0xFF);
+    }
+
+    int16_t cell(int16_t address)
+    {
+        return (int16_t)(brief::vm->memory[address] << 8 | brief::vm->memory[address + 1]);
+    }
+
+    std::vector<uint8_t> off(uint8_t n) // lit8 n +
+    {
+        const uint8_t code[] = { 1, n, 15 };
+        return std::vector<uint8_t>(code, code + sizeof(code));
+    }
+
+    void relocate(std::vector<int16_t>& addresses, int16_t from, int16_t to) // as 'compact' moved them
+    {
+        std::vector<int16_t> moved;
+        for (size_t i = 0; i < addresses.size(); i++)
+        {
+            int16_t a = addresses[i] & 0x7FFF;
+            if (a >= from && a < to) continue; // (taken out)
+            moved.push_back(a < to ? addresses[i] : addresses[i] - (to - from));
+        }
+        addresses = moved;
+    }
+
+    int16_t compact(int16_t into, int16_t from, int16_t to, size_t& bytes) // bytes reclaimed
+    {
+        std::vector<uint8_t> table; // count, spans, references
+        cell(table, (int16_t)spans.size());
+        for (size_t i = 0; i < spans.size(); i++) cell(table, spans[i]);
+        for (size_t i = 0; i < references.size(); i++) cell(table, references[i]);
+        int16_t at = brief::vm->here;
+        bytes += frame(table, true);
+        std::vector<uint8_t> code; // lit16 into lit16 from lit16 to lit16 table compact lit16 R !
+        lit16(code, into);
+        lit16(code, from);
+        lit16(code, to);
+        lit16(code, at);
+        code.push_back(92);
+        lit16(code, R);
+        code.push_back(14);
+        bytes += frame(code, false);
+        int16_t reclaimed = cell(R);
+        if (reclaimed > 0)
+        {
+            relocate(spans, from, to);
+            relocate(references, from, to);
+        }
+        return reclaimed;
+    }
+
+    int expected(int offset) // loop word: last(2) + h (last(3)), last(x) = f(x + WORDS) = (x + WORDS)^2 + offset
+    {
+        return (2 + WORDS) * (2 + WORDS) + offset + (3 + WORDS) * (3 + WORDS) + offset;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    simulator::Board board;
+    simulator::select(board);
+    brief::setup();
+    reflectaFrames::setup(19200);
+    board.tx.clear(); // (boot event)
+
+    size_t bytes = 0; // (of those before 'off')
+    variable(0, 0, bytes); // R
+    const uint8_t square[] = { 35, 17 }; // dup *
+    int16_t sq = define(std::vector<uint8_t>(square, square + sizeof(square)), bytes);
+    int16_t offAt = define(off(10), bytes);
+    int16_t offEnd = brief::vm->here;
+
+    size_t since = 0; // bytes of all defined after 'off'
+    int16_t v = variable(0x80 | offAt >> 8, offAt & 0xFF, since); // (reading as a call to 'off')
+    std::vector<uint8_t> f;
+    call(f, sq);
+    call(f, offAt);
+    int16_t last = define(f, since);
+    for (int w = 0; w < WORDS; w++) // lit8 1 + (tail) call previous
+    {
+        std::vector<uint8_t> word(1, 1);
+        word.push_back(1);
+        word.push_back(15);
+        call(word, last);
+        last = define(word, since);
+    }
+    std::vector<uint8_t> h(1, 1); // lit8 3 lit16 last call (a quote reference)
+    h.push_back(3);
+    lit16(h, last);
+    h.push_back(50);
+    int16_t hAt = define(h, since);
+    references.push_back(hAt + 2);
+    std::vector<uint8_t> loop(1, 1); // lit8 2 last h + lit16 R ! lit16 offAt drop
+    loop.push_back(2);
+    call(loop, last);
+    call(loop, hAt);
+    loop.push_back(15);
+    lit16(loop, R);
+    loop.push_back(14);
+    lit16(loop, offAt); // (a number)
+    loop.push_back(34);
+    int16_t loopAt = define(loop, since);
+    std::vector<uint8_t> start;
+    lit16(start, loopAt);
+    start.push_back(54); // setLoop
+    since += frame(start, false);
+
+    brief::loop();
+    check(cell(R) == expected(10), "running as uploaded");
+    int16_t here = brief::vm->here;
+
+    // Redefining 'off': the new one at the end, the old one taken out
+    size_t sent = 0;
+    int16_t newOff = define(off(20), sent);
+    size_t again = since + sent; // (instead: forget back to 'off', send it and all since)
+    int16_t reclaimed = compact(newOff, offAt, offEnd, sent);
+    brief::loop();
+    check(reclaimed == offEnd - offAt && brief::vm->here == here && brief::vm->loopword == loopAt - reclaimed &&
+          cell(R) == expected(20), "redefined in place");
+    check(cell(v - reclaimed) == (int16_t)(0x8000 | offAt) && cell(loopAt - reclaimed + 12) == offAt,
+          "variable and number left as they were");
+    std::vector<uint8_t> event;
+    while (reflectaHost::receiveEvent(event)) good = false; // (no errors)
+    printf("compaction reclaimed %d bytes; redefining took %u bytes sent (%.1fms at 19200 baud)\n", reclaimed,
+        (unsigned)sent, sent * BYTE / 1000.0);
+    printf("  rather than forgetting back to it and sending %u bytes again (%.1fms)\n", (unsigned)again, again * BYTE / 1000.0);
+
+    // 'sq' is still called by 'f'; nothing to stand in for it
+    std::vector<uint8_t> before(brief::vm->memory + sq, brief::vm->memory + brief::vm->here); // (past R)
+    size_t unused = 0;
+    reclaimed = compact(-1, sq, offAt, unused);
+    check(reclaimed == 0 && brief::vm->here == sq + (int16_t)before.size() &&
+          memcmp(&before[0], brief::vm->memory + sq, before.size()) == 0, "word still called kept");
+
+    // A dead word, beneath the rest
+    std::vector<uint8_t> dead(1, 1); // lit8 99 drop (never called)
+    dead.push_back(99);
+    dead.push_back(34);
+    here = brief::vm->here;
+    int16_t deadAt = define(dead, unused);
+    int16_t deadEnd = brief::vm->here;
+    define(off(30), unused); // (something after it)
+    reclaimed = compact(-1, deadAt, deadEnd, unused);
+    brief::loop();
+    check(reclaimed == deadEnd - deadAt && brief::vm->here == here + 4 && cell(R) == expected(20), "dead word taken out");
+    return good ? 0 : 1;
+}
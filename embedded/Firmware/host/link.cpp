@@ -0,0 +1,182 @@
+/* link.cpp
+
+   Keeping up with the serial link while running long words. The simulated board is given a
+   receive buffer of an Arduino's size (64 bytes) with bytes arriving at 19200 baud, and each pass
+   around the sketch's loop (brief::loop then reflectaFrames::loop) takes as long as the instructions
+   it dispatched would on an AVR board, roughly. Whatever arrives beyond the buffer in the meantime
+   is lost, as it would be on the board.
+
+   The PC calls a word counting to 20000 (several hundred milliseconds' work) twice, while poking a
+   variable every 10ms throughout. Built with BRIEF_SLICED (brief-link), every byte must get through
+   and every poke and count must land. Built without (brief-link-whole), the words run whole and
+   bytes are lost while they do, which is reported for comparison.
+
+   Then (BRIEF_SLICED, with BRIEF_PERIODIC) a periodic word sending an event runs while a word is
+   left part way with a frame held behind it; the code and frame held must be left as they were. */
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include <Brief.h>
+#include "ReflectaHost.h"
+#include "Simulator.h"
+
+#ifndef BRIEF_BENCH
+#error brief-link needs the VM built with BRIEF_BENCH (counting instructions dispatched)
+#endif
+
+namespace
+{
+    const unsigned long INSTRUCTION = 2; // microseconds per instruction dispatched (AVR, roughly)
+    const unsigned long PASS = 20; // microseconds around the sketch's loop besides
+    const unsigned long BYTE = 521; // microseconds per byte at 19200 baud (10 bits)
+    const size_t RX_BUFFER = 64; // Arduino's serial receive buffer
+
+    const int16_t COUNT = 0; // 16-bit variable
+    const int16_t WORK = 2; // n work - (counting n into COUNT)
+    const int16_t POKES = 17; // 8-bit variable
+
+    const uint8_t count[] = { 0, 0, 1 };
+    const uint8_t work[] = {
+        35, 4, 11,                  // dup zbranch +11 (done)
+        33,                         // dec
+        1, COUNT, 13, 32, 1, COUNT, 14, // lit8 count fetch16 inc lit8 count store16
+        3, (uint8_t)-12,            // branch -12
+        34, 0, 1 };                 // drop ret
+    const uint8_t pokes[] = { 0, 1 };
+    const uint8_t TICK_EVENT = 0x30; // sent by a periodic word
+
+    const int16_t N = 20000;
+    const uint8_t run[] = { 2, N >> 8, N & 0xFF, 0x80 | (WORK >> 8), WORK & 0xFF, 0 }; // lit16 n work
+    const uint8_t poke[] = { 1, POKES, 11, 32, 1, POKES, 12, 0 }; // lit8 pokes fetch8 inc lit8 pokes store8
+
+    simulator::Board board;
+    std::deque<uint8_t> wire; // sent by the PC, not yet arrived
+    unsigned long now = 0, arriving = 0; // microseconds (the next byte on the wire arriving at 'arriving')
+    unsigned long errors = 0; // protocol errors sent up (bytes lost garbling frames)
+
+    void send(const uint8_t* frame, size_t length) // onto the wire
+    {
+        size_t before = board.rx.size(); // (escaped and framed into rx, taken back out)
+        size_t capacity = board.rxCapacity;
+        board.rxCapacity = 0;
+        reflectaHost::sendFrame(frame, length);
+        board.rxCapacity = capacity;
+        if (wire.empty() && arriving < now) arriving = now;
+        wire.insert(wire.end(), board.rx.begin() + before, board.rx.end());
+        board.rx.erase(board.rx.begin() + before, board.rx.end());
+    }
+
+    void deliver() // whatever has arrived by now
+    {
+        while (!wire.empty() && arriving + BYTE <= now)
+        {
+            uint8_t b = wire.front();
+            simulator::receive(&b, 1);
+            wire.pop_front();
+            arriving += BYTE;
+        }
+    }
+
+    void drain() // events sent up
+    {
+        std::vector<uint8_t> frame;
+        while (reflectaHost::receiveFrame(frame))
+        {
+            if (frame.size() >= 1 && frame[0] == FRAMES_ERROR) errors++;
+        }
+        simulator::transmitted().clear();
+    }
+
+    unsigned long pass() // once around the sketch's loop, returning how long it took
+    {
+        uint32_t dispatched = brief::dispatches;
+        brief::loop();
+        reflectaFrames::loop();
+        drain();
+        unsigned long took = (brief::dispatches - dispatched) * INSTRUCTION + PASS;
+        now += took;
+        simulator::advance(took);
+        deliver();
+        return took;
+    }
+}
+
+int main()
+{
+    simulator::select(board);
+    brief::setup();
+    reflectaFrames::setup(19200);
+    drain();
+    reflectaHost::sendFrame(count, sizeof(count)); // defined before the race begins
+    reflectaHost::sendFrame(work, sizeof(work));
+    reflectaHost::sendFrame(pokes, sizeof(pokes));
+    reflectaFrames::loop();
+    drain();
+
+    board.rxCapacity = RX_BUFFER;
+    const unsigned long POKES_SENT = 100; // every 10ms for a second
+    unsigned long longest = 0, sent = 0, runs = 0;
+    while (now < 1500000 || !wire.empty())
+    {
+        if (runs < 2 && now >= runs * 400000) // at the start and at 400ms
+        {
+            send(run, sizeof(run));
+            runs++;
+        }
+        if (sent < POKES_SENT && now >= sent * 10000)
+        {
+            send(poke, sizeof(poke));
+            sent++;
+        }
+        unsigned long took = pass();
+        if (took > longest) longest = took;
+    }
+
+    uint8_t* memory = brief::vm->memory;
+    uint16_t counted = memory[COUNT] << 8 | memory[COUNT + 1];
+    uint8_t poked = memory[POKES];
+    bool good = board.rxLost == 0 && errors == 0 && poked == POKES_SENT && counted == (uint16_t)(2 * N);
+#ifdef BRIEF_SLICED
+    const char* verdict = good ? "ok" : "FAILED";
+#else
+    const char* verdict = good ? "ok" : "(as expected without BRIEF_SLICED)";
+#endif
+    printf("%lu bytes lost, %lu protocol errors, %u of %lu pokes, counted %u of %u, longest loop %.1fms  %s\n",
+        board.rxLost, errors, poked, sent, counted, (uint16_t)(2 * N), longest / 1000.0, verdict);
+#if defined(BRIEF_SLICED) && defined(BRIEF_PERIODIC)
+    // A periodic word sending an event while code is left part way and a frame held behind it
+    board.rxCapacity = 0;
+    int16_t tick = brief::vm->here;
+    const uint8_t telemetry[] = { 1, TICK_EVENT, 6, 9, 0, 1 }; // lit8 id eventHeader eventFooter ret (a cell to spare)
+    const uint8_t every[] = { 2, (uint8_t)(tick >> 8), (uint8_t)tick, 1, 1, 1, 0, 83, 34, 0 }; // tick 1ms priority 0 every drop
+    reflectaHost::sendFrame(telemetry, sizeof(telemetry));
+    reflectaHost::sendFrame(every, sizeof(every));
+    reflectaFrames::loop();
+    reflectaHost::sendFrame(run, sizeof(run));
+    reflectaFrames::loop(); // (left part way)
+    reflectaHost::sendFrame(poke, sizeof(poke));
+    reflectaFrames::loop(); // (held behind it)
+    drain();
+    int16_t parked = brief::vm->here, end = brief::vm->queue + brief::vm->queued; // (just past the frames held)
+    std::vector<uint8_t> before(memory + parked, memory + end);
+    unsigned long ticks = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        simulator::advance(2000);
+        brief::loop();
+        std::vector<uint8_t> frame;
+        while (reflectaHost::receiveEvent(frame)) if (frame.size() == 1 && frame[0] == TICK_EVENT) ticks++;
+    }
+    bool aside = brief::vm->held > 0 && brief::vm->queued > 0 && brief::vm->here == parked && brief::vm->queue + brief::vm->queued == end &&
+                 std::vector<uint8_t>(memory + parked, memory + end) == before;
+    printf("%lu events sent by a periodic word, code left part way and frames held as they were  %s\n", ticks,
+        ticks > 0 && aside ? "ok" : "FAILED");
+    good = good && ticks > 0 && aside;
+#endif
+#ifdef BRIEF_SLICED
+    return good ? 0 : 1;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,229 @@
+/* paged.cpp
+
+   A dictionary many times the board's RAM, paged in from external storage (BRIEF_PAGED). Some
+   seven kilobytes of definitions, chains of words each calling the one before, are sent to be
+   paged (a trailing 2; see frameReceived) into a file standing in for SPI flash, with a loop word
+   in RAM calling into a few chains each pass. Every pass must come to the sum those chains add
+   up to, stored into a variable in RAM and into one among the pages, the latter written back
+   upon eviction and found in the file once flushed.
+
+   Done calling one chain (its pages fitting in the cache, hits after the first pass) and then
+   several far apart (more pages than are resident, the least recently used evicted each pass).
+   Hits, misses, prefetches (and how many were used) and pages written back are reported, along
+   with the time storage would take at PAGE_READ microseconds a page; within a pass (misses) and
+   between passes (prefetches, in loop()). Missing every pass, prefetches must be used, and the
+   several chains are run again without prefetching, which must miss the more.
+
+     brief-paged [passes]     per working set (default 200) */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include <Brief.h>
+#include "ReflectaHost.h"
+#include "Simulator.h"
+
+#ifndef BRIEF_PAGED
+#error brief-paged needs Brief built with BRIEF_PAGED
+#endif
+
+namespace
+{
+    const double PAGE_READ = 4 + PAGE_SIZE; // microseconds (command, address and page at 8MHz SPI)
+    const int CHAINS = 160; // of LINKS words each
+    const int LINKS = 8;
+    const int16_t R = 0; // variable in RAM
+
+    int storage = -1; // file descriptor
+    unsigned long reads, writes;
+    int16_t entries[CHAINS]; // address of each chain's last word (calling the rest in turn)
+    int sums[CHAINS];
+    int16_t variable; // in paged space
+    bool good = true;
+
+    void check(bool ok, const char* what)
+    {
+        printf("%s  %s\n", what, ok ? "ok" : "FAILED");
+        good = good && ok;
+    }
+
+    void frame(std::vector<uint8_t> code, uint8_t flag) // 0 run, 1 define, 2 define paged
+    {
+        code.push_back(flag);
+        reflectaHost::sendFrame(&code[0], code.size());
+        reflectaFrames::loop();
+    }
+
+    void call(std::vector<uint8_t>& code, int16_t address)
+    {
+        code.push_back(0x80 | address >> 8);
+        code.push_back(address & 0xFF);
+    }
+
+    void lit16(std::vector<uint8_t>& code, int16_t value)
+    {
+        code.push_back(2);
+        code.push_back(value >> 8);
+        code.push_back(value & 0xFF);
+    }
+
+    int16_t cell(int16_t address)
+    {
+        return (int16_t)(brief::vm->memory[address] << 8 | brief::vm->memory[address + 1]);
+    }
+
+    void counts(uint32_t& hits, uint32_t& misses, uint32_t& prefetches, uint32_t& used, uint32_t& written)
+    {
+        hits = brief::pageHits;
+        misses = brief::pageMisses;
+        prefetches = brief::pagePrefetches;
+        used = brief::pagePrefetchesUsed;
+        written = brief::pageWrites;
+    }
+
+    uint32_t workingSet(const std::vector<int>& chains, int passes, const char* what) // misses
+    {
+        std::vector<uint8_t> word; // lit8 0 (call each chain) dup lit8 R ! lit16 variable ! ret
+        word.push_back(1);
+        word.push_back(0);
+        int expected = 0;
+        for (size_t c = 0; c < chains.size(); c++)
+        {
+            call(word, entries[chains[c]]);
+            expected += sums[chains[c]];
+        }
+        const uint8_t store[] = { 35, 1, R, 14 };
+        word.insert(word.end(), store, store + sizeof(store));
+        lit16(word, variable);
+        word.push_back(14);
+        word.push_back(0);
+        int16_t at = brief::vm->here;
+        frame(word, 1);
+        std::vector<uint8_t> start;
+        lit16(start, at);
+        start.push_back(54); // setLoop
+        frame(start, 0);
+
+        uint32_t hits, misses, prefetches, used, written;
+        counts(hits, misses, prefetches, used, written);
+        unsigned long before = reads;
+        bool right = true;
+        for (int p = 0; p < passes; p++)
+        {
+            brief::loop();
+            right = right && cell(R) == (int16_t)expected;
+        }
+        uint32_t h, m, pf, u, w;
+        counts(h, m, pf, u, w);
+        h -= hits;
+        m -= misses;
+        pf -= prefetches;
+        u -= used;
+        w -= written;
+        bool paid = !brief::pagePrefetching || m < (uint32_t)passes || u > 0; // (missing every pass, prefetches paying off)
+        printf("%s: %u hits, %u misses (%.2f%% hit), %u prefetched (%u used), %u written back;"
+            " storage %.0fus a pass within it, %.0fus between  %s\n", what, h, m, 100.0 * h / (h + m), pf, u, w,
+            m * PAGE_READ / passes, (reads - before - m) * PAGE_READ / passes, right && paid ? "ok" : "FAILED");
+        good = good && right && paid;
+
+        brief::vm->here = at; // (forget the loop word, for the next)
+        brief::vm->loopword = -1;
+        return m;
+    }
+}
+
+namespace brief
+{
+    void pageRead(uint16_t page, uint8_t* bytes)
+    {
+        if (pread(storage, bytes, PAGE_SIZE, (off_t)page * PAGE_SIZE) != PAGE_SIZE)
+        {
+            for (int i = 0; i < PAGE_SIZE; i++) bytes[i] = 0xFF; // (erased, past the end)
+        }
+        reads++;
+    }
+
+    void pageWrite(uint16_t page, const uint8_t* bytes)
+    {
+        if (pwrite(storage, bytes, PAGE_SIZE, (off_t)page * PAGE_SIZE) != PAGE_SIZE) perror("pwrite");
+        writes++;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int passes = argc > 1 ? atoi(argv[1]) : 200;
+
+    char path[] = "/tmp/brief-paged-XXXXXX";
+    storage = mkstemp(path);
+    if (storage < 0)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+
+    simulator::Board board;
+    simulator::select(board);
+    brief::setup();
+    reflectaFrames::setup(19200);
+    frame(std::vector<uint8_t>(2, 0), 1); // R
+
+    uint32_t seed = 12345;
+    for (int c = 0; c < CHAINS; c++) // lit8 k + (call previous) ret, one frame a word
+    {
+        int16_t previous = -1;
+        sums[c] = 0;
+        for (int l = 0; l < LINKS; l++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            uint8_t k = (seed >> 16) % 100;
+            std::vector<uint8_t> word;
+            word.push_back(1);
+            word.push_back(k);
+            word.push_back(15);
+            if (previous >= 0) call(word, previous);
+            word.push_back(0);
+            previous = brief::vm->paged;
+            frame(word, 2);
+            sums[c] += k;
+        }
+        entries[c] = previous;
+    }
+    variable = brief::vm->paged;
+    frame(std::vector<uint8_t>(2, 0), 2);
+    int paged = brief::vm->paged - PAGED_BASE;
+    printf("%d bytes of definitions paged (%d pages), %d in RAM (%d bytes of it resident pages)\n", paged,
+        (paged + PAGE_SIZE - 1) / PAGE_SIZE, brief::vm->here, RESIDENT_PAGES * PAGE_SIZE);
+    std::vector<uint8_t> event;
+    while (reflectaHost::receiveEvent(event)) {} // (boot)
+    simulator::transmitted().clear();
+
+    workingSet(std::vector<int>(1, CHAINS / 2), passes, "one chain");
+    std::vector<int> several;
+    for (int c = 0; c < CHAINS; c += CHAINS / 5) several.push_back(c);
+    uint32_t misses = workingSet(several, passes, "five chains");
+    brief::pagePrefetching = false;
+    uint32_t unfetched = workingSet(several, passes, "five chains, no prefetching");
+    brief::pagePrefetching = true;
+    check(misses < unfetched, "prefetching between passes saving misses within them");
+
+    int expected = 0;
+    for (size_t c = 0; c < several.size(); c++) expected += sums[several[c]];
+    brief::pageFlush();
+    uint8_t stored[2] = { 0, 0 };
+    off_t at = variable - PAGED_BASE;
+    check(pread(storage, stored, 2, at) == 2 && (int16_t)(stored[0] << 8 | stored[1]) == (int16_t)expected,
+        "variable among the pages written back");
+
+    const uint8_t report[] = { 1, 0, 91 }; // lit8 0 paging
+    frame(std::vector<uint8_t>(report, report + sizeof(report)), 0);
+    check(reflectaHost::receiveEvent(event) && event.size() == 13 && event[0] == PAGING_EVENT_ID &&
+          (event[3] << 8 | event[4]) == (int)(brief::pageMisses > 0xFFFF ? 0xFFFF : brief::pageMisses) &&
+          (event[11] << 8 | event[12]) == brief::vm->paged, "paging event");
+
+    close(storage);
+    remove(path);
+    return good ? 0 : 1;
+}
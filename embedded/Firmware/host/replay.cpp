@@ -0,0 +1,246 @@
+/* replay.cpp
+
+   Replays execution traces sent up by a VM built with BRIEF_TRACE (see 'trace' in Brief.cpp),
+   running them again upon this build of the same VM and reporting where, if anywhere, it went
+   differently.
+
+     brief-replay trace.bin     replay a trace saved by the PC; each event sent up (starting with
+                                TRACE_EVENT_ID) as a length byte followed by the payload
+     brief-replay               record one here and replay it
+
+   With no arguments, a small control program is uploaded to the simulated board and run against a
+   rising analog input until it indexes out of memory, which (armed with '1 trace') sends up the
+   trace leading to it. The trace is then replayed upon a fresh machine; it must reproduce the error
+   and leave the dictionary exactly as it was when sent. Then again with one input altered, which
+   the replay must catch. */
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <Brief.h>
+#include "ReflectaHost.h"
+#include "Simulator.h"
+
+#ifndef BRIEF_TRACE
+#error brief-replay needs the VM built with BRIEF_TRACE
+#endif
+
+namespace
+{
+    struct Dump // as sent up by 'trace'
+    {
+        int16_t here, last, locals, loopword, loopIterations;
+        std::vector<uint8_t> dictionary;
+        std::vector<brief::TraceRecord> records;
+    };
+
+    int16_t word(const uint8_t* p) { return (int16_t)(p[0] << 8 | p[1]); }
+
+    bool parse(const std::vector<std::vector<uint8_t> >& events, Dump& dump)
+    {
+        bool state = false;
+        for (size_t e = 0; e < events.size(); e++)
+        {
+            const std::vector<uint8_t>& ev = events[e];
+            if (ev.size() < 2 || ev[0] != TRACE_EVENT_ID) continue;
+            const uint8_t* p = &ev[2];
+            size_t n = ev.size() - 2;
+            switch (ev[1])
+            {
+                case 0: // state (starts a trace)
+                    if (n < 12) return false;
+                    dump.here = word(p);
+                    dump.last = word(p + 2);
+                    dump.locals = word(p + 4);
+                    dump.loopword = word(p + 6);
+                    dump.loopIterations = word(p + 8);
+                    dump.dictionary.assign(MEM_SIZE, 0); // (beneath 'here' and locals filled in below)
+                    dump.records.clear();
+                    state = true;
+                    break;
+                case 1: // dictionary
+                    for (size_t i = 2; i < n; i++)
+                    {
+                        size_t a = (uint16_t)word(p) + i - 2;
+                        if (a < dump.dictionary.size()) dump.dictionary[a] = p[i];
+                    }
+                    break;
+                case 2: // records
+                    for (size_t i = 0; i + 6 <= n; i += 6)
+                    {
+                        brief::TraceRecord t = { p[i], p[i + 1], word(p + i + 2), word(p + i + 4) };
+                        dump.records.push_back(t);
+                    }
+                    break;
+            }
+        }
+        return state;
+    }
+
+    const char* kinds[] = { "step", "exec", "state", "cell", "input", "store", "frame", "bytes", "error" };
+
+    void list(const Dump& dump, size_t from, size_t to)
+    {
+        for (size_t i = from; i < to && i < dump.records.size(); i++)
+        {
+            const brief::TraceRecord& t = dump.records[i];
+            printf("  %5u  %-6s %3u  %6d  %6d\n", (unsigned)i, t.kind < 9 ? kinds[t.kind] : "?", t.op, t.a, t.b);
+        }
+    }
+
+    brief::Machine machine; // replayed upon
+    std::vector<uint8_t> sent; // VM errors sent up while replaying
+
+    void replayed(uint8_t* event, uint16_t length)
+    {
+        if (length > 1 && event[0] == VM_EVENT_ID) sent.push_back(event[1]);
+    }
+
+    uint16_t replay(const Dump& dump, const std::vector<brief::TraceRecord>& records)
+    {
+        machine = brief::Machine();
+        memcpy(machine.memory, &dump.dictionary[0], MEM_SIZE);
+        machine.here = dump.here;
+        machine.last = dump.last;
+        machine.locals = dump.locals;
+        machine.loopword = dump.loopword;
+        machine.loopIterations = dump.loopIterations;
+        machine.sendEvent = replayed;
+        sent.clear();
+        brief::Machine* selected = brief::vm;
+        brief::select(machine);
+        uint16_t at = brief::replay(records.empty() ? 0 : &records[0], records.size());
+        brief::select(*selected);
+        return at;
+    }
+
+    // Recording (simulated board and PC)
+
+    std::vector<std::vector<uint8_t> > received;
+    bool failed = false;
+
+    void drain() // events sent up
+    {
+        std::vector<uint8_t> frame;
+        while (reflectaHost::receiveFrame(frame))
+        {
+            if (frame.size() >= 2 && frame[0] == TRACE_EVENT_ID && frame[1] == 0) received.clear(); // newer trace
+            if (frame.size() >= 1 && frame[0] == TRACE_EVENT_ID) received.push_back(frame);
+            if (frame.size() >= 2 && frame[0] == VM_EVENT_ID) failed = true;
+        }
+        simulator::transmitted().clear();
+    }
+
+    void send(const uint8_t* frame, size_t length)
+    {
+        reflectaHost::sendFrame(frame, length);
+        reflectaFrames::loop();
+        drain();
+    }
+
+    bool record()
+    {
+        const uint8_t counter[] = { 0, 0, 1 }; // 0: variable
+        const uint8_t tick[] = { // 2: loop word
+            1, 0, 13, 32, 1, 0, 14,     // lit8 0 fetch16 inc lit8 0 store16 (counter)
+            64, 34,                     // milliseconds drop
+            1, 0, 60, 35, 15,           // lit8 0 analogRead dup add
+            11, 34,                     // fetch8 drop (out of memory once the input reaches 256)
+            0, 1 };                     // ret
+        const uint8_t start[] = { 1, 2, 54, 1, 1, 78, 0 }; // lit8 2 setLoop lit8 1 trace (armed)
+        const uint8_t poke[] = { 1, 7, 34, 0 }; // lit8 7 drop
+
+        brief::setup();
+        reflectaFrames::setup(19200);
+        drain();
+        send(counter, sizeof(counter));
+        send(tick, sizeof(tick));
+        send(start, sizeof(start));
+
+        uint32_t seed = 12345;
+        int16_t input = 0;
+        for (int t = 0; t < 10000 && !failed; t++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            input += (seed >> 16) % 8;
+            simulator::setAnalog(0, input);
+            simulator::advance(1000);
+            if (t % 16 == 15) send(poke, sizeof(poke)); // the PC chatting now and then
+            brief::loop();
+            reflectaFrames::loop();
+            drain();
+        }
+        return failed && !received.empty();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Dump dump;
+    if (argc > 1) // replay a saved trace
+    {
+        FILE* f = fopen(argv[1], "rb");
+        if (f == 0)
+        {
+            fprintf(stderr, "can't open %s\n", argv[1]);
+            return 1;
+        }
+        std::vector<std::vector<uint8_t> > events;
+        int length;
+        while ((length = fgetc(f)) != EOF)
+        {
+            std::vector<uint8_t> ev(length);
+            if (length > 0 && fread(&ev[0], 1, length, f) != (size_t)length) break;
+            events.push_back(ev);
+        }
+        fclose(f);
+        if (!parse(events, dump))
+        {
+            fprintf(stderr, "no trace in %s\n", argv[1]);
+            return 1;
+        }
+        brief::setup(); // binds instructions
+        uint16_t at = replay(dump, dump.records);
+        list(dump, 0, dump.records.size());
+        if (at == dump.records.size()) printf("replayed %u records\n", (unsigned)at);
+        else printf("went astray at record %u\n", at);
+        return at == dump.records.size() ? 0 : 1;
+    }
+
+    if (!record() || !parse(received, dump))
+    {
+        printf("no trace sent up  FAILED\n");
+        return 1;
+    }
+    int failures = 0;
+
+    uint16_t at = replay(dump, dump.records);
+    size_t steps = 0;
+    for (size_t i = 0; i < dump.records.size(); i++) steps += dump.records[i].kind == brief::TRACE_STEP;
+    bool same = at == dump.records.size() && memcmp(machine.memory, &dump.dictionary[0], dump.here) == 0 &&
+                memcmp(machine.memory + dump.locals, &dump.dictionary[dump.locals], MEM_SIZE - dump.locals) == 0 &&
+                sent.size() == 1 && sent[0] == VM_ERROR_OUT_OF_MEMORY;
+    printf("replayed %u of %u records (%u instructions), error %d reproduced, dictionary %s  %s\n", at,
+        (unsigned)dump.records.size(), (unsigned)steps, sent.empty() ? -1 : sent[0],
+        same ? "identical" : "differs", same ? "ok" : "FAILED");
+    if (!same)
+    {
+        list(dump, at < 4 ? 0 : at - 4, at + 4);
+        failures++;
+    }
+
+    std::vector<brief::TraceRecord> altered(dump.records); // the last analog input read lower
+    size_t input = altered.size();
+    while (input-- > 0 && !(altered[input].kind == brief::TRACE_INPUT && altered[input].op == 60)) {}
+    bool caught = false;
+    if (input < altered.size())
+    {
+        altered[input].a = 0;
+        at = replay(dump, altered);
+        caught = at > input && at < altered.size();
+    }
+    printf("altered input (record %u) caught at record %u  %s\n", (unsigned)input, at, caught ? "ok" : "FAILED");
+    if (!caught) failures++;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+/* rom.cpp
+
+   Library words run in place from flash (BRIEF_ROM). A handful of library words, assembled to live
+   at ROM_BASE, are built in below as rom[] (the PC gives the whole of its library so with
+   Compiler.Rom; see romLibrary in Bytecode.fs). The same program is then run twice. First with
+   the library uploaded into the dictionary (relocated there, as the PC does now upon first use),
+   then calling it where it is, in ROM. Calls go both ways: dictionary words call the library, and
+   'twice' calls back a quotation living in the dictionary. Results must agree, and the dictionary
+   bytes left free are reported for each.
+
+   Storing into the library must be a VM error (leaving it as it was); fetching from it is
+   allowed, as from anywhere in the dictionary.
+
+     brief-rom */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <Brief.h>
+#include "ReflectaHost.h"
+#include "Simulator.h"
+
+#ifndef BRIEF_ROM
+#error brief-rom needs Brief built with BRIEF_ROM
+#endif
+
+#define AT(offset) (0x80 | (ROM_BASE + offset) >> 8), ((ROM_BASE + offset) & 0xFF) // call into the library
+
+namespace brief
+{
+    const uint8_t rom[] PROGMEM = {
+        35, 35, 17, 17, 0,                      //  0 cube   dup dup * *
+        1, 1, 37, 0,                            //  5 over   1 pick
+        1, 2, 38, 0,                            //  9 rot    2 roll
+        35, 1, 0, 28, 5, 2, 31, 0, 52, 0,       // 13 abs    dup 0 < [neg] if
+        1, 1, 37, 1, 1, 37, 0,                  // 23 2dup   over over (inline; return stack is shallow)
+        AT(23), 26, 5, 2, 36, 0, 52, 34, 0,     // 30 min    2dup > [swap] if drop
+        AT(23), 28, 5, 2, 36, 0, 52, 34, 0,     // 40 max    2dup < [swap] if drop
+        1, 0xFF, AT(40), 1, 1, AT(30), 0,       // 50 sign   -1 max 1 min
+        35, 40, 50, 41, 50, 0 };                // 59 twice  dup push call pop call  (x q - q(q(x)))
+    const int16_t romSize = sizeof(rom);
+}
+
+namespace
+{
+    enum { CUBE = 0, ABS = 13, SIGN = 50, TWICE = 59 }; // library words (offsets)
+    enum { A = 0, S = 2, T = 4, C = 6, F = 8, VARIABLES = 10 }; // dictionary variables
+
+    bool good = true;
+
+    void check(bool ok, const char* what)
+    {
+        printf("%s  %s\n", what, ok ? "ok" : "FAILED");
+        good = good && ok;
+    }
+
+    uint8_t length(uint8_t i) // bytes taken by instruction or call
+    {
+        if ((i & 0x80) || i == 1 || (i >= 3 && i <= 5)) return 2; // call, lit8, branch, zbranch, quote
+        return i == 2 ? 3 : 1; // lit16 or otherwise no operands
+    }
+
+    std::vector<uint8_t> relocated(int16_t base) // the library as it would be uploaded to base
+    {
+        std::vector<uint8_t> code(brief::rom, brief::rom + brief::romSize);
+        for (size_t pc = 0; pc < code.size(); pc += length(code[pc]))
+        {
+            if ((code[pc] & 0x80) == 0) continue;
+            int16_t target = (((code[pc] << 8) & 0x7F00) | code[pc + 1]) - ROM_BASE + base;
+            code[pc] = 0x80 | target >> 8;
+            code[pc + 1] = target & 0xFF;
+        }
+        return code;
+    }
+
+    void frame(std::vector<uint8_t> code, bool definition)
+    {
+        code.push_back(definition ? 1 : 0);
+        reflectaHost::sendFrame(&code[0], code.size());
+        reflectaFrames::loop();
+    }
+
+    int16_t cell(int16_t address)
+    {
+        return (int16_t)(brief::vm->memory[address] << 8 | brief::vm->memory[address + 1]);
+    }
+
+    std::vector<uint8_t> call(int16_t address)
+    {
+        std::vector<uint8_t> c(1, 0x80 | address >> 8);
+        c.push_back(address & 0xFF);
+        return c;
+    }
+
+    void add(std::vector<uint8_t>& code, const std::vector<uint8_t>& more)
+    {
+        code.insert(code.end(), more.begin(), more.end());
+    }
+
+    // The same program either way; the library at 'library' (ROM_BASE, or uploaded into the dictionary)
+    bool program(simulator::Board& board, int16_t library, const char* where)
+    {
+        simulator::select(board);
+        *brief::vm = brief::Machine();
+        reflectaHost::reset();
+        brief::setup();
+        reflectaFrames::setup(19200);
+        board.tx.clear(); // (boot event)
+
+        frame(std::vector<uint8_t>(VARIABLES, 0), true);
+        if (library != ROM_BASE) frame(relocated(library), true);
+        int16_t libraryEnd = brief::vm->here;
+
+        const uint8_t add3[] = { 1, 3, 15, 0 }; // lit8 3 +
+        int16_t add3At = brief::vm->here;
+        frame(std::vector<uint8_t>(add3, add3 + sizeof(add3)), true);
+
+        // lit8 0 analogRead lit16 512 - abs lit16 A ! (and again for sign, into S)
+        std::vector<uint8_t> loop;
+        const uint8_t input[] = { 1, 0, 60, 2, 0x02, 0x00, 16 };
+        loop.insert(loop.end(), input, input + sizeof(input));
+        add(loop, call(library + ABS));
+        const uint8_t storeA[] = { 1, A, 14 };
+        loop.insert(loop.end(), storeA, storeA + sizeof(storeA));
+        loop.insert(loop.end(), input, input + sizeof(input));
+        add(loop, call(library + SIGN));
+        const uint8_t storeS[] = { 1, S, 14, 0 };
+        loop.insert(loop.end(), storeS, storeS + sizeof(storeS));
+        int16_t loopAt = brief::vm->here;
+        frame(loop, true);
+        int16_t userEnd = brief::vm->here;
+
+        const uint8_t start[] = { 2, (uint8_t)(loopAt >> 8), (uint8_t)loopAt, 54 }; // setLoop
+        frame(std::vector<uint8_t>(start, start + sizeof(start)), false);
+
+        bool agree = true;
+        for (int v = 0; v < 1024; v += 7)
+        {
+            simulator::setAnalog(0, v);
+            brief::loop();
+            int d = v - 512;
+            agree = agree && cell(A) == abs(d) && cell(S) == (d > 0) - (d < 0);
+        }
+
+        std::vector<uint8_t> once(1, 1); // lit8 5 lit16 add3 twice lit16 T ! lit8 3 cube lit16 C !
+        once.push_back(5);
+        once.push_back(2);
+        once.push_back(add3At >> 8);
+        once.push_back(add3At & 0xFF);
+        add(once, call(library + TWICE));
+        const uint8_t storeT[] = { 1, T, 14, 1, 3 };
+        once.insert(once.end(), storeT, storeT + sizeof(storeT));
+        add(once, call(library + CUBE));
+        const uint8_t storeC[] = { 1, C, 14 };
+        once.insert(once.end(), storeC, storeC + sizeof(storeC));
+        frame(once, false);
+        agree = agree && cell(T) == 11 && cell(C) == 27 && brief::vm->s == brief::vm->dstackCells;
+        std::vector<uint8_t> event;
+        while (reflectaHost::receiveEvent(event)) agree = false; // (no errors)
+
+        printf("library in %s: %d bytes of dictionary used (%d of them the library), %d free  %s\n", where, userEnd,
+            libraryEnd - VARIABLES, MEM_SIZE - userEnd, agree ? "ok" : "FAILED");
+        good = good && agree;
+        return agree;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    simulator::Board uploaded, built;
+    program(uploaded, VARIABLES, "the dictionary");
+    program(built, ROM_BASE, "ROM"); // (carrying on upon this one)
+
+    const uint8_t fetch[] = { 2, ROM_BASE >> 8, ROM_BASE & 0xFF, 11, 1, F, 12 }; // lit16 ROM_BASE c@ lit8 F c!
+    frame(std::vector<uint8_t>(fetch, fetch + sizeof(fetch)), false);
+    check(brief::vm->memory[F] == brief::rom[0], "fetched from the library");
+
+    const uint8_t store[] = { 1, 7, 2, ROM_BASE >> 8, ROM_BASE & 0xFF, 12 }; // lit8 7 lit16 ROM_BASE c!
+    frame(std::vector<uint8_t>(store, store + sizeof(store)), false);
+    std::vector<uint8_t> event;
+    check(reflectaHost::receiveEvent(event) && event[0] == VM_EVENT_ID && event.size() > 1 && event[1] == VM_ERROR_OUT_OF_MEMORY &&
+          brief::rom[0] == 35, "storing into the library a VM error");
+    return good ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/* sweep.cpp
+
+   Parameter sweep of a Brief control program against a simulated plant, farmed out across threads
+   (see Farm.h), reporting throughput and scaling for each number of threads.
+
+   The program is a proportional controller run as the loop word: it reads the plant output from
+   an analog channel, multiplies the error by its gain and sends the control signal up as an event.
+   Each instance gets a different gain (patched into its dictionary image) and a different
+   disturbance, and is ticked against a first-order plant on its own simulated board. The result
+   of each is the sum of absolute errors over the run; the best gain found is listed at the end.
+
+   Every thread count must produce exactly the same results, which is checked.
+
+     brief-sweep [instances [ticks [threads ...]]]
+
+   By default threads are 1, 2, 4, ... up to the number of cores (and at least 4). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <Brief.h>
+#include "Farm.h"
+
+namespace
+{
+    const int16_t SETPOINT = 400;
+    const uint8_t SENSOR = 0; // analog channel
+    const uint8_t CONTROL = 1; // event ID
+
+    const uint8_t GAIN = 9; // offset of the gain operand (lit16) below
+
+    const uint8_t program[] = { // loop word at 0
+        1, SENSOR, 60,                          // lit8 sensor analogRead
+        2, SETPOINT >> 8, SETPOINT & 0xFF,      // lit16 setpoint
+        36, 16,                                 // swap sub (error)
+        2, 0, 0,                                // lit16 gain
+        17,                                     // mul
+        1, 3, 23,                               // lit8 3 shift (/8)
+        1, CONTROL, 10,                         // lit8 control eventOp
+        0 };                                    // ret
+
+    uint32_t ticks = 1000;
+
+    struct Plant // per instance
+    {
+        int32_t y; // output
+        int32_t u; // last control signal
+    };
+
+    void control(farm::Instance& instance, const uint8_t* payload, uint16_t length)
+    {
+        if (payload[0] != CONTROL) return;
+        Plant* plant = (Plant*)instance.context;
+        if (length == 1) plant->u = 0;
+        else if (length == 2) plant->u = (int8_t)payload[1];
+        else plant->u = (int16_t)(payload[1] << 8 | payload[2]);
+    }
+
+    void simulate(uint32_t index, void* context) // job
+    {
+        uint32_t* results = (uint32_t*)context;
+        int16_t gain = 1 + index % 64;
+        uint32_t seed = 2463534242u ^ (index * 2654435761u); // disturbance
+
+        farm::Instance instance;
+        instance.load(program, sizeof(program));
+        instance.machine.memory[GAIN] = gain >> 8;
+        instance.machine.memory[GAIN + 1] = gain & 0xFF;
+        instance.machine.loopword = 0;
+
+        Plant plant = { 0, 0 };
+        instance.context = &plant;
+        instance.event = control;
+
+        uint32_t cost = 0;
+        for (uint32_t t = 0; t < ticks; t++)
+        {
+            instance.board.analogIn[SENSOR] = plant.y;
+            instance.loop(1000);
+            seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+            plant.y += (plant.u - plant.y) / 4 + (int32_t)(seed % 9) - 4;
+            plant.y = plant.y < 0 ? 0 : plant.y > 1023 ? 1023 : plant.y;
+            cost += abs(SETPOINT - plant.y);
+        }
+        results[index] = instance.errors == 0 ? cost : UINT32_MAX;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t instances = argc > 1 ? atoi(argv[1]) : 2048;
+    if (argc > 2) ticks = atoi(argv[2]);
+    std::vector<unsigned> threads;
+    for (int i = 3; i < argc; i++) threads.push_back(atoi(argv[i]));
+    if (threads.empty())
+    {
+        unsigned cores = std::thread::hardware_concurrency();
+        for (unsigned n = 1; n <= cores || n <= 4; n *= 2) threads.push_back(n);
+    }
+
+    brief::setup(); // binds instructions (the primary machine is left alone from here on)
+
+    printf("%-8s %12s %12s %10s %10s\n", "threads", "instances", "inst/s", "Mticks/s", "speedup");
+    std::vector<uint32_t> first;
+    double base = 0;
+    int failures = 0;
+    for (size_t k = 0; k < threads.size(); k++)
+    {
+        std::vector<uint32_t> results(instances);
+        farm::Farm farm(threads[k]);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        farm.run(instances, simulate, &results[0]);
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (k == 0)
+        {
+            first = results;
+            base = s;
+        }
+        bool ok = results == first;
+        for (uint32_t i = 0; i < instances; i++) ok = ok && results[i] != UINT32_MAX;
+        printf("%-8u %12u %12.0f %10.2f %10.2f  %s\n", farm.threads(), instances, instances / s,
+            instances * (double)ticks / s / 1e6, base / s, ok ? "ok" : "FAILED");
+        if (!ok) failures++;
+    }
+
+    uint32_t best = 0;
+    for (uint32_t i = 1; i < instances && i < 64; i++)
+        if (first[i] < first[best]) best = i;
+    if (instances > 0) printf("\nbest gain %u (cost %u over %u ticks)\n", 1 + best % 64, first[best], ticks);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+/* telemetry.cpp
+
+   Serial bandwidth taken by heartbeat-style telemetry. A loop word sends up six analog channels
+   each tick, one event apiece, while the simulated board's inputs wander slowly as sensors do.
+   Every value must arrive, in order, through reflectaHost::receiveEvent; the bytes put on the
+   wire are reported per tick, along with the ticks per second that leaves room for at 19200 baud.
+
+   Built with BRIEF_COALESCED (brief-telemetry), each tick's events go up in a single frame.
+   brief-telemetry-plain sends a frame per event, for comparison. Built with BRIEF_DELTAS
+   (brief-telemetry-delta), the six go up as one event of delta-coded samples (see 'eventDelta'),
+   reconstructed by reflectaHost::Deltas.
+
+   Then, the PC falling behind, events must be refused once Reflecta's TX ring fills (counted in
+   brief::eventsRefused) and the PC told so by a FRAMES_ERROR_TX_OVERFLOW error frame.
+
+     brief-telemetry [ticks] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <Brief.h>
+#include "ReflectaHost.h"
+#include "Simulator.h"
+
+namespace
+{
+    const uint8_t CHANNELS = 6;
+    const uint8_t ID = 0x10; // event IDs 0x10, 0x11, ... by channel
+    const double BYTES_PER_SECOND = 19200 / 10.0;
+
+#ifndef BRIEF_DELTAS
+    int16_t value(const std::vector<uint8_t>& event) // as sent by the 'event' instruction
+    {
+        switch (event.size())
+        {
+            case 1: return 0;
+            case 2: return (int8_t)event[1];
+            default: return (int16_t)(event[1] << 8 | event[2]);
+        }
+    }
+#endif
+}
+
+int main(int argc, char** argv)
+{
+    int ticks = argc > 1 ? atoi(argv[1]) : 1000;
+
+    simulator::Board board;
+    simulator::select(board);
+    brief::setup();
+    reflectaFrames::setup(19200);
+
+#ifdef BRIEF_DELTAS
+    std::vector<uint8_t> heartbeat(1, 1); // lit8 id eventHeader (lit8 c analogRead lit8 c eventDelta) eventFooter ret
+    heartbeat.push_back(ID);
+    heartbeat.push_back(6);
+    for (uint8_t c = 0; c < CHANNELS; c++)
+    {
+        const uint8_t send[] = { 1, c, 60, 1, c, 88 };
+        heartbeat.insert(heartbeat.end(), send, send + sizeof(send));
+    }
+    heartbeat.push_back(9);
+    reflectaHost::Deltas deltas;
+#else
+    std::vector<uint8_t> heartbeat; // lit8 c analogRead lit8 id event (each channel) ret
+    for (uint8_t c = 0; c < CHANNELS; c++)
+    {
+        const uint8_t send[] = { 1, c, 60, 1, (uint8_t)(ID + c), 10 };
+        heartbeat.insert(heartbeat.end(), send, send + sizeof(send));
+    }
+#endif
+    heartbeat.push_back(0);
+    heartbeat.push_back(1); // (definition)
+    const uint8_t start[] = { 2, 0, 0, 54, 0 }; // lit16 0 setLoop
+    reflectaHost::sendFrame(&heartbeat[0], heartbeat.size());
+    reflectaHost::sendFrame(start, sizeof(start));
+    reflectaFrames::loop();
+    std::vector<uint8_t> event;
+    while (reflectaHost::receiveEvent(event)) {} // (boot)
+    simulator::transmitted().clear();
+
+    int16_t inputs[CHANNELS] = { 512, 100, 900, 300, 700, 20 };
+    uint32_t seed = 12345;
+    size_t bytes = 0, values = 0, wrong = 0;
+    for (int t = 0; t < ticks; t++)
+    {
+        for (uint8_t c = 0; c < CHANNELS; c++) // wandering slowly
+        {
+            seed = seed * 1103515245u + 12345u;
+            inputs[c] += (int)((seed >> 16) % 7) - 3;
+            if (inputs[c] < 0) inputs[c] = 0;
+            if (inputs[c] > 1023) inputs[c] = 1023;
+            simulator::setAnalog(c, inputs[c]);
+        }
+        simulator::advance(1000);
+        brief::loop();
+        bytes += simulator::transmitted().size();
+#ifdef BRIEF_DELTAS
+        size_t at = 1;
+        bool received = reflectaHost::receiveEvent(event) && event[0] == ID;
+        for (uint8_t c = 0; c < CHANNELS; c++)
+        {
+            int16_t v;
+            if (!received || !deltas.next(event, at, c, v) || v != inputs[c]) wrong++;
+            else values++;
+        }
+        if (received && at != event.size()) wrong++;
+#else
+        for (uint8_t c = 0; c < CHANNELS; c++)
+        {
+            if (!reflectaHost::receiveEvent(event) || event[0] != ID + c || value(event) != inputs[c]) wrong++;
+            else values++;
+        }
+#endif
+        while (reflectaHost::receiveEvent(event)) wrong++; // (nothing more)
+    }
+
+    double perTick = (double)bytes / ticks;
+    printf("%u values, %.1f bytes per tick (%.0f ticks/s at 19200 baud)  %s\n", (unsigned)values, perTick,
+        BYTES_PER_SECOND / perTick, wrong == 0 ? "ok" : "FAILED");
+#ifdef BRIEF_DELTAS
+    const uint8_t beyond[] = { 1, 7, 1, DELTA_CHANNELS, 88, 0 }; // lit8 7 lit8 DELTA_CHANNELS eventDelta
+    reflectaHost::sendFrame(beyond, sizeof(beyond));
+    reflectaFrames::loop();
+    bool reported = reflectaHost::receiveEvent(event) && event[0] == VM_EVENT_ID && event.size() > 1 &&
+                    event[1] == VM_ERROR_OUT_OF_MEMORY;
+    printf("sample on a channel beyond DELTA_CHANNELS a VM error  %s\n", reported ? "ok" : "FAILED");
+    if (!reported) wrong++;
+#endif
+#if FRAMES_TX_RING > 0
+    board.txCapacity = 8; // (the PC falling behind; the ring fills)
+    for (int t = 0; t < 20; t++) brief::loop();
+    bool refused = brief::eventsRefused > 0 && reflectaFrames::txDropped > 0;
+    board.txCapacity = 0;
+    reflectaFrames::loop(); // (room again)
+    bool told = false;
+    while (reflectaHost::receiveEvent(event))
+    {
+        told = told || (event.size() == 2 && event[0] == FRAMES_ERROR && event[1] == FRAMES_ERROR_TX_OVERFLOW);
+    }
+    printf("%u events refused once the TX ring filled, the PC told  %s\n", (unsigned)brief::eventsRefused,
+        refused && told ? "ok" : "FAILED");
+    if (!refused || !told) wrong++;
+#endif
+    return wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+/* upload.cpp
+
+   Uploading a dictionary over a noisy link with acknowledged delivery (FRAMES_RELIABLE; see
+   ReflectaFramesSerial.h). The PC sends a few dozen definitions through reflectaHost::Reliable,
+   bytes going each way at 19200 baud behind a few milliseconds' latency (a USB serial adapter's,
+   roughly), with now and then a byte garbled in either direction. Every definition must land in
+   the dictionary exactly once and in order, however many had to be sent again.
+
+   Done stop-and-wait (a window of 1, a round trip per definition) and then pipelined (the MCU's
+   FRAMES_WINDOW), for comparison. Then the same code again as a single definition, longer than a
+   byte's length; one frame, sent again whole should any of it be garbled.
+
+     brief-upload [garbled]     one byte in 'garbled' (default 300; 0 for none) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include <Brief.h>
+#include "ReflectaHost.h"
+#include "Simulator.h"
+
+#ifndef FRAMES_RELIABLE
+#error brief-upload needs ReflectaFramesSerial built with FRAMES_RELIABLE
+#endif
+
+namespace
+{
+    const unsigned long PASS = 100; // microseconds around the sketch's loop
+    const unsigned long BYTE = 521; // microseconds per byte at 19200 baud (10 bits)
+    const unsigned long LATENCY = 4000; // microseconds each way besides
+    const unsigned long TIMEOUT = 50000; // microseconds without acknowledgement before sending again (besides BYTE each)
+    const size_t DEFINITIONS = 24;
+
+    struct Timed
+    {
+        unsigned long at; // microseconds
+        uint8_t b;
+    };
+
+    unsigned long now;
+    std::deque<Timed> down, up; // on the wire each way, arriving at 'at'
+    std::vector<uint8_t> arrived; // sent up, arrived at the PC
+    uint32_t seed = 12345;
+    unsigned long garbled, garbles;
+
+    template <typename Bytes>
+    void onto(std::deque<Timed>& wire, const Bytes& data, size_t from) // (garbling some)
+    {
+        unsigned long at = wire.empty() || wire.back().at < now + LATENCY ? now + LATENCY : wire.back().at;
+        for (size_t i = from; i < data.size(); i++)
+        {
+            Timed t = { at += BYTE, data[i] };
+            seed = seed * 1103515245u + 12345u;
+            if (garbled > 0 && (seed >> 8) % garbled == 0)
+            {
+                t.b ^= 1 + (seed >> 20) % 255; // (a bit or several)
+                garbles++;
+            }
+            wire.push_back(t);
+        }
+    }
+
+    void service(reflectaHost::Reliable& sender, simulator::Board& board) // frames down onto the wire
+    {
+        size_t before = board.rx.size(); // (escaped and framed into rx, taken back out)
+        sender.service(now);
+        onto(down, board.rx, before);
+        board.rx.erase(board.rx.begin() + before, board.rx.end());
+    }
+
+    void pass(reflectaHost::Reliable& sender, simulator::Board& board)
+    {
+        brief::loop();
+        reflectaFrames::loop();
+        onto(up, board.tx, 0);
+        board.tx.clear();
+        now += PASS;
+        simulator::advance(PASS);
+
+        while (!down.empty() && down.front().at <= now)
+        {
+            simulator::receive(&down.front().b, 1);
+            down.pop_front();
+        }
+        while (!up.empty() && up.front().at <= now)
+        {
+            arrived.push_back(up.front().b);
+            up.pop_front();
+        }
+        board.tx.swap(arrived); // (taken as sent up by the board)
+        std::vector<uint8_t> frame;
+        while (reflectaHost::receiveFrame(frame)) sender.acknowledged(frame, now);
+        board.tx.swap(arrived);
+    }
+
+    bool upload(uint8_t window, const std::vector<std::vector<uint8_t> >& definitions)
+    {
+        simulator::Board board;
+        simulator::select(board);
+        simulator::advance(0);
+        now = 0;
+        down.clear();
+        up.clear();
+        arrived.clear();
+        garbles = 0;
+        brief::setup();
+        reflectaFrames::setup(19200);
+        reflectaHost::reset();
+        board.tx.clear(); // (boot event)
+
+        reflectaHost::Reliable sender(window, TIMEOUT, BYTE);
+        std::vector<uint8_t> image;
+        size_t bytes = 0;
+        for (size_t i = 0; i < definitions.size(); i++)
+        {
+            sender.queue(&definitions[i][0], definitions[i].size());
+            image.insert(image.end(), definitions[i].begin(), definitions[i].end() - 1); // (less def flag)
+            bytes += definitions[i].size();
+        }
+        unsigned long finished = 0;
+        while ((!sender.done() || !down.empty() || !up.empty()) && now < 60000000)
+        {
+            service(sender, board);
+            pass(sender, board);
+            if (finished == 0 && sender.done()) finished = now;
+        }
+
+        bool good = sender.done() && brief::vm->here == (int16_t)image.size() &&
+                    memcmp(brief::vm->memory, &image[0], image.size()) == 0;
+        printf("window %u: %u definition%s (%u bytes) in %.0fms, %u frames sent, %u again (%u timeouts), %lu bytes garbled  %s\n",
+            window, (unsigned)definitions.size(), definitions.size() == 1 ? "" : "s", (unsigned)bytes, finished / 1000.0, sender.sent, sender.resent,
+            sender.timeouts, garbles, good ? "ok" : "FAILED");
+        return good;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    garbled = argc > 1 ? atoi(argv[1]) : 300;
+
+    std::vector<std::vector<uint8_t> > definitions; // lit8 k (several) ret, and def flag
+    uint32_t sizes = 777;
+    for (size_t d = 0; d < DEFINITIONS; d++)
+    {
+        sizes = sizes * 1103515245u + 12345u;
+        std::vector<uint8_t> code;
+        for (uint32_t k = 0, n = 2 + (sizes >> 16) % 7; k < n; k++)
+        {
+            code.push_back(1);
+            code.push_back((uint8_t)(d + k));
+        }
+        code.push_back(0);
+        code.push_back(1);
+        definitions.push_back(code);
+    }
+
+    std::vector<std::vector<uint8_t> > image(1); // all as one
+    for (size_t d = 0; d < definitions.size(); d++) image[0].insert(image[0].end(), definitions[d].begin(), definitions[d].end() - 1);
+    image[0].push_back(1);
+
+    bool good = upload(1, definitions);
+    good = upload(FRAMES_WINDOW, definitions) && good;
+    good = upload(FRAMES_WINDOW, image) && good;
+    return good ? 0 : 1;
+}
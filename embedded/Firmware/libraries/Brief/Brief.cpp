@@ -1,1080 +1,4065 @@
-#include "Brief.h"
-
-namespace brief
-{
-/*  The Brief VM revolves around a pair of stacks and a block of memory serving as a dictionary of
-    subroutines.
-
-    The dictionary is typically 1Kb. This is where Brief byte code is stored and executed. While it
-    can technically be used as general purpose memory, the intent is to treat it as a structured
-    space for definitions; subroutines, variables, and the like, all contiguously packed.
-
-    The two stacks are each eight elements of 16-bit signed integers. They are used to store data
-    and addresses. They are connected in that elements can be popped from the top of one and pushed
-    to the top of the other.
-
-    One stack is used as a data stack; persisting values across instructions and subroutine calls.
-    With very few exceptions, instructions get their operands only from the data stack. All
-    parameter passing between subroutines is done via this stack.
-
-    The other stack is used by the VM as a return stack. The program counter is pushed here before
-    jumping into a subroutine and is popped to return. Be careful not to nest subroutines more than
-    eight levels deep! Note that infinite tail recursion is possible none the less. */
-
-    // Memory (dictionary)
-
-    void error(uint8_t code); // forward decl
-
-    uint8_t memory[MEM_SIZE]; // dictionary (and local/arg space for IL semantics)
-
-    uint8_t mem(int16_t address) // fetch with bounds checking
-    {
-        if (address < 0 || address >= MEM_SIZE)
-        {
-            error(VM_ERROR_OUT_OF_MEMORY);
-            return 0;
-        }
-        else
-        {
-            return memory[address];
-        }
-    }
-
-    void memset(int16_t address, uint8_t value) // store with bounds checking
-    {
-        if (address >= MEM_SIZE)
-        {
-            error(VM_ERROR_OUT_OF_MEMORY);
-        }
-        else
-        {
-            memory[address] = value;
-        }
-    }
-
-    // Data stack
-
-    int16_t dstack[DATA_STACK_SIZE]; // eval stack (and args in Brief semantics)
-
-    int16_t* s; // data stack pointer
-
-    void push(int16_t x)
-    {
-        if (s >= dstack + DATA_STACK_SIZE)
-        {
-            s = dstack - 1;
-            error(VM_ERROR_DATA_STACK_OVERFLOW);
-        }
-        else
-        {
-            *(++s) = x;
-        }
-    }
-
-    int16_t pop()
-    {
-        if (s < dstack)
-        {
-            s = dstack - 1;
-            error(VM_ERROR_DATA_STACK_UNDERFLOW);
-        }
-        else
-        {
-            return *s--;
-        }
-    }
-
-    // Return stack
-
-    int16_t rstack[RETURN_STACK_SIZE]; // return stack (and locals in Brief)
-
-    int16_t* r; // return stack pointer
-
-    void rpush(int16_t x)
-    {
-        if (r >= rstack + RETURN_STACK_SIZE)
-        {
-            error(VM_ERROR_RETURN_STACK_OVERFLOW);
-        }
-        else
-        {
-            *(++r) = x;
-        }
-    }
-
-    int16_t rpop()
-    {
-        if (r < rstack)
-        {
-            error(VM_ERROR_RETURN_STACK_UNDERFLOW);
-        }
-        else
-        {
-            return *r--;
-        }
-    }
-
-/*  Brief instructions are single bytes with the high bit reset:
-
-      0xxxxxxx
-
-    The lower seven bits become essentially an index into a function table.  Each may consume
-    and/or produce values on the data stack as well as having other side effects. Only three
-    instructions manipulate the return stack.  Two are push and pop which move values between the
-    data and return stack.  The third is (return); popping an address at which execution continues.
-
-    It is extremely common to factor out redundant sequences of code into subroutines. There is no
-    "call" instruction. Instead, if the high bit is set then the following byte is taken and
-    together (in little endian), with the high bit reset, they become an address to be called.
-
-      1xxxxxxxxxxxxxxx
-
-    This allows 15-bit addressing to definitions in the dictionary.
-
-    Upon calling, the VM pushes the current program counter to the return stack. There is a return
-    instruction, used to terminate definitions, which pops the return stack to continue execution
-    after the call. */
-
-    void (*instructions[MAX_PRIMITIVES])(); // instruction function table
-
-    void bind(uint8_t i, void (*f)()) // add function to instruction table
-    {
-        instructions[i] = f;
-    }
-
-    int16_t p; // program counter (VM instruction pointer)
-
-    void ret() // return instruction
-    {
-        p = rpop();
-    }
-
-    void run() // run code at p
-    {
-        int16_t i;
-        do
-        {
-            i = mem(p++);
-            if ((i & 0x80) == 0) // instruction?
-            {
-                instructions[i](); // execute instruction
-            }
-            else // address to call
-            {
-                if (mem(p + 1) != 0) // not followed by return (TCO)
-                    rpush(p + 1); // return address
-                p = ((i << 8) & 0x7F00) | mem(p); // jump
-            }
-        } while (p >= 0); // -1 pushed to return stack
-    }
-
-    void exec(int16_t address) // execute code at given address
-    {
-        r = rstack - 1; // reset return stack
-        p = address;
-        rpush(-1); // causing run() to fall through upon completion
-        run();
-    }
-
-/*  Reflecta handles the framing protocol. This includes the sequence numbers, CRC checks, etc.
-
-    We hook our own frameAllocation function which simply allocates directly from the next available
-    space in the dictionary. This means Reflecta will write definitions exactly where they belong
-    and we avoid a copy.
-
-    We also hook our own frameReceived function to process bytecode sent down. The last byte of the 
-    frame indicates whether it is to be executed immediately (0) or is a definition (1) to remain in
-    the dictionary.
-
-    The payload from the PC to the MCU is in the form of Brief code. A trailing byte indicates
-    whether the code is to be executed immediately (0x00) or appended to the dictionary as a new
-    definition (0x01).
-
-    A dictionary pointer is maintained at the MCU. This pointer always references the first
-    available free byte of dictionary space (beginning at address 0x0000). Each definition sent to
-    the MCU is appended to the end of the dictionary and advances the pointer. The bottom end of the
-    dictionary space is used for locals/arguments (mainly for IL, not idiomatic Brief).
-
-    If code is a definition then it is expected to already be terminated by a return instruction (if
-    appropriate) and so we do nothing at all; just leave it in place and leave the 'here' pointer
-    alone.
-
-    If code is to be executed immediately then a return instruction is appended and exec(...) is
-    called on it. The dictionary pointer ('here') is restored; reclaiming this memory. */
-
-    int16_t here; // dictionary 'here' pointer
-    int16_t last; // last definition address
-    int16_t locals; // local allocation pointer
-
-    uint8_t frameAllocation(uint8_t** frameBuffer)
-    {
-        // allocate Reflecta frame buffer from dictionary space
-        *frameBuffer = memory + here;
-        return min(255, MEM_SIZE - here);
-    }
-
-    void frameReceived(uint8_t sequence, uint8_t frameLength, uint8_t* frame)
-    {
-        // process Reflecta frame containing Brief bytecode
-        last = here;
-        here += frameLength - 1; // -1 not including exec/def flag
-        bool isExec = memory[here] == 0;
-        if (isExec)
-        {
-            memset(here++, 0); // return instruction
-        }
-        if (here > locals)
-        {
-            error(VM_ERROR_OUT_OF_MEMORY);
-        }
-        else if (isExec)
-        {
-            here = last;
-            exec(here);
-        }
-    }
-
-/*  Events may be sent as unsolicited data up to the PC. Requests may cause events, but it is not a
-    request/response model. That is, the event is always async and is not correlated with a
-    particular request (at the protocol level).
-
-    Events follow the same framing protocol from above. The payload is a single- byte identifier
-    followed by an arbitrary number of data bytes.
-
-      ID:   1 byte
-      Data: n bytes
-
-    Events may be considered simple signed scalar values generated by the event instruction. In this
-    case the data bytes consist of 0-, 1- or 2-bytes depending on the value taken from the stack.
-    The value 0 is transmitted as zero-length data and may be used when the ID alone is enough
-    information to signal an event. Other values have various lengths:
-
-      x = 0                   0 bytes
-      -128 >= x <= 127        1 byte
-      otherwise               2 bytes
-
-    Events may instead be hand packed records of data, such as a heartbeat of sensor data. This is
-    produced using the eventHeader and eventFooter instructions. Event data may be included using
-    eventBody8/16. */
-
-    int16_t eventBuffer = MEM_SIZE; // index into event buffer (reusing dictionary)
-
-    void eventHeader() // pack event payload (ID from stack)
-    {
-        eventBuffer = here;
-        memset(eventBuffer++, pop());
-    }
-
-    void eventBody8() // append byte to packed event payload
-    {
-        memset(eventBuffer++, pop());
-    }
-
-    void eventBody16() // append int16 to packed event payload
-    {
-        int16_t val = pop();
-        memset(eventBuffer++, val >> 8);
-        memset(eventBuffer++, val);
-    }
-
-    void eventFooter() // send packed event as a Reflecta frame
-    {
-        reflectaFrames::sendFrame(memory + here, eventBuffer - here);
-    }
-
-    void event(uint8_t id, int16_t val) // helper to send simple scaler events
-    {
-        push(id);
-        eventHeader();
-        if (val != 0)
-        {
-            if (val >= INT8_MIN && val <= INT8_MAX)
-            {
-                push(val);
-                eventBody8();
-            }
-            else
-            {
-                push(val);
-                eventBody16();
-            }
-        }
-        eventFooter();
-    }
-
-/*  Several event IDs are used to notify the PC of protocol and VM errors.  Defined in Brief.h and
-    ReflectaFramesSerial.h, but for reference:
-
-      ID                 Value    Meaning
-      0xFF   Reset       None     MCU reset
-      0xFE   Protocol    0        Out of sequence frame
-                         1        Unexpected escape byte
-                         2        CRC failure
-      0xFD - VM          0        Return stack underflow
-                         1        Return stack overflow
-                         2        Data stack underflow
-                         3        Data stack overflow
-                         4        Indexed out of memory */
-
-    void error(uint8_t code) // error events
-    {
-        push(code);
-        push(VM_EVENT_ID);
-        eventHeader();
-        eventBody8();
-        eventFooter();
-    }
-
-/*  Below are the primitive Brief instructions; later bound in setup. All of these functions take no
-    parameters and return nothing. Arguments and return values flow through the stack. */
-
-    void eventOp() // send event up to PC containing top stack value
-    {
-        int8_t id = pop();
-        int16_t val = pop();
-        event(id, val);
-    }
-
-/*  Memory fetch/store instructions. Fetches take an address from the stack and push back the
-    contents of that address (within the dictionary). Stores take a value and an address from the
-    stack and store the value to the address. */
-
-    inline int16_t mem16(int16_t address) // helper (not Brief instruction)
-    {
-        int16_t x = ((int16_t)mem(address)) << 8;
-        return x | mem(address + 1);
-    }
-
-    void fetch8()
-    {
-        *s = mem(*s);
-    }
-
-    void store8()
-    {
-        memset(pop(), (uint8_t)pop());
-    }
-
-    void fetch16()
-    {
-        int16_t a = *s;
-        *s = mem16(a);
-    }
-
-    void store16()
-    {
-        int16_t a = pop(), v = pop();
-        memset(a, v >> 8);
-        memset(a + 1, v);
-    }
-
-/*  Literal (constant) values are pushed to the stack by the lit8/16 instructions. The values is a
-    parameter to the instruction. Literals (as well as branches below) are one of the few
-    instructions to actually have operands. This is done by consuming the bytes at the current
-    program counter and advancing the counter to skip them for execution. */
-
-    void lit8()
-    {
-        push((int8_t)mem(p++));
-    }
-
-    void lit16()
-    {
-        push(mem16(p++)); p++;
-    }
-
-/*  Binary and unary ALU operations pop one or two values and push back one. These include basic
-    arithmetic, bitwise operations, comparison, etc. */
-
-    void add()
-    {
-        int16_t x = pop();
-        *s = *s + x;
-    }
-
-    void sub()
-    {
-        int16_t x = pop();
-        *s = *s - x;
-    }
-
-    void mul()
-    {
-        int16_t x = pop();
-        *s = *s * x;
-    }
-
-    void div()
-    {
-        int16_t x = pop();
-        *s = *s / x;
-    }
-
-    void mod()
-    {
-        int16_t x = pop();
-        *s = *s % x;
-    }
-
-    void andb()
-    {
-        int16_t x = pop();
-        *s = *s & x;
-    }
-
-    void orb()
-    {
-        int16_t x = pop();
-        *s = *s | x;
-    }
-
-    void xorb()
-    {
-        int16_t x = pop();
-        *s = *s ^ x;
-    }
-
-    void shift()
-    {
-        int16_t x = pop();
-        if (x < 0) *s = *s << -x;
-        else *s = *s >> x;
-    }
-
-    inline int16_t boolval(int16_t b) // helper (not Brief instruction)
-    {
-        // true is all bits on (works for bitwise and logical operations alike)
-        return b ? 0xFFFF : 0;
-    }
-
-    void eq()
-    {
-        int16_t x = pop();
-        *s = boolval(*s == x);
-    }
-
-    void neq()
-    {
-        int16_t x = pop();
-        *s = boolval(*s != x);
-    }
-
-    void gt()
-    {
-        int16_t x = pop();
-        *s = boolval(*s > x);
-    }
-
-    void geq()
-    {
-        int16_t x = pop();
-        *s = boolval(*s >= x);
-    }
-
-    void lt()
-    {
-        int16_t x = pop();
-        *s = boolval(*s < x);
-    }
-
-    void leq()
-    {
-        int16_t x = pop();
-        *s = boolval(*s <= x);
-    }
-
-    void notb()
-    {
-        *s = ~(*s);
-    }
-
-    void neg()
-    {
-        *s = -(*s);
-    }
-
-    void inc()
-    {
-        *s = ++(*s);
-    }
-
-    void dec()
-    {
-        *s = --(*s);
-    }
-
-/*  Stack manipulation instructions */
-
-    void drop()
-    {
-        s--;
-    }
-
-    void dup()
-    {
-        push(*s);
-    }
-
-    void swap()
-    {
-        int16_t t = *s;
-        int16_t* n = s - 1;
-        *s = *n; *n = t;
-    }
-
-    void pick() // nth item to top of stack
-    {
-        int16_t n = pop();
-        push(*(s - n));
-    }
-
-    void roll() // top item slipped into nth position
-    {
-        int16_t n = pop(), t = *(s - n);
-        int16_t* i;
-        for (i = s - n; i < s; i++)
-        {
-            *i = *(i + 1);
-        }
-        *s = t;
-    }
-
-    void clr() // clear stack
-    {
-        s = dstack - 1;
-    }
-
-/*  Moving items between data and return stack. The return stack is commonly also used to store data
-    that is local to a subroutine. It is safe to push data here to be recovered after a subroutine
-    call. It is not safe to use it for passing data between subroutines. That is what the data stack
-    is for. Think of arguments vs. locals. */
-
-    void pushr()
-    {
-        rpush(pop());
-    }
-
-    void popr()
-    {
-        push(rpop());
-    }
-
-    void peekr()
-    {
-        push(*r);
-    }
-
-/*  Dictionary manipulation instructions:
-
-    The 'forget' function is a Forthism for reverting to the address of a previously defined word;
-    essentially forgetting it and any (potentially dependent words) defined thereafter.
-
-    The alloc, free, tail, and local* instructions are all to support IL translation. The CLR
-    doesn't use the evaluation stack for parameter passing and local storage. For example, there
-    are no stack manipulation instructions in IL except drop. Instead, IL code generally makes use
-    of a per-method locals and arguments fetched and stored via instructions such as
-    StLoc/LdLoc/StArg/LdArg.
-
-    This is not a feature used in idiomatic Brief code but is here to make IL translation more
-    straight forward. Each method allocated enough space for locals and args. Before returning (or
-    earlier for TCO), this is freed.
-
-    The normal way of handling locals in Brief that need to survive a call and return from another
-    word is to store them on the return stack. The alloc instruction does this to persist the size
-    of allocation to be used by free/tail later. Tail call optimization (that is, .tail in the IL)
-    is handled by the tail instruction. This frees and pushes back a zero so that freeing later upon
-    return has no further effect.
-
-    Local and arg space is allocated from the bottom of dictionary space. The 'local' instruction is
-    used for args as well despite the name. It simply pushes the address of the nth slot. This
-    address can then be used by the regular fetch and store instructions. Because 16-bit values are
-    commonly used in translated IL, there are single-byte instructions for this. */
-
-    void forget() // revert dictionary pointer to TOS
-    {
-        int16_t i = pop();
-        if (i < here) // don't "remember" random memory!
-            here = i;
-    }
-
-    void alloc()
-    {
-        int16_t len = pop();
-        locals -= len;
-        rpush(len); // remember for free later
-        for (int16_t i = locals; i < locals + len; i++)
-        {
-            memset(i, 0);
-        }
-        if (locals < here)
-        {
-            error(VM_ERROR_OUT_OF_MEMORY);
-        }
-    }
- 
-    void free()
-    {
-        locals += rpop();
-    }
-
-    void tail()
-    {
-        free(); // free early
-        rpush(0); // leave this for free later
-    }
-
-    void local()
-    {
-        push(locals + pop());
-    }
-
-    void localFetch16()
-    {
-        local();
-        fetch16();
-    }
-
-    void localStore16()
-    {
-        local();
-        store16();
-    }
-
-    /*  Control flow is done by instructions that manipulate the program counter (p).
-
-        A 'call' instruction pops an address and calls it; pushing the current p as to return.
-
-        Conditional and unconditional branching is done by relative offsets as a parameter to the
-        instruction (following byte). These (like literals) are among the few instructions with
-        operands; in this case to save code size by not requiring a preceeding literal.
-
-        Notice that there is only the single conditional branch instruction.  There are no 'branch
-        if greater', 'branch if equal', etc. Instead the separate comparison instructions above are
-        used as the preceding predicate. */
-
-    void call()
-    {
-        rpush(p);
-        p = pop();
-    }
-
-    void branch()
-    {
-        p += (int8_t)mem(p);
-    }
-
-    void zbranch()
-    {
-        if (pop() == 0)
-        {
-            branch();
-        }
-        else
-        {
-            p++;
-        }
-    }
-
-    /*  Quotations and 'choice' need some explanation. The idea behind quotations is something like
-        an anonymous lambda and is used with some nice syntax in the Brief language. The 'quote'
-        instruction precedes a sequence that is to be treated as an embedded definition
-        essentially. It takes a length as an operand, pushes the address of the sequence of code
-        following and then jumps over that code.
-
-        The net result is that the sequence is not executed, but its address is left on the stack
-        for future words to call as they see fit.
-
-        One primitive that makes use of this is 'choice' which is the idiomatic Brief conditional.
-        It pops two addresses (likely from two quotations) along with a predicate value (likely the
-        result of some comparison or logical operations). It then executes one or the other
-        quotation depending on the predicate.
-
-        Another primitive making use of quotations is 'chooseIf' (called simply 'if' in Brief) which
-        pops a predicate and a single address; calling the address if non-zero.
-
-        Many secondary words in Brief also use quotation such as 'bi', 'tri', 'map', 'fold', etc.
-        which act as higher-order functions applying. */
-
-    void quote()
-    {
-        uint8_t len = mem(p++);
-        push(p); // address of quotation
-        p += len; // jump over
-    }
-
-    void choice()
-    {
-        int16_t f = pop();
-        int16_t t = pop();
-        rpush(p);
-        p = pop() == 0 ? f : t;
-    }
-
-    void chooseIf()
-    {
-        int16_t t = pop();
-        if (pop() != 0)
-        {
-            rpush(p);
-            p = t;
-        }
-    }
-
-    /*  A Brief word (address) may be set to run in the main loop. Also, a loop counter is
-        maintained for use by conditional logic (throttling for example). */
-
-    int16_t loopword = -1; // address of loop word
-
-    int16_t loopIterations = 0; // number of iterations since 'setup'
-
-    void loopTicks()
-    {
-        push(loopIterations & 0x7FFF);
-    }
-
-    void setLoop()
-    {
-        loopIterations = 0;
-        loopword = pop();
-    }
-
-    void stopLoop()
-    {
-        loopword = -1;
-    }
-
-    /*  Upon first connecting to a board, the PC will execute a reset so that assumptions about
-        dictionary contents and such hold true. */ 
-
-    void resetBoard() // likely called initialy upon connecting from PC
-    {
-        clr();
-        here = last = 0;
-        locals = MEM_SIZE;
-        loopword = -1;
-        loopIterations = 0;
-        reflectaFrames::reset();
-    }
-
-    /*  Here begins all of the Arduino-specific instructions.
-
-        Starting with basic setup and reading/write to GPIO pins. Note we treat HIGH/LOW values as
-        Brief-style booleans (-1 or 0) to play well with the logical and conditional operations. */
-
-    void pinMode()
-    {
-        ::pinMode(pop(), pop());
-    }
-
-    void digitalRead()
-    {
-        push(::digitalRead(pop()) ? -1 : 0);
-    }
-
-    void digitalWrite()
-    {
-        ::digitalWrite(pop(), pop() == 0 ? LOW : HIGH);
-    }
-
-    void analogRead()
-    {
-        push(::analogRead(pop()));
-    }
-
-    void analogWrite()
-    {
-        ::analogWrite(pop(), pop());
-    }
-
-    /*  I2C support comes from several instructions, essentially mapping composable, zero-operand
-        instructions to functions in the Arduino library:
-
-          http://arduino.cc/en/Reference/Wire
-
-        Brief words (addresses/quotations) may be hooked to respond to Wire events. */
-
-    /*
-    void wireBegin()
-    {
-        Wire.begin(); // join bus as master (slave not supported)
-    }
-
-    void wireRequestFrom()
-    {
-        Wire.requestFrom(pop(), pop());
-    }
-
-    void wireAvailable()
-    {
-        push(Wire.available());
-    }
-
-    void wireRead()
-    {
-        while (Wire.available() < 1); // TODO: blocking?
-        push(Wire.read());
-    }
-
-    void wireBeginTransmission()
-    {
-        Wire.beginTransmission((uint8_t)pop());
-    }
-
-    void wireWrite()
-    {
-        Wire.write((uint8_t)pop());
-    }
-
-    void wireEndTransmission()
-    {
-        Wire.endTransmission();
-    }
-
-    int16_t onReceiveWord = -1;
-
-    void wireOnReceive(int16_t count)
-    {
-        if (onReceiveWord != -1)
-        {
-            push(count);
-            exec(onReceiveWord);
-        }
-    }
-
-    void wireSetOnReceive()
-    {
-        onReceiveWord = pop();
-        Wire.onReceive(wireOnReceive);
-    }
-
-    int16_t onRequestWord = -1;
-
-    void wireOnRequest()
-    {
-        if (onRequestWord != -1)
-        {
-            exec(onRequestWord);
-        }
-    }
-
-    void wireSetOnRequest()
-    {
-        onRequestWord = pop();
-        Wire.onRequest(wireOnRequest);
-    }
-    */
-
-    /*  Brief word addresses (or quotations) may be set to run upon interrupts.  For more info on
-        the argument values and behavior, see:
-
-          http://arduino.cc/en/Reference/AttachInterrupt
-
-        We keep a mapping of up to MAX_INTERRUPTS (6) words. */
-
-    int16_t isrs[MAX_INTERRUPTS];
-
-    void interrupt(int16_t n) // helper (not Brief instruction)
-    {
-        int16_t w = isrs[n];
-        if (w != -1) exec(w);
-    }
-
-    void interrupt0() // helper (not Brief instruction)
-    {
-        interrupt(0);
-    }
-
-    void interrupt1() // helper (not Brief instruction)
-    {
-        interrupt(1);
-    }
-
-    void interrupt2() // helper (not Brief instruction)
-    {
-        interrupt(2);
-    }
-
-    void interrupt3() // helper (not Brief instruction)
-    {
-        interrupt(3);
-    }
-
-    void interrupt4() // helper (not Brief instruction)
-    {
-        interrupt(4);
-    }
-
-    void interrupt5() // helper (not Brief instruction)
-    {
-        interrupt(5);
-    }
-
-    void interrupt6() // helper (not Brief instruction)
-    {
-        interrupt(6);
-    }
-
-    void attachISR()
-    {
-        uint8_t mode = pop();
-        uint8_t interrupt = pop();
-        isrs[interrupt] = pop();
-        switch (interrupt)
-        {
-            case 0 : attachInterrupt(0, interrupt0, mode);
-            case 1 : attachInterrupt(1, interrupt1, mode);
-            case 2 : attachInterrupt(2, interrupt2, mode);
-            case 3 : attachInterrupt(3, interrupt3, mode);
-            case 4 : attachInterrupt(4, interrupt4, mode);
-            case 5 : attachInterrupt(5, interrupt5, mode);
-            case 6 : attachInterrupt(6, interrupt6, mode);
-        }
-    }
-
-    void detachISR()
-    {
-        int interrupt = pop();
-        isrs[interrupt] = -1;
-        detachInterrupt(interrupt);
-    }
-
-    /*  Servo support also comes by simple mapping of composable, zero-operand instructions to
-        Arduino library calls:
-
-          http://arduino.cc/en/Reference/Servo
-
-        We keep up to MAX_SERVOS (48) servo instances attached. */
-
-    /*
-    Servo servos[MAX_SERVOS];
-
-    void servoAttach()
-    {
-        int16_t pin = pop();
-        servos[pin].attach(pin);
-    }
-
-    void servoDetach()
-    {
-        servos[pop()].detach();
-    }
-
-    void servoWriteMicros()
-    {
-        servos[pop()].writeMicroseconds(pop());
-    }
-    */
-
-    // A couple of stragglers...
-
-    void milliseconds()
-    {
-        push(millis());
-    }
-
-    void pulseIn()
-    {
-        push(::pulseIn(pop(), pop()));
-    }
-
-    /*  The Brief VM needs to be hooked into the main setup and loop on the hosting project. It's
-        also expected that Reflecta framing is hooked.  A minimal *.ino would contain something like
-        what you find in the main Brief.ino.
-
-        Brief setup hooks into Reflecta framing, and binds all of the instruction functions from
-        above. After setup, the hosting project is free to bind its own custom functions as well! */
-
-    void setup()
-    {
-        // we want to allocate frames from the dictionary
-        reflectaFrames::setBufferAllocationCallback(frameAllocation);
-
-        // we want to process frames by executing bytecode
-        reflectaFrames::setFrameReceivedCallback(frameReceived);
-
-        resetBoard();
-
-        bind(0,  ret); // assumed in frameReceived
-        bind(1,  lit8);
-        bind(2,  lit16);
-        bind(3,  branch); // used only by IL translation
-        bind(4,  zbranch); // used only by IL translation
-        bind(5,  quote);
-        bind(6,  eventHeader);
-        bind(7,  eventBody8);
-        bind(8,  eventBody16);
-        bind(9,  eventFooter);
-        bind(10, eventOp);
-        bind(11, fetch8);
-        bind(12, store8);
-        bind(13, fetch16);
-        bind(14, store16);
-        bind(15, add);
-        bind(16, sub);
-        bind(17, mul);
-        bind(18, div);
-        bind(19, mod);
-        bind(20, andb);
-        bind(21, orb);
-        bind(22, xorb);
-        bind(23, shift);
-        bind(24, eq);
-        bind(25, neq);
-        bind(26, gt);
-        bind(27, geq);
-        bind(28, lt);
-        bind(29, leq);
-        bind(30, notb);
-        bind(31, neg);
-        bind(32, inc);
-        bind(33, dec);
-        bind(34, drop);
-        bind(35, dup);
-        bind(36, swap);
-        bind(37, pick);
-        bind(38, roll);
-        bind(39, clr);
-        bind(40, pushr);
-        bind(41, popr);
-        bind(42, peekr);
-        bind(43, forget);
-        bind(44, alloc);
-        bind(45, free);
-        bind(46, tail);
-        bind(47, local);
-        bind(48, localFetch16);
-        bind(49, localStore16);
-        bind(50, call);
-        bind(51, choice);
-        bind(52, chooseIf);
-        bind(53, loopTicks);
-        bind(54, setLoop);
-        bind(55, stopLoop);
-        bind(56, resetBoard);
-        bind(57, pinMode);
-        bind(58, digitalRead);
-        bind(59, digitalWrite);
-        bind(60, analogRead);
-        bind(61, analogWrite);
-        bind(62, attachISR);
-        bind(63, detachISR);
-        bind(64, milliseconds);
-        bind(65, pulseIn);
-
-        for (int16_t i = 0; i < MAX_INTERRUPTS; i++)
-        {
-            isrs[i] = -1;
-        }
-
-        event(BOOT_EVENT_ID, 0); // boot event
-    }
-
-    void loop()
-    {
-        if (loopword >= 0)
-        {
-            exec(loopword);
-            loopIterations++;
-        }
-    }
-}
+#include "Brief.h"
+#ifdef BRIEF_SNAPSHOT
+#include <avr/eeprom.h>
+#endif
+
+namespace brief
+{
+/*  The Brief VM revolves around a pair of stacks and a block of memory serving as a dictionary of
+    subroutines.
+
+    The dictionary is typically 1Kb. This is where Brief byte code is stored and executed. While it
+    can technically be used as general purpose memory, the intent is to treat it as a structured
+    space for definitions; subroutines, variables, and the like, all contiguously packed.
+
+    The two stacks are each eight cells of 16-bit signed integers (32-bit with BRIEF_CELL32). They
+    are used to store data and addresses. They are connected in that elements can be popped from the
+    top of one and pushed to the top of the other.
+
+    One stack is used as a data stack; persisting values across instructions and subroutine calls.
+    With very few exceptions, instructions get their operands only from the data stack. All
+    parameter passing between subroutines is done via this stack.
+
+    The other stack is used by the VM as a return stack. The program counter is pushed here before
+    jumping into a subroutine and is popped to return. Be careful not to nest subroutines more than
+    eight levels deep! Note that infinite tail recursion is possible none the less. */
+
+    void error(uint8_t code); // forward decl
+
+#ifdef BRIEF_VERIFIED
+    extern int16_t verifiedEnd; // forward decls (see verify() below)
+    extern uint8_t upsets;
+    bool verifiedCode(int16_t address);
+    void unverify(int16_t address);
+    void unverifyAll();
+    void forgetVerified();
+    void verify(int16_t start, int16_t end);
+    bool safe(int16_t address);
+    void runVerified();
+    bool verifiedAt(int16_t address);
+#endif
+
+#ifdef BRIEF_FUSED
+    void fuse(int16_t start, int16_t end); // forward decl (see below)
+#endif
+
+#ifdef BRIEF_COALESCED
+    void flushEventsDue(); // forward decl (see below)
+#endif
+
+#ifdef BRIEF_JIT
+#if defined(BRIEF_THREADED) || defined(BRIEF_VERIFIED) || defined(BRIEF_FUSED)
+#error BRIEF_JIT enters compiled code from the plain core and compiles unfused definitions only
+#endif
+#ifdef BRIEF_CELL32
+#error BRIEF_JIT compiles for 16-bit cells only
+#endif
+    bool jitCode(int16_t address); // forward decls (see host/BriefJit.cpp)
+    void jitFlush();
+    void jitRun();
+#endif
+
+#ifdef BRIEF_AOT
+#if defined(BRIEF_THREADED) || defined(BRIEF_VERIFIED) || defined(BRIEF_JIT)
+#error BRIEF_AOT enters compiled words from the plain core only
+#endif
+    void (*compiledWord(int16_t address))(); // forward decls (see below)
+    void staleCompiled(int16_t low, int16_t high);
+#endif
+
+    /*  All of the VM state lives in a Machine (see Brief.h); the primary one, set up by setup(), or
+        any other the hosting project selects. Everything below acts upon the selected machine. The
+        verifier, JIT and translated words keep their own state about a dictionary and serve the
+        primary machine only; others run on the interpreter alone.
+
+        With BRIEF_THREADS, each thread selects its own machine and may run it alongside others.
+        Whatever else is shared (the instruction table, Reflecta) is left to the primary machine and
+        the thread that set it up; other machines send events through their own sendEvent. */
+
+#ifdef BRIEF_THREADS
+#if defined(BRIEF_VERIFIED) || defined(BRIEF_JIT) || defined(BRIEF_AOT) || defined(BRIEF_PAIRS) || defined(BRIEF_BENCH) || \
+    defined(BRIEF_PROFILE) || defined(BRIEF_TRACE)
+#error BRIEF_THREADS runs the plain or threaded core, without shared counters
+#endif
+#endif
+
+    Machine primary; // set up by setup()
+#ifdef BRIEF_THREADS
+    thread_local Machine* vm = &primary; // selected machine (per thread)
+#else
+    Machine* vm = &primary; // selected machine
+#endif
+
+    void select(Machine& machine) // act upon another machine from now on
+    {
+        vm = &machine;
+    }
+
+#ifdef BRIEF_PROFILE
+#if defined(BRIEF_THREADED) || defined(BRIEF_VERIFIED) || defined(BRIEF_JIT) || defined(BRIEF_AOT)
+#error BRIEF_PROFILE counts within the plain core only
+#endif
+    /*  Profiling, selected with BRIEF_PROFILE, for finding where the cycles go on the board itself.
+        run() counts each instruction executed and each call to a definition, and times definitions
+        from call to return with micros(); inclusive of whatever they call in turn. The deepest each
+        stack has been is kept as well. The 'profile' instruction sends it all up to the PC.
+
+        Only the first PROFILE_WORDS definitions called are counted and timed. A tail call is
+        counted but its time goes to the caller. Counts stick at 0xFFFF rather than wrap. */
+
+    struct ProfiledWord
+    {
+        int16_t address; // definition
+        uint16_t calls;
+        uint32_t micros; // inclusive
+    };
+
+    uint16_t profileCounts[MAX_PRIMITIVES]; // instructions executed
+    ProfiledWord profileWords[PROFILE_WORDS];
+    uint8_t profileWordCount = 0;
+    int8_t profileFrames[RETURN_STACK_SIZE]; // word timed from each return stack level (-1 if none)
+    uint32_t profileStarts[RETURN_STACK_SIZE]; // micros() upon calling it
+    uint8_t profileDepth = 0; // deepest data stack
+    uint8_t profileRdepth = 0; // deepest return stack
+
+    inline void profileCount(uint16_t& count) // helper (not Brief instruction)
+    {
+        if (count != 0xFFFF) count++;
+    }
+
+    void profileCall(int16_t address) // helper (not Brief instruction); upon calling (return pushed)
+    {
+        uint8_t w = 0;
+        while (w < profileWordCount && profileWords[w].address != address) w++;
+        if (w == profileWordCount)
+        {
+            if (w == PROFILE_WORDS) return; // no room to count another
+            profileWords[w].address = address;
+            profileWords[w].calls = 0;
+            profileWords[w].micros = 0;
+            profileWordCount++;
+        }
+        profileCount(profileWords[w].calls);
+        int16_t level = vm->r - vm->rstack;
+        if (level >= 0 && profileFrames[level] < 0) // (a tail call finds its caller's there)
+        {
+            profileFrames[level] = w;
+            profileStarts[level] = micros();
+        }
+    }
+
+    void profileReturn() // helper (not Brief instruction); upon returning (before popping)
+    {
+        int16_t level = vm->r - vm->rstack;
+        if (level >= 0 && profileFrames[level] >= 0)
+        {
+            profileWords[profileFrames[level]].micros += micros() - profileStarts[level];
+            profileFrames[level] = -1;
+        }
+    }
+
+    void profileDepths() // helper (not Brief instruction)
+    {
+        uint8_t depth = vm->s - vm->dstackCells, rdepth = vm->r - vm->rstack + 1;
+        if (depth > profileDepth) profileDepth = depth;
+        if (rdepth > profileRdepth) profileRdepth = rdepth;
+    }
+#endif
+
+#ifdef BRIEF_TRACE
+#if defined(BRIEF_THREADED) || defined(BRIEF_VERIFIED) || defined(BRIEF_JIT) || defined(BRIEF_AOT)
+#error BRIEF_TRACE records within the plain core only
+#endif
+    /*  Tracing, selected with BRIEF_TRACE, for finding out what went wrong in the field. A ring of
+        the last TRACE_SIZE records is kept of everything that steers the VM:
+
+          Kind    op           a            b
+          STEP    instruction  address      top of stack (0 if empty); each instruction or call run
+          EXEC    depth        address      here; each exec(), followed by
+          STATE   -            locals       loop iterations, and
+          CELL    index        cell         (high half); each item on the data stack, bottom first
+          INPUT   instruction  value        (high half); digitalRead, analogRead, milliseconds, pulseIn
+                                            and fetches from free space (left over; see below)
+          STORE   old byte     address      -; each store, other than into free space
+          FRAME   length       sequence     (high byte); each frame received, followed by
+          BYTES   byte         two bytes    two more; its bytes, five to a record
+          ERROR   code         -            -
+
+        Recording an instruction costs a few stores into the ring. The ring is sent up upon request
+        or upon an error ('trace', below) along with the dictionary beneath 'here' and the locals
+        above 'locals'. Free space between holds events being packed and code sent to run at once;
+        neither of which is replayed from there, so whatever is fetched from it is recorded.
+
+        replay() runs a trace again upon a machine loaded with what was sent up. Stores are undone
+        back to the first exec() in the ring and from there the VM runs as it did, taking inputs and
+        frames from the trace rather than the hardware and checking every instruction, store and
+        error against what was recorded. Interrupt words run in the midst of others don't replay. */
+
+    TraceRecord trace[TRACE_SIZE]; // ring
+    uint16_t traceNext = 0; // where the next record goes
+    bool traceWrapped = false; // ring full (oldest at traceNext)
+    bool traceArmed = false; // send up upon error
+    bool traceSending = false;
+
+    const TraceRecord* replaying = 0; // trace being replayed (0 when recording)
+    uint16_t replayNext, replayCount; // next record expected, number of records
+    int32_t replayStopped = -1; // record went astray at (or replayCount at the end)
+    bool replayStarted; // past the first exec()
+
+    void traceRecord(uint8_t kind, uint8_t op, int16_t a, int16_t b) // helper (not Brief instruction)
+    {
+        TraceRecord* t = &trace[traceNext];
+        t->kind = kind;
+        t->op = op;
+        t->a = a;
+        t->b = b;
+        if (++traceNext == TRACE_SIZE)
+        {
+            traceNext = 0;
+            traceWrapped = true;
+        }
+    }
+
+    const TraceRecord* traceReplay(uint8_t kind) // helper (not Brief instruction); next expected record
+    {
+        if (replayStopped >= 0) return 0;
+        if (replayNext == replayCount || replaying[replayNext].kind != kind)
+        {
+            replayStopped = replayNext; // gone astray (or reached the end)
+            return 0;
+        }
+        return &replaying[replayNext++];
+    }
+
+    bool astray(const TraceRecord* t, bool same) // helper (not Brief instruction)
+    {
+        if (t != 0 && !same) replayStopped = t - replaying;
+        return replayStopped >= 0;
+    }
+
+    bool traceStep(uint8_t i) // helper (not Brief instruction); upon each instruction (p just past it)
+    {
+        int16_t address = vm->p - 1, tos = vm->s > vm->dstackCells ? *vm->s : 0;
+        if (replaying == 0)
+        {
+            traceRecord(TRACE_STEP, i, address, tos);
+            return true;
+        }
+        const TraceRecord* t = traceReplay(TRACE_STEP);
+        return !astray(t, t != 0 && t->op == i && t->a == address && t->b == tos);
+    }
+
+    Cell traceInput(uint8_t i, Cell value) // helper (not Brief instruction); value read (or replayed)
+    {
+        if (replaying == 0)
+        {
+            traceRecord(TRACE_INPUT, i, value, (int32_t)value >> 16);
+            return value;
+        }
+        const TraceRecord* t = traceReplay(TRACE_INPUT);
+        if (astray(t, t != 0 && t->op == i)) return value;
+        return (Cell)((uint16_t)t->a | (int32_t)t->b << 16);
+    }
+
+    Cell traceFetch(uint8_t i, Cell address, Cell value) // helper (not Brief instruction)
+    {
+        if (address < vm->here || address >= vm->locals) return value;
+        return traceInput(i, value); // (free space)
+    }
+
+    void traceStore(int16_t address) // helper (not Brief instruction); before storing
+    {
+        if (address >= vm->here && address < vm->locals) return; // (free space)
+        if (replaying == 0)
+        {
+            traceRecord(TRACE_STORE, vm->memory[address], address, 0);
+            return;
+        }
+        const TraceRecord* t = traceReplay(TRACE_STORE);
+        astray(t, t != 0 && t->a == address);
+    }
+
+    bool traceExec(int16_t address) // helper (not Brief instruction); return stack reset, p set
+    {
+        uint8_t depth = vm->s - vm->dstackCells;
+        Cell* stack = vm->dstack();
+        if (replaying == 0)
+        {
+            traceRecord(TRACE_EXEC, depth, address, vm->here);
+            traceRecord(TRACE_STATE, 0, vm->locals, vm->loopIterations);
+            for (uint8_t i = 0; i < depth; i++) traceRecord(TRACE_CELL, i, stack[i], (int32_t)stack[i] >> 16);
+            return true;
+        }
+        const TraceRecord* t = traceReplay(TRACE_EXEC);
+        bool same = t != 0 && t->a == address && (t->op == depth || !replayStarted);
+        if (astray(t, same)) return false;
+        vm->here = t->b; // (state outside of the code itself, as it was)
+        vm->s = vm->dstackCells + t->op;
+        t = traceReplay(TRACE_STATE);
+        if (astray(t, true)) return false;
+        vm->locals = t->a;
+        vm->loopIterations = t->b;
+        for (uint8_t i = 0; i < vm->s - vm->dstackCells; i++)
+        {
+            t = traceReplay(TRACE_CELL);
+            Cell x = t != 0 ? (Cell)((uint16_t)t->a | (int32_t)t->b << 16) : 0;
+            if (astray(t, t != 0 && t->op == i && (x == stack[i] || !replayStarted))) return false;
+            stack[i] = x;
+        }
+        replayStarted = true;
+        return true;
+    }
+
+    void traceFrame(uint8_t sequence, uint16_t length, const uint8_t* frame) // helper (not Brief instruction)
+    {
+        if (replaying == 0)
+        {
+            traceRecord(TRACE_FRAME, length, sequence, length >> 8);
+            for (uint16_t i = 0; i < length; i += 5)
+            {
+                uint8_t f[5];
+                for (uint8_t k = 0; k < 5; k++) f[k] = i + k < length ? frame[i + k] : 0;
+                traceRecord(TRACE_BYTES, f[0], f[1] << 8 | f[2], f[3] << 8 | f[4]);
+            }
+            return;
+        }
+        const TraceRecord* t = traceReplay(TRACE_FRAME);
+        if (astray(t, t != 0 && (uint16_t)(t->op | t->b << 8) == length && t->a == sequence)) return;
+        for (uint16_t i = 0; i < length; i += 5) traceReplay(TRACE_BYTES); // (bytes put in place by replay())
+    }
+
+    void traceError(uint8_t code) // helper (not Brief instruction)
+    {
+        if (replaying == 0)
+        {
+            traceRecord(TRACE_ERROR, code, 0, 0);
+            return;
+        }
+        const TraceRecord* t = traceReplay(TRACE_ERROR);
+        astray(t, t != 0 && t->op == code);
+    }
+
+#define TRACED(i, x) traceInput(i, x)
+#define TRACED_FETCH(i, a, x) traceFetch(i, a, x)
+#else
+#define TRACED(i, x) (x)
+#define TRACED_FETCH(i, a, x) (x)
+#endif
+
+    /*  Memory (dictionary)
+
+        With BRIEF_ROM, addresses from ROM_BASE up are those of the library built into flash (rom[],
+        see Brief.h); fetched from there by the very same mem() as the dictionary, only once past
+        the bounds check, so that code and data (quotations, tables) in either are alike to run() and
+        to every instruction. Calls go back and forth between library and dictionary words, with
+        quotations passed either way. The library is read-only; storing into it is an error (as it
+        is beyond the dictionary). Only the plain core fetches through mem() alone; the others read
+        the dictionary directly. */
+
+#ifdef BRIEF_ROM
+#if defined(BRIEF_THREADED) || defined(BRIEF_VERIFIED) || defined(BRIEF_JIT) || defined(BRIEF_AOT)
+#error BRIEF_ROM runs library words within the plain core only
+#endif
+#if ROM_BASE < MEM_SIZE || ROM_BASE > 0x7FFF
+#error ROM_BASE must lie above the dictionary, within 15-bit call addresses
+#endif
+    inline bool inRom(Cell address) // helper (not Brief instruction)
+    {
+        return address >= ROM_BASE && address < ROM_BASE + romSize;
+    }
+#endif
+
+#ifdef BRIEF_PAGED
+#if defined(BRIEF_THREADED) || defined(BRIEF_VERIFIED) || defined(BRIEF_JIT) || defined(BRIEF_AOT)
+#error BRIEF_PAGED pages code in within the plain core only
+#endif
+#if defined(BRIEF_THREADS) || defined(BRIEF_TRACE) || defined(BRIEF_SNAPSHOT)
+#error BRIEF_PAGED keeps a single cache, outside of traces and snapshots (the storage persists)
+#endif
+#if PAGED_BASE < MEM_SIZE || PAGED_LIMIT > 0x8000 || PAGED_BASE % PAGE_SIZE != 0 || (PAGE_SIZE & (PAGE_SIZE - 1)) != 0
+#error PAGED_BASE must lie above the dictionary, on a page, and pages be a power of two within 15-bit addresses
+#endif
+#if (PREFETCH_QUEUE & (PREFETCH_QUEUE - 1)) != 0
+#error PREFETCH_QUEUE must be a power of two
+#endif
+#if defined(BRIEF_ROM) && PAGED_LIMIT > ROM_BASE
+#error PAGED_LIMIT must be no higher than ROM_BASE
+#endif
+    /*  The paged dictionary, selected with BRIEF_PAGED, for dictionaries outgrowing the board's RAM.
+        Addresses from PAGED_BASE to PAGED_LIMIT are those of external storage (pageRead/pageWrite,
+        see Brief.h), RESIDENT_PAGES of which are held in RAM at a time. As with the ROM library
+        they're reached by mem() and memset() once past the bounds check, so that run() and every
+        instruction take them as they would the dictionary; words there call those in RAM and in
+        ROM, and are called by them. Stores mark the page, written back once it's evicted (or upon
+        pageFlush()); the least recently used page goes first.
+
+        Calls are noted as they're decoded, ahead of jumping, when they go into a page not resident
+        (about to miss); the first PREFETCH_QUEUE of them a pass. The loop word goes the same way
+        pass after pass, so once it has run loop() brings in the pages those fall in, most recently
+        used of all, and the next pass finds the first pages it calls into already there; a working
+        set larger than the pages resident misses the fewer within a pass, storage read between
+        passes instead (see pagePrefetching in Brief.h).
+
+        A definition is sent to be paged with a trailing 2 rather than 1 (see frameReceived); it's
+        received into the dictionary's free space as ever, then copied to the paged 'here'. The PC
+        keeps the two addresses apart. The compiler (Compiler/Interface.fs) has no counterpart yet,
+        keeping but the one; for now paged definitions are sent by hosting projects themselves (see
+        host/paged.cpp). 'forget' below the paged 'here' takes it back, and
+        resetBoard takes it back to PAGED_BASE; pages already written are left as they are.
+
+          paging  clear -  send PAGING_EVENT_ID: hits, misses, prefetches, prefetches used, pages
+                           written back (16-bit each, saturating) and the paged 'here'; clearing the
+                           counts if the flag is non-zero */
+
+    struct Resident // page held in RAM
+    {
+        int16_t page; // (-1 if none)
+        uint16_t used; // residentTick upon last use
+        bool dirty; // stored into since read
+        bool prefetched; // brought in ahead, unused since
+        uint8_t bytes[PAGE_SIZE];
+    };
+
+    Resident resident[RESIDENT_PAGES];
+    uint8_t residentLast = 0; // slot last used (tried first)
+    uint16_t residentTick = 0;
+    int16_t prefetchQueue[PREFETCH_QUEUE]; // addresses called into pages not resident
+    uint8_t prefetchHead = 0, prefetchTail = 0; // next written and read
+    uint32_t pageHits = 0, pageMisses = 0, pagePrefetches = 0, pagePrefetchesUsed = 0, pageWrites = 0;
+    bool pagePrefetching = true;
+
+    inline bool inPaged(Cell address) // helper (not Brief instruction)
+    {
+        return address >= PAGED_BASE && address < PAGED_LIMIT;
+    }
+
+    void pagesReset() // helper (not Brief instruction); nothing resident
+    {
+        for (uint8_t i = 0; i < RESIDENT_PAGES; i++) resident[i].page = -1;
+        prefetchHead = prefetchTail = 0;
+    }
+
+    Resident* pageIn(int16_t page) // helper (not Brief instruction); into the least recently used slot
+    {
+        uint8_t victim = 0;
+        for (uint8_t i = 0; i < RESIDENT_PAGES; i++)
+        {
+            if (resident[i].page < 0) // (free)
+            {
+                victim = i;
+                break;
+            }
+            if ((uint16_t)(residentTick - resident[i].used) > (uint16_t)(residentTick - resident[victim].used)) victim = i;
+        }
+        Resident* r = &resident[victim];
+        if (r->page >= 0 && r->dirty)
+        {
+            pageWrite(r->page, r->bytes);
+            pageWrites++;
+        }
+        pageRead(page, r->bytes);
+        r->page = page;
+        r->dirty = r->prefetched = false;
+        r->used = residentTick;
+        return r;
+    }
+
+    Resident* findResident(int16_t page) // helper (not Brief instruction); slot holding page (0 if none)
+    {
+        for (uint8_t i = 0; i < RESIDENT_PAGES; i++)
+        {
+            if (resident[i].page == page)
+            {
+                residentLast = i;
+                return &resident[i];
+            }
+        }
+        return 0;
+    }
+
+    uint8_t* paged(Cell address) // helper (not Brief instruction); byte at address, paging it in if need be
+    {
+        int16_t page = (address - PAGED_BASE) / PAGE_SIZE;
+        int16_t offset = (address - PAGED_BASE) & (PAGE_SIZE - 1);
+        Resident* r = &resident[residentLast];
+        if (r->page != page && (r = findResident(page)) == 0)
+        {
+            pageMisses++;
+            r = pageIn(page);
+            residentLast = r - resident;
+        }
+        else
+        {
+            pageHits++;
+        }
+        r->used = ++residentTick;
+        if (r->prefetched)
+        {
+            r->prefetched = false;
+            pagePrefetchesUsed++;
+        }
+        return r->bytes + offset;
+    }
+
+    void called(int16_t target) // helper (not Brief instruction); call decoded into paged space, noted if about to miss
+    {
+        if ((uint8_t)(prefetchHead - prefetchTail) == PREFETCH_QUEUE) return; // (the first of the pass noted)
+        int16_t page = (target - PAGED_BASE) / PAGE_SIZE;
+        for (uint8_t i = 0; i < RESIDENT_PAGES; i++)
+        {
+            if (resident[i].page == page) return;
+        }
+        prefetchQueue[prefetchHead++ & (PREFETCH_QUEUE - 1)] = target;
+    }
+
+    void prefetch() // helper (not Brief instruction); pages called into but not resident this pass, ahead of the next (by loop())
+    {
+        for (uint8_t n = prefetchHead - prefetchTail; n > 0; n--)
+        {
+            int16_t page = (prefetchQueue[prefetchTail++ & (PREFETCH_QUEUE - 1)] - PAGED_BASE) / PAGE_SIZE;
+            if (!pagePrefetching || findResident(page) != 0) continue;
+            Resident* r = pageIn(page);
+            r->used = ++residentTick; // (not the next evicted)
+            r->prefetched = true;
+            pagePrefetches++;
+        }
+    }
+
+    void pageFlush()
+    {
+        for (uint8_t i = 0; i < RESIDENT_PAGES; i++)
+        {
+            Resident& r = resident[i];
+            if (r.page < 0 || !r.dirty) continue;
+            pageWrite(r.page, r.bytes);
+            pageWrites++;
+            r.dirty = false;
+        }
+    }
+#endif
+
+    uint8_t mem(Cell address) // fetch with bounds checking
+    {
+        if (!Machine::inMemory(address))
+        {
+#ifdef BRIEF_ROM
+            if (inRom(address)) return pgm_read_byte(rom + (address - ROM_BASE));
+#endif
+#ifdef BRIEF_PAGED
+            if (inPaged(address)) return *paged(address);
+#endif
+            error(VM_ERROR_OUT_OF_MEMORY);
+            return 0;
+        }
+        else
+        {
+            return vm->memory[address];
+        }
+    }
+
+    void memset(Cell address, uint8_t value) // store with bounds checking
+    {
+        if (!Machine::inMemory(address))
+        {
+#ifdef BRIEF_PAGED
+            if (inPaged(address))
+            {
+                uint8_t* b = paged(address);
+                if (*b != value) resident[residentLast].dirty = true;
+                *b = value;
+                return;
+            }
+#endif
+            error(VM_ERROR_OUT_OF_MEMORY);
+        }
+        else
+        {
+#ifdef BRIEF_VERIFIED
+            if (address < verifiedEnd && vm == &primary && verifiedCode(address)) unverify(address); // modifying verified code
+#endif
+#ifdef BRIEF_JIT
+            if (jitCode(address)) jitFlush(); // modifying compiled code
+#endif
+#ifdef BRIEF_AOT
+            if (address < imageSize) staleCompiled(address, address + 1); // modifying translated code
+#endif
+#ifdef BRIEF_TRACE
+            traceStore(address);
+#endif
+            vm->memory[address] = value;
+        }
+    }
+
+    // Data stack (and args in Brief semantics)
+
+    void push(Cell x)
+    {
+        if (!vm->canPush())
+        {
+            vm->s = vm->dstackCells;
+            error(VM_ERROR_DATA_STACK_OVERFLOW);
+        }
+        else
+        {
+            *(++vm->s) = x;
+        }
+    }
+
+    Cell pop()
+    {
+        if (!vm->canPop())
+        {
+            vm->s = vm->dstackCells;
+            error(VM_ERROR_DATA_STACK_UNDERFLOW);
+            return 0;
+        }
+        else
+        {
+            return *vm->s--;
+        }
+    }
+
+    // Return stack (and locals in Brief)
+
+    void rpush(Cell x)
+    {
+        if (!vm->canRpush())
+        {
+            error(VM_ERROR_RETURN_STACK_OVERFLOW);
+        }
+        else
+        {
+            *(++vm->r) = x;
+#ifdef BRIEF_PROFILE
+            profileFrames[vm->r - vm->rstack] = -1; // not (yet) a timed call
+#endif
+        }
+    }
+
+    Cell rpop()
+    {
+        if (!vm->canRpop())
+        {
+            error(VM_ERROR_RETURN_STACK_UNDERFLOW);
+            return 0;
+        }
+        else
+        {
+            return *vm->r--;
+        }
+    }
+
+/*  Brief instructions are single bytes with the high bit reset:
+
+      0xxxxxxx
+
+    The lower seven bits become essentially an index into a function table.  Each may consume
+    and/or produce values on the data stack as well as having other side effects. Only three
+    instructions manipulate the return stack.  Two are push and pop which move values between the
+    data and return stack.  The third is (return); popping an address at which execution continues.
+
+    It is extremely common to factor out redundant sequences of code into subroutines. There is no
+    "call" instruction. Instead, if the high bit is set then the following byte is taken and
+    together (in little endian), with the high bit reset, they become an address to be called.
+
+      1xxxxxxxxxxxxxxx
+
+    This allows 15-bit addressing to definitions in the dictionary.
+
+    Upon calling, the VM pushes the current program counter to the return stack. There is a return
+    instruction, used to terminate definitions, which pops the return stack to continue execution
+    after the call. */
+
+    void (*instructions[MAX_PRIMITIVES])(); // instruction function table
+
+#ifdef BRIEF_THREADED
+    bool rebound = true; // instruction table changed since the threaded dispatch table was built
+#endif
+
+#ifdef BRIEF_VERIFIED
+    uint8_t custom[MAX_PRIMITIVES / 8]; // bit per instruction; bound after setup
+#endif
+
+    void bind(uint8_t i, void (*f)()) // add function to instruction table
+    {
+        instructions[i] = f;
+#ifdef BRIEF_THREADED
+        rebound = true;
+#endif
+#ifdef BRIEF_VERIFIED
+        custom[i >> 3] |= 1 << (i & 7); // no longer the built-in the verifier knows
+        unverifyAll();
+#endif
+#ifdef BRIEF_JIT
+        jitFlush();
+#endif
+    }
+
+#ifdef BRIEF_BENCH
+    uint32_t dispatches = 0; // instructions and calls dispatched by run()
+#endif
+
+#ifdef BRIEF_PAIRS
+#if defined(BRIEF_THREADED) || defined(BRIEF_VERIFIED)
+#error BRIEF_PAIRS counts within the plain core only
+#endif
+    uint32_t pairs[MAX_PRIMITIVES][MAX_PRIMITIVES]; // adjacent instructions run one after the other
+#endif
+
+    uint8_t length(uint8_t i) // helper (not Brief instruction); bytes taken by instruction or call
+    {
+        if ((i & 0x80) || i == 1 || (i >= 3 && i <= 5)) return 2; // call, lit8, branch, zbranch, quote
+        return i == 2 ? 3 : 1; // lit16 or otherwise no operands
+    }
+
+    void ret() // return instruction
+    {
+#ifdef BRIEF_PROFILE
+        profileReturn();
+#endif
+        vm->p = rpop();
+    }
+
+#ifndef BRIEF_THREADED
+    void run() // run code at p
+    {
+        int16_t i;
+#ifdef BRIEF_BENCH
+        uint32_t count = 0;
+#endif
+#ifdef BRIEF_PAIRS
+        uint8_t previous = 0; // last instruction
+        int16_t following = -1; // address just past it
+#endif
+        do
+        {
+#ifdef BRIEF_BENCH
+            count++;
+#endif
+#ifdef BRIEF_PAIRS
+            if ((uint16_t)vm->p < MEM_SIZE)
+            {
+                if (vm->p == following && vm->memory[vm->p] < MAX_PRIMITIVES) pairs[previous][vm->memory[vm->p]]++;
+                previous = vm->memory[vm->p];
+                following = previous < MAX_PRIMITIVES ? vm->p + length(previous) : -1;
+            }
+#endif
+            i = mem(vm->p++);
+#ifdef BRIEF_TRACE
+            if (!traceStep(i)) break; // replay gone astray (or done)
+#endif
+            if ((i & 0x80) == 0) // instruction?
+            {
+#ifdef BRIEF_PROFILE
+                profileCount(profileCounts[i]);
+#endif
+                instructions[i](); // execute instruction
+            }
+            else // address to call
+            {
+                if (mem(vm->p + 1) != 0) // not followed by return (TCO)
+                    rpush(vm->p + 1); // return address
+                vm->p = ((i << 8) & 0x7F00) | mem(vm->p); // jump
+#ifdef BRIEF_PAGED
+                if (inPaged(vm->p)) called(vm->p);
+#endif
+#ifdef BRIEF_PROFILE
+                profileCall(vm->p);
+#endif
+#ifdef BRIEF_VERIFIED
+                if (safe(vm->p)) runVerified(); // unchecked until it returns
+#endif
+#ifdef BRIEF_JIT
+                jitRun(); // natively if compiled (until it returns)
+#endif
+#ifdef BRIEF_AOT
+                void (*word)() = compiledWord(vm->p);
+                if (word != 0)
+                {
+                    word(); // natively until it returns
+                    vm->p = rpop();
+                }
+#endif
+            }
+#ifdef BRIEF_PROFILE
+            profileDepths();
+#endif
+#ifdef BRIEF_FUEL
+            if (vm->fuel >= 0 && (vm->fuel == 0 || --vm->fuel == 0)) break; // slice run out (or yielded)
+#endif
+        } while (vm->p >= 0); // -1 pushed to return stack
+#ifdef BRIEF_BENCH
+        dispatches += count;
+#endif
+    }
+#else
+    void run(); // threaded core (below)
+#endif
+
+    void exec(int16_t address) // execute code at given address
+    {
+        vm->r = vm->rstack - 1; // reset return stack
+        vm->p = address;
+        rpush(-1); // causing run() to fall through upon completion
+#ifdef BRIEF_PROFILE
+        if (address < vm->here) profileCall(address); // a definition (not code sent to run at once)
+#endif
+#ifdef BRIEF_TRACE
+        if (!traceExec(address)) return; // replay gone astray (or done)
+#endif
+#ifdef BRIEF_VERIFIED
+        if (safe(address))
+        {
+            runVerified();
+            if (vm->p < 0) return; // ran to completion
+        }
+#endif
+#ifdef BRIEF_JIT
+        jitRun();
+        if (vm->p < 0) return; // ran to completion
+#endif
+#ifdef BRIEF_AOT
+        void (*word)() = compiledWord(address);
+        if (word != 0)
+        {
+            word(); // natively
+            return;
+        }
+#endif
+        run();
+    }
+
+    void step() // execute just the one instruction (or call) at p
+    {
+        int16_t i = mem(vm->p++);
+        if ((i & 0x80) == 0) // instruction?
+        {
+            instructions[i]();
+        }
+        else // address to call
+        {
+            if (mem(vm->p + 1) != 0) rpush(vm->p + 1); // not followed by return (TCO)
+            vm->p = ((i << 8) & 0x7F00) | mem(vm->p);
+        }
+    }
+
+#ifdef BRIEF_FUEL
+    /*  Either core counts instructions (and calls) down from the machine's fuel, leaving off once it
+        runs out; p and the stacks then being just as they were, to carry on from later. Verified
+        definitions run checked meanwhile, so as to be counted. Outside of slices fuel is -1, for no
+        limit.
+
+        The 'yield' instruction ends the running slice there and then. */
+
+    bool run(int16_t fuel)
+    {
+        vm->fuel = fuel;
+        if (vm->p >= 0) run();
+        vm->fuel = -1;
+        return vm->p < 0;
+    }
+
+    void yield()
+    {
+#ifdef BRIEF_TASKS
+        if (vm->task >= 0) vm->fuel = 0; // (tasks without a budget run with no limit)
+#endif
+        if (vm->fuel > 0) vm->fuel = 0;
+    }
+#endif
+
+/*  Reflecta handles the framing protocol. This includes the sequence numbers, CRC checks, etc.
+
+    We hook our own frameAllocation function which simply allocates directly from the next available
+    space in the dictionary. This means Reflecta will write definitions exactly where they belong
+    and we avoid a copy.
+
+    We also hook our own frameReceived function to process bytecode sent down. The last byte of the 
+    frame indicates whether it is to be executed immediately (0) or is a definition (1) to remain in
+    the dictionary.
+
+    The payload from the PC to the MCU is in the form of Brief code. A trailing byte indicates
+    whether the code is to be executed immediately (0x00) or appended to the dictionary as a new
+    definition (0x01).
+
+    A dictionary pointer is maintained at the MCU. This pointer always references the first
+    available free byte of dictionary space (beginning at address 0x0000). Each definition sent to
+    the MCU is appended to the end of the dictionary and advances the pointer. The bottom end of the
+    dictionary space is used for locals/arguments (mainly for IL, not idiomatic Brief).
+
+    If code is a definition then it is expected to already be terminated by a return instruction (if
+    appropriate) and so we do nothing at all; just leave it in place and leave the 'here' pointer
+    alone.
+
+    If code is to be executed immediately then a return instruction is appended and exec(...) is
+    called on it. The dictionary pointer ('here') is restored; reclaiming this memory. */
+
+#ifdef BRIEF_SLICED
+    int16_t queueEnd(); // forward decls (see slices below)
+    bool hold(uint16_t frameLength, uint8_t* frame);
+    void begin(int16_t address, int16_t held);
+#endif
+
+    uint16_t frameAllocation(uint8_t** frameBuffer)
+    {
+        // allocate Reflecta frame buffer from dictionary space; all that's free beneath the locals
+        // (frames are delimited, not counted, so needn't fit a byte's length)
+        int16_t start = vm->here;
+#ifdef BRIEF_SLICED
+        if (vm->held >= 0 || vm->queued > 0) start = queueEnd() + 2; // to be held (after its length)
+#endif
+        *frameBuffer = vm->memory + start;
+        return start < vm->locals ? vm->locals - start : 0;
+    }
+
+    void frameReceived(uint8_t sequence, uint16_t frameLength, uint8_t* frame)
+    {
+        // process Reflecta frame containing Brief bytecode
+#ifdef BRIEF_TRACE
+        traceFrame(sequence, frameLength, frame);
+#endif
+#ifdef BRIEF_SLICED
+        if (hold(frameLength, frame)) return; // until the code left part way is done
+#endif
+#ifdef BRIEF_PAGED
+        if (frame[frameLength - 1] == 2) // definition to be paged
+        {
+            if (vm->paged + frameLength - 1 > PAGED_LIMIT)
+            {
+                error(VM_ERROR_OUT_OF_MEMORY);
+                return;
+            }
+            vm->last = vm->paged;
+            for (uint16_t i = 0; i < frameLength - 1; i++) memset(vm->paged++, frame[i]);
+            return;
+        }
+#endif
+        vm->last = vm->here;
+        vm->here += frameLength - 1; // -1 not including exec/def flag
+        bool isExec = vm->memory[vm->here] == 0;
+        if (isExec)
+        {
+            memset(vm->here++, 0); // return instruction
+        }
+        if (vm->here > vm->locals)
+        {
+            error(VM_ERROR_OUT_OF_MEMORY);
+        }
+        else if (isExec)
+        {
+            vm->here = vm->last;
+#ifdef BRIEF_SLICED
+            begin(vm->here, frameLength); // (code and return instruction)
+#else
+            exec(vm->here);
+#endif
+        }
+#if defined(BRIEF_VERIFIED) || defined(BRIEF_FUSED)
+        else
+        {
+#ifdef BRIEF_VERIFIED
+            verify(vm->last, vm->here); // before fusing; the verifier knows only the plain instructions
+#endif
+#ifdef BRIEF_FUSED
+            fuse(vm->last, vm->here);
+#endif
+        }
+#endif
+#ifdef BRIEF_COALESCED
+        flushEventsDue(); // (answering the PC without waiting on loop())
+#endif
+    }
+
+#ifdef BRIEF_SLICED
+#if defined(BRIEF_JIT) || defined(BRIEF_AOT) || defined(BRIEF_TRACE)
+#error BRIEF_SLICED leaves off within the plain or threaded core only
+#endif
+    /*  Slices, selected with BRIEF_SLICED, so that long running code doesn't keep the hosting
+        project from getting back around to reflectaFrames::loop(). Serial bytes arriving meanwhile
+        would overflow the receive buffer, showing up at the PC as CRC and sequence errors.
+
+        Code sent to run at once and each pass of the loop word run SLICE_FUEL instructions at a
+        time (see run(fuel)); the first slice of code sent upon its arrival and the rest from
+        loop(), one slice each time around. Frames keep arriving in between. They're held in the
+        order received, each its length (2 bytes) then the frame, in free space just beyond the code being
+        run (code sent sits at 'here'), and dealt with once it's done; definitions then landing just
+        where the PC expects. While a slice runs, events are packed beyond them all.
+
+        Periodic words (BRIEF_PERIODIC) run to completion in between slices, leaving the code left
+        part way (p and the return stack) as it was, and packing their events clear of it and the
+        frames held. They share the data stack with it, as the loop word shares it with code sent
+        from the PC. */
+
+    int16_t queueEnd() // helper (not Brief instruction); just past code left part way and frames held
+    {
+        if (vm->queued > 0) return vm->queue + vm->queued;
+        return vm->here + (vm->held > 0 ? vm->held : 0);
+    }
+
+    void move(int16_t to, int16_t from, int16_t count) // helper (not Brief instruction); overlapping either way
+    {
+        if (to < from)
+        {
+            for (int16_t k = 0; k < count; k++) vm->memory[to + k] = vm->memory[from + k];
+        }
+        else if (to > from)
+        {
+            for (int16_t k = count - 1; k >= 0; k--) vm->memory[to + k] = vm->memory[from + k];
+        }
+    }
+
+    bool hold(uint16_t frameLength, uint8_t* frame) // helper (not Brief instruction); true if it's to wait its turn
+    {
+        int16_t at = frame - vm->memory;
+        if (vm->held < 0 && (at == vm->here || vm->queued == 0)) // its turn (or nothing to wait for)
+        {
+            move(vm->here, at, frameLength); // (if allocated while something was left part way)
+            return false;
+        }
+        int16_t end = queueEnd();
+        if (end + 2 + frameLength > vm->locals) // (clear of locals allocated meanwhile)
+        {
+            error(VM_ERROR_OUT_OF_MEMORY);
+            return true; // (dropped)
+        }
+        if (vm->queued == 0) vm->queue = end;
+        move(end + 2, at, frameLength);
+        vm->memory[end] = frameLength >> 8;
+        vm->memory[end + 1] = frameLength;
+        vm->queued += 2 + frameLength;
+        return true;
+    }
+
+    void unqueue() // helper (not Brief instruction); deal with the next frame held
+    {
+        uint16_t frameLength = vm->memory[vm->queue] << 8 | vm->memory[vm->queue + 1];
+        move(vm->here, vm->queue + 2, frameLength);
+        vm->queue += 2 + frameLength;
+        vm->queued -= 2 + frameLength;
+        frameReceived(0, frameLength, vm->memory + vm->here);
+    }
+
+    void slice() // helper (not Brief instruction); carry on with the code left part way
+    {
+        int16_t here = vm->here;
+        int16_t clear = vm->here = queueEnd(); // events packed clear of code and frames held
+        bool done = run(SLICE_FUEL);
+        if (vm->here == clear) vm->here = here; // (unless the code moved it)
+        if (!done) return;
+        if (vm->held == 0) vm->loopIterations++;
+        vm->held = -1;
+    }
+
+    void begin(int16_t address, int16_t held) // helper (not Brief instruction); run code in slices, the first now
+    {
+        vm->r = vm->rstack - 1; // reset return stack (as exec)
+        vm->p = address;
+        rpush(-1); // causing run() to fall through upon completion
+        vm->held = held;
+        slice();
+    }
+
+    void execAside(int16_t address) // helper (not Brief instruction); exec, leaving code left part way as it was
+    {
+        int16_t p = vm->p;
+        uint8_t rdepth = vm->r - vm->rstack + 1;
+        Cell rstack[RETURN_STACK_SIZE];
+        for (uint8_t k = 0; k < rdepth; k++) rstack[k] = vm->rstack[k];
+        int16_t here = vm->here;
+        int16_t clear = vm->here = queueEnd(); // events packed clear of code and frames held (as slice)
+        exec(address);
+        if (vm->here == clear) vm->here = here;
+        for (uint8_t k = 0; k < rdepth; k++) vm->rstack[k] = rstack[k];
+        vm->r = vm->rstack + rdepth - 1;
+        vm->p = p;
+    }
+#endif
+
+/*  Events may be sent as unsolicited data up to the PC. Requests may cause events, but it is not a
+    request/response model. That is, the event is always async and is not correlated with a
+    particular request (at the protocol level).
+
+    Events follow the same framing protocol from above. The payload is a single- byte identifier
+    followed by an arbitrary number of data bytes.
+
+      ID:   1 byte
+      Data: n bytes
+
+    Events may be considered simple signed scalar values generated by the event instruction. In this
+    case the data bytes consist of 0-, 1- or 2-bytes depending on the value taken from the stack.
+    The value 0 is transmitted as zero-length data and may be used when the ID alone is enough
+    information to signal an event. Other values have various lengths:
+
+      x = 0                   0 bytes
+      -128 >= x <= 127        1 byte
+      otherwise               2 bytes
+
+    Events may instead be hand packed records of data, such as a heartbeat of sensor data. This is
+    produced using the eventHeader and eventFooter instructions. Event data may be included using
+    eventBody8/16. */
+
+    void eventHeader() // pack event payload (ID from stack)
+    {
+        vm->eventBuffer = vm->here;
+        memset(vm->eventBuffer++, pop());
+    }
+
+    void eventBody8() // append byte to packed event payload
+    {
+        memset(vm->eventBuffer++, pop());
+    }
+
+    void eventBody16() // append int16 to packed event payload
+    {
+        int16_t val = pop();
+        memset(vm->eventBuffer++, val >> 8);
+        memset(vm->eventBuffer++, val);
+    }
+
+#if FRAMES_TX_RING > 0
+    uint16_t eventsRefused = 0;
+#endif
+
+    void sendUp(uint8_t* frame, uint16_t length) // helper (not Brief instruction); frame up to the PC
+    {
+        if (vm->sendEvent != 0)
+        {
+            vm->sendEvent(frame, length);
+        }
+        else
+        {
+            reflectaFrames::sendFrame(frame, length);
+#if FRAMES_TX_RING > 0
+            if (reflectaFrames::txRefused) eventsRefused++; // (telemetry lost; the PC told by FRAMES_ERROR_TX_OVERFLOW)
+#endif
+        }
+    }
+
+#ifdef BRIEF_COALESCED
+    /*  Coalesced events, selected with BRIEF_COALESCED. Rather than a frame apiece (a sequence
+        number, checksum and END byte besides each ID and its few bytes of data), events are
+        gathered into the machine's batch buffer as they're sent and go up together in a single
+        frame at the end of the loop() tick, or once BATCH_WINDOW milliseconds have gone by since
+        the first of them, or sooner should the buffer fill:
+
+          ID:      BATCH_EVENT_ID
+          Records: ID (1), length (1), data (length) of each event in turn
+
+        A batch of just one event goes up as that event alone. An event too large to be batched at
+        all goes up alone as well, after any batched before it. The PC unpacks batches into the
+        events within (see reflectaHost::receiveEvent on the host). */
+
+    void flushEvents() // helper (not Brief instruction); send events batched so far
+    {
+        if (vm->batched == 0) return;
+        if (vm->batched == 3 + vm->batch[2]) // just one
+        {
+            vm->batch[2] = vm->batch[1];
+            sendUp(vm->batch + 2, vm->batched - 2);
+        }
+        else
+        {
+            sendUp(vm->batch, vm->batched);
+        }
+        vm->batched = 0;
+    }
+
+    void flushEventsDue() // helper (not Brief instruction); once the window has gone by
+    {
+        if (vm->batched > 0 && millis() - vm->batchStart >= BATCH_WINDOW) flushEvents();
+    }
+
+    bool batchEvent(uint8_t* event, uint16_t length) // helper (not Brief instruction); false if to go alone
+    {
+        if (length == 0 || length + 2 > BATCH_SIZE) // (ID and length byte, record besides)
+        {
+            flushEvents(); // (keeping order)
+            return false;
+        }
+        if (vm->batched + length + 1 > BATCH_SIZE) flushEvents();
+        if (vm->batched == 0)
+        {
+            vm->batch[0] = BATCH_EVENT_ID;
+            vm->batched = 1;
+            vm->batchStart = millis();
+        }
+        vm->batch[vm->batched++] = event[0];
+        vm->batch[vm->batched++] = length - 1;
+        for (uint16_t i = 1; i < length; i++) vm->batch[vm->batched++] = event[i];
+        return true;
+    }
+#endif
+
+    void eventFooter() // send packed event as a Reflecta frame
+    {
+        uint8_t* event = vm->memory + vm->here;
+        uint16_t length = vm->eventBuffer - vm->here;
+#ifdef BRIEF_COALESCED
+        if (batchEvent(event, length)) return; // (sent along with others)
+#endif
+        sendUp(event, length);
+    }
+
+    void event(uint8_t id, int16_t val) // helper to send simple scaler events
+    {
+        push(id);
+        eventHeader();
+        if (val != 0)
+        {
+            if (val >= INT8_MIN && val <= INT8_MAX)
+            {
+                push(val);
+                eventBody8();
+            }
+            else
+            {
+                push(val);
+                eventBody16();
+            }
+        }
+        eventFooter();
+    }
+
+#ifdef BRIEF_DELTAS
+    /*  Delta-coded samples, selected with BRIEF_DELTAS, for slowly changing sensor streams. Rather
+        than eventBody16's two bytes a value, eventDelta appends the difference from the value last
+        sent on the same channel, zigzag coded (small negative differences small as well) and then
+        as a varint; 7 bits a byte, low first, the high bit set on all but the last. Differences
+        within -32 to 31 take a single byte.
+
+        The lowest bit of each sample marks a keyframe; the value itself rather than a difference.
+        Each channel sends one as its first sample, every KEYFRAME_INTERVAL samples after that and
+        next after 'keyframe' (or resetBoard), so that the PC comes back into step with a channel
+        should an event be lost. The PC knows the layout of its events, channels included, as it
+        does those packed with eventBody8/16 (see reflectaHost::Deltas on the host).
+
+          eventDelta  value channel -  append the sample to the event being packed
+          keyframe    channel -        send the channel's next sample as a keyframe (-1 for all)
+
+        A channel beyond DELTA_CHANNELS is a VM error (out of memory), as an index out of range. */
+
+    void eventDelta()
+    {
+        uint8_t channel = pop();
+        int16_t value = pop();
+        if (channel >= DELTA_CHANNELS)
+        {
+            error(VM_ERROR_OUT_OF_MEMORY); // (no such channel; the event goes without the sample)
+            return;
+        }
+        bool key = vm->deltaSince[channel] >= KEYFRAME_INTERVAL;
+        int16_t d = key ? value : (int16_t)(value - vm->deltaPrevious[channel]); // (wrapping)
+        uint16_t z = (uint16_t)((uint16_t)d << 1) ^ (d < 0 ? 0xFFFF : 0); // zigzag
+        uint32_t u = (uint32_t)z << 1 | key; // keyframe bit
+        do
+        {
+            uint8_t b = u & 0x7F;
+            u >>= 7;
+            memset(vm->eventBuffer++, u != 0 ? b | 0x80 : b);
+        } while (u != 0);
+        vm->deltaPrevious[channel] = value;
+        vm->deltaSince[channel] = key ? 1 : vm->deltaSince[channel] + 1;
+    }
+
+    void keyframe()
+    {
+        int8_t channel = pop();
+        if (channel < -1 || channel >= DELTA_CHANNELS)
+        {
+            error(VM_ERROR_OUT_OF_MEMORY); // (no such channel)
+            return;
+        }
+        for (uint8_t i = 0; i < DELTA_CHANNELS; i++)
+        {
+            if (channel < 0 || channel == i) vm->deltaSince[i] = KEYFRAME_INTERVAL;
+        }
+    }
+#endif
+
+/*  Several event IDs are used to notify the PC of protocol and VM errors.  Defined in Brief.h and
+    ReflectaFramesSerial.h, but for reference:
+
+      ID                 Value    Meaning
+      0xFF   Reset       None     MCU reset
+      0xFE   Protocol    0        Out of sequence frame
+                         1        Unexpected escape byte
+                         2        CRC failure
+      0xFD - VM          0        Return stack underflow
+                         1        Return stack overflow
+                         2        Data stack underflow
+                         3        Data stack overflow
+                         4        Indexed out of memory
+      0xFB   Profile     ...      Counters (BRIEF_PROFILE; see 'profile')
+      0xFA   Trace       ...      Trace and dictionary (BRIEF_TRACE; see 'trace')
+      0xF9   Tasks       ...      Task table (BRIEF_TASKS; see 'tasks')
+      0xF8   Timing      ...      Periodic word statistics (BRIEF_PERIODIC; see 'timing')
+      0xF7   Interrupts  ...      Interrupts lost with the queue full (BRIEF_DEFERRED)
+      0xF6   Batch       ...      Events coalesced into one frame (BRIEF_COALESCED)
+      0xF5   Paging      ...      Page cache counts (BRIEF_PAGED; see 'paging') */
+
+#ifdef BRIEF_TRACE
+    void sendTrace(); // forward decl (see 'trace' below)
+#endif
+
+    void error(uint8_t code) // error events
+    {
+#ifdef BRIEF_VERIFIED
+        upsets++; // stacks are no longer what the verifier assumed
+#endif
+#ifdef BRIEF_TRACE
+        traceError(code);
+#endif
+        push(code);
+        push(VM_EVENT_ID);
+        eventHeader();
+        eventBody8();
+        eventFooter();
+#ifdef BRIEF_TRACE
+        if (traceArmed && !traceSending && replaying == 0)
+        {
+            traceArmed = false;
+            sendTrace();
+        }
+#endif
+    }
+
+/*  Below are the primitive Brief instructions; later bound in setup. All of these functions take no
+    parameters and return nothing. Arguments and return values flow through the stack. */
+
+    void eventOp() // send event up to PC containing top stack value
+    {
+        int8_t id = pop();
+        int16_t val = pop();
+        event(id, val);
+    }
+
+/*  Memory fetch/store instructions. Fetches take an address from the stack and push back the
+    contents of that address (within the dictionary). Stores take a value and an address from the
+    stack and store the value to the address. */
+
+    inline int16_t mem16(Cell address) // helper (not Brief instruction)
+    {
+        int16_t x = ((int16_t)mem(address)) << 8;
+        return x | mem(address + 1);
+    }
+
+    void fetch8()
+    {
+        Cell a = *vm->s;
+        *vm->s = TRACED_FETCH(11, a, mem(a));
+    }
+
+    void store8()
+    {
+        Cell a = pop();
+        memset(a, (uint8_t)pop());
+    }
+
+    void fetch16()
+    {
+        Cell a = *vm->s;
+        *vm->s = TRACED_FETCH(13, a, mem16(a));
+    }
+
+    void store16()
+    {
+        int16_t a = pop();
+        Cell v = pop();
+        memset(a, v >> 8);
+        memset(a + 1, v);
+    }
+
+/*  Literal (constant) values are pushed to the stack by the lit8/16 instructions. The values is a
+    parameter to the instruction. Literals (as well as branches below) are one of the few
+    instructions to actually have operands. This is done by consuming the bytes at the current
+    program counter and advancing the counter to skip them for execution. */
+
+    void lit8()
+    {
+        push((int8_t)mem(vm->p++));
+    }
+
+    void lit16()
+    {
+        push(mem16(vm->p++)); vm->p++;
+    }
+
+/*  Binary and unary ALU operations pop one or two values and push back one. These include basic
+    arithmetic, bitwise operations, comparison, etc. */
+
+    void add()
+    {
+        Cell x = pop();
+        *vm->s = *vm->s + x;
+    }
+
+    void sub()
+    {
+        Cell x = pop();
+        *vm->s = *vm->s - x;
+    }
+
+    void mul()
+    {
+        Cell x = pop();
+        *vm->s = *vm->s * x;
+    }
+
+    void div()
+    {
+        Cell x = pop();
+        *vm->s = *vm->s / x;
+    }
+
+    void mod()
+    {
+        Cell x = pop();
+        *vm->s = *vm->s % x;
+    }
+
+    void andb()
+    {
+        Cell x = pop();
+        *vm->s = *vm->s & x;
+    }
+
+    void orb()
+    {
+        Cell x = pop();
+        *vm->s = *vm->s | x;
+    }
+
+    void xorb()
+    {
+        Cell x = pop();
+        *vm->s = *vm->s ^ x;
+    }
+
+    void shift()
+    {
+        Cell x = pop();
+        if (x < 0) *vm->s = *vm->s << -x;
+        else *vm->s = *vm->s >> x;
+    }
+
+    inline Cell boolval(Cell b) // helper (not Brief instruction)
+    {
+        // true is all bits on (works for bitwise and logical operations alike)
+        return b ? -1 : 0;
+    }
+
+    void eq()
+    {
+        Cell x = pop();
+        *vm->s = boolval(*vm->s == x);
+    }
+
+    void neq()
+    {
+        Cell x = pop();
+        *vm->s = boolval(*vm->s != x);
+    }
+
+    void gt()
+    {
+        Cell x = pop();
+        *vm->s = boolval(*vm->s > x);
+    }
+
+    void geq()
+    {
+        Cell x = pop();
+        *vm->s = boolval(*vm->s >= x);
+    }
+
+    void lt()
+    {
+        Cell x = pop();
+        *vm->s = boolval(*vm->s < x);
+    }
+
+    void leq()
+    {
+        Cell x = pop();
+        *vm->s = boolval(*vm->s <= x);
+    }
+
+    void notb()
+    {
+        *vm->s = ~(*vm->s);
+    }
+
+    void neg()
+    {
+        *vm->s = -(*vm->s);
+    }
+
+    void inc()
+    {
+        *vm->s = ++(*vm->s);
+    }
+
+    void dec()
+    {
+        *vm->s = --(*vm->s);
+    }
+
+/*  Stack manipulation instructions */
+
+    void drop()
+    {
+        vm->s--;
+    }
+
+    void dup()
+    {
+        push(*vm->s);
+    }
+
+    void swap()
+    {
+        Cell t = *vm->s;
+        Cell* n = vm->s - 1;
+        *vm->s = *n; *n = t;
+    }
+
+    void pick() // nth item to top of stack
+    {
+        int16_t n = pop();
+        push(*(vm->s - n));
+    }
+
+    void roll() // top item slipped into nth position
+    {
+        int16_t n = pop();
+        Cell t = *(vm->s - n);
+        Cell* i;
+        for (i = vm->s - n; i < vm->s; i++)
+        {
+            *i = *(i + 1);
+        }
+        *vm->s = t;
+    }
+
+    void clr() // clear stack
+    {
+        vm->s = vm->dstack() - 1;
+    }
+
+/*  Moving items between data and return stack. The return stack is commonly also used to store data
+    that is local to a subroutine. It is safe to push data here to be recovered after a subroutine
+    call. It is not safe to use it for passing data between subroutines. That is what the data stack
+    is for. Think of arguments vs. locals. */
+
+    void pushr()
+    {
+        rpush(pop());
+    }
+
+    void popr()
+    {
+        push(rpop());
+    }
+
+    void peekr()
+    {
+        push(*vm->r);
+    }
+
+/*  Dictionary manipulation instructions:
+
+    The 'forget' function is a Forthism for reverting to the address of a previously defined word;
+    essentially forgetting it and any (potentially dependent words) defined thereafter.
+
+    The alloc, free, tail, and local* instructions are all to support IL translation. The CLR
+    doesn't use the evaluation stack for parameter passing and local storage. For example, there
+    are no stack manipulation instructions in IL except drop. Instead, IL code generally makes use
+    of a per-method locals and arguments fetched and stored via instructions such as
+    StLoc/LdLoc/StArg/LdArg.
+
+    This is not a feature used in idiomatic Brief code but is here to make IL translation more
+    straight forward. Each method allocated enough space for locals and args. Before returning (or
+    earlier for TCO), this is freed.
+
+    The normal way of handling locals in Brief that need to survive a call and return from another
+    word is to store them on the return stack. The alloc instruction does this to persist the size
+    of allocation to be used by free/tail later. Tail call optimization (that is, .tail in the IL)
+    is handled by the tail instruction. This frees and pushes back a zero so that freeing later upon
+    return has no further effect.
+
+    Local and arg space is allocated from the bottom of dictionary space. The 'local' instruction is
+    used for args as well despite the name. It simply pushes the address of the nth slot. This
+    address can then be used by the regular fetch and store instructions. Because 16-bit values are
+    commonly used in translated IL, there are single-byte instructions for this. */
+
+    void forget() // revert dictionary pointer to TOS
+    {
+        int16_t i = pop();
+        if (i < vm->here) // don't "remember" random memory!
+            vm->here = i;
+#ifdef BRIEF_PAGED
+        if (i >= PAGED_BASE && i < vm->paged) vm->paged = i;
+#endif
+#ifdef BRIEF_VERIFIED
+        forgetVerified();
+#endif
+#ifdef BRIEF_JIT
+        jitFlush();
+#endif
+#ifdef BRIEF_AOT
+        staleCompiled(vm->here, imageSize);
+#endif
+    }
+
+#ifdef BRIEF_COMPACT
+#if defined(BRIEF_THREADED) || defined(BRIEF_VERIFIED) || defined(BRIEF_FUSED) || defined(BRIEF_JIT) || defined(BRIEF_AOT)
+#error BRIEF_COMPACT moves code within the plain core only
+#endif
+#if defined(BRIEF_TRACE) || defined(BRIEF_TASKS) || defined(BRIEF_SLICED) || defined(BRIEF_PAGED)
+#error BRIEF_COMPACT relocates the dictionary alone (not traces, tasks or code part way, nor pages)
+#endif
+    /*  Compaction, selected with BRIEF_COMPACT, for taking out a dead or redefined word from the
+        midst of the dictionary without forgetting (and uploading again) all defined since. The
+        bytes from 'from' to 'to' are taken out and those above slid down over them, and everything
+        referring to what's moved is relocated to match: calls and quote references throughout the
+        dictionary, the loop word, ISR words and periodic words. A word redefined further on can
+        stand in for the one taken out; references to 'from' then go to 'into' instead (-1 for none).
+
+        Code can't be told from data, nor quote references ('foo; 8- or 16-bit literals) from
+        numbers, by looking. The PC, having compiled it all, says which is which in a relocation
+        table sent as a definition just beforehand (the last thing defined, taken back by 'compact'):
+
+          Spans:       count (16), then the start of each (16, ascending); code from there up to the
+                       next, or data (variables, quotation bodies used as such) if the high bit's set
+          References:  address of each literal holding a quote reference (16), to the end
+
+        Only code spans are walked, an instruction at a time from their start; nothing else beneath
+        'here' is touched but the literals listed. 'from' must start a span and 'to' start one or be
+        'here' (less the table).
+
+        If anything still refers within what's to be taken out, an 8-bit quote reference can't hold
+        where it's to go, or the table or bounds don't fit the dictionary, nothing is changed (but
+        the table taken back) and 0 is reclaimed. Compaction is meant to be run by the PC (from code
+        sent to run at once), not from within a definition; return addresses aren't relocated.
+
+          compact  into from to table - reclaimed  take out from..to, sliding down all above; bytes
+                                                   reclaimed (0 if refused) */
+
+    int16_t compactFrom, compactTo, compactInto; // taken out; references to compactFrom go to compactInto (-1 if none)
+    int16_t compactTable, compactSpans, compactEnd; // relocation table, count of spans and end of the table (the old 'here')
+
+    int16_t relocated(int16_t address) // helper (not Brief instruction); address once compacted (-1 if taken out)
+    {
+        if (address == compactFrom && compactInto >= 0) address = compactInto;
+        if (address < compactFrom || address >= vm->here) return address; // (beneath, or beyond the dictionary)
+        if (address < compactTo) return -1;
+        return address - (compactTo - compactFrom);
+    }
+
+    bool relocate(int16_t& address, bool rewrite) // helper (not Brief instruction); false if taken out
+    {
+        int16_t r = relocated(address);
+        if (r < 0) return false;
+        if (rewrite) address = r;
+        return true;
+    }
+
+    int16_t span(int16_t n) // helper (not Brief instruction); start of nth span (high bit set if data; 'here' past the last)
+    {
+        return n < compactSpans ? mem16(compactTable + 2 + n * 2) : vm->here;
+    }
+
+    bool spanned(int16_t address) // helper (not Brief instruction); whether a span starts at address
+    {
+        for (int16_t n = 0; n < compactSpans; n++)
+        {
+            if ((span(n) & 0x7FFF) == address) return true;
+        }
+        return false;
+    }
+
+    bool relocateCalls(int16_t start, int16_t end, bool rewrite) // helper (not Brief instruction); a span of code
+    {
+        uint8_t* m = vm->memory;
+        for (int16_t a = start; a < end; a += length(m[a]))
+        {
+            uint8_t i = m[a];
+            if (a + length(i) > end) return false; // (not code after all)
+            if ((i & 0x80) == 0) continue;
+            int16_t address = ((i << 8) & 0x7F00) | m[a + 1];
+            if (!relocate(address, rewrite)) return false;
+            if (!rewrite) continue;
+            m[a] = 0x80 | address >> 8;
+            m[a + 1] = address & 0xFF;
+        }
+        return true;
+    }
+
+    bool relocateReference(int16_t at, bool rewrite) // helper (not Brief instruction); quote reference listed
+    {
+        if (at >= compactFrom && at < compactTo) return true; // (taken out along with it)
+        if (at < 0 || at + 2 > vm->here) return false;
+        uint8_t* m = vm->memory;
+        bool wide = m[at] == 2;
+        if (!wide && m[at] != 1) return false; // (not a literal)
+        if (wide && at + 3 > vm->here) return false;
+        int16_t address = wide ? (int16_t)(m[at + 1] << 8 | m[at + 2]) : (int8_t)m[at + 1];
+        if (!relocate(address, rewrite) || (!wide && address > 127)) return false;
+        if (!rewrite) return true;
+        if (wide) m[at++ + 1] = address >> 8;
+        m[at + 1] = address & 0xFF;
+        return true;
+    }
+
+    bool relocateAll(bool rewrite) // helper (not Brief instruction); the dictionary, less what's taken out, and words held
+    {
+        bool ok = true;
+        for (int16_t n = 0; ok && n < compactSpans; n++)
+        {
+            int16_t start = span(n);
+            int16_t end = span(n + 1) & 0x7FFF;
+            if (start < 0 || (start >= compactFrom && start < compactTo)) continue; // (data, or taken out)
+            ok = start <= end && relocateCalls(start, end, rewrite);
+        }
+        for (int16_t r = compactTable + 2 + compactSpans * 2; ok && r + 1 < compactEnd; r += 2)
+        {
+            ok = relocateReference(mem16(r), rewrite);
+        }
+        if (vm->loopword >= 0) ok = ok && relocate(vm->loopword, rewrite);
+        for (uint8_t i = 0; i < MAX_INTERRUPTS; i++)
+        {
+            if (vm->isrs[i] >= 0) ok = ok && relocate(vm->isrs[i], rewrite);
+        }
+#ifdef BRIEF_PERIODIC
+        for (uint8_t i = 0; i < MAX_PERIODIC; i++)
+        {
+            if (vm->periodic[i].word >= 0) ok = ok && relocate(vm->periodic[i].word, rewrite);
+        }
+#endif
+        return ok;
+    }
+
+    void compact()
+    {
+        compactTable = pop();
+        compactTo = pop();
+        compactFrom = pop();
+        compactInto = pop();
+        if (compactTable < 0 || compactTable + 2 > vm->here)
+        {
+            push(0);
+            return;
+        }
+        compactEnd = vm->here;
+        compactSpans = mem16(compactTable);
+        vm->here = compactTable; // (table taken back)
+        if (vm->last > vm->here) vm->last = vm->here;
+        bool bounds = compactSpans >= 0 && compactSpans <= (compactEnd - compactTable - 2) / 2 &&
+                      compactFrom >= 0 && compactFrom < compactTo && compactTo <= vm->here &&
+                      spanned(compactFrom) && (compactTo == vm->here || spanned(compactTo)) &&
+                      (compactInto < compactFrom || compactInto >= compactTo);
+        if (!bounds || !relocateAll(false)) // (nothing changed unless all can be)
+        {
+            push(0);
+            return;
+        }
+        relocateAll(true);
+        int16_t n = compactTo - compactFrom;
+        if (vm->last >= compactTo) vm->last -= n;
+        else if (vm->last >= compactFrom) vm->last = compactFrom; // (last taken out)
+        for (int16_t a = compactTo; a < vm->here; a++) vm->memory[a - n] = vm->memory[a];
+        vm->here -= n;
+        push(n);
+    }
+#endif
+
+    void alloc()
+    {
+        int16_t len = pop();
+        vm->locals -= len;
+        rpush(len); // remember for free later
+        for (int16_t i = vm->locals; i < vm->locals + len; i++)
+        {
+            memset(i, 0);
+        }
+        if (vm->locals < vm->here)
+        {
+            error(VM_ERROR_OUT_OF_MEMORY);
+        }
+    }
+ 
+    void free()
+    {
+        vm->locals += rpop();
+    }
+
+    void tail()
+    {
+        free(); // free early
+        rpush(0); // leave this for free later
+    }
+
+    void local()
+    {
+        push(vm->locals + pop());
+    }
+
+    void localFetch16()
+    {
+        local();
+        fetch16();
+    }
+
+    void localStore16()
+    {
+        local();
+        store16();
+    }
+
+    /*  Control flow is done by instructions that manipulate the program counter (p).
+
+        A 'call' instruction pops an address and calls it; pushing the current p as to return.
+
+        Conditional and unconditional branching is done by relative offsets as a parameter to the
+        instruction (following byte). These (like literals) are among the few instructions with
+        operands; in this case to save code size by not requiring a preceeding literal.
+
+        Notice that there is only the single conditional branch instruction.  There are no 'branch
+        if greater', 'branch if equal', etc. Instead the separate comparison instructions above are
+        used as the preceding predicate. */
+
+    void call()
+    {
+        rpush(vm->p);
+        vm->p = pop();
+    }
+
+    void branch()
+    {
+        vm->p += (int8_t)mem(vm->p);
+    }
+
+    void zbranch()
+    {
+        if (pop() == 0)
+        {
+            branch();
+        }
+        else
+        {
+            vm->p++;
+        }
+    }
+
+    /*  Quotations and 'choice' need some explanation. The idea behind quotations is something like
+        an anonymous lambda and is used with some nice syntax in the Brief language. The 'quote'
+        instruction precedes a sequence that is to be treated as an embedded definition
+        essentially. It takes a length as an operand, pushes the address of the sequence of code
+        following and then jumps over that code.
+
+        The net result is that the sequence is not executed, but its address is left on the stack
+        for future words to call as they see fit.
+
+        One primitive that makes use of this is 'choice' which is the idiomatic Brief conditional.
+        It pops two addresses (likely from two quotations) along with a predicate value (likely the
+        result of some comparison or logical operations). It then executes one or the other
+        quotation depending on the predicate.
+
+        Another primitive making use of quotations is 'chooseIf' (called simply 'if' in Brief) which
+        pops a predicate and a single address; calling the address if non-zero.
+
+        Many secondary words in Brief also use quotation such as 'bi', 'tri', 'map', 'fold', etc.
+        which act as higher-order functions applying. */
+
+    void quote()
+    {
+        uint8_t len = mem(vm->p++);
+        push(vm->p); // address of quotation
+        vm->p += len; // jump over
+    }
+
+    void choice()
+    {
+        int16_t f = pop();
+        int16_t t = pop();
+        rpush(vm->p);
+        vm->p = pop() == 0 ? f : t;
+    }
+
+    void chooseIf()
+    {
+        int16_t t = pop();
+        if (pop() != 0)
+        {
+            rpush(vm->p);
+            vm->p = t;
+        }
+    }
+
+    /*  A Brief word (address) may be set to run in the main loop. Also, a loop counter is
+        maintained for use by conditional logic (throttling for example). */
+
+    void loopTicks()
+    {
+        push(vm->loopIterations & 0x7FFF);
+    }
+
+    void setLoop()
+    {
+        vm->loopIterations = 0;
+        vm->loopword = pop();
+    }
+
+    void stopLoop()
+    {
+        vm->loopword = -1;
+    }
+
+#ifdef BRIEF_TASKS
+#if defined(BRIEF_JIT) || defined(BRIEF_AOT) || defined(BRIEF_PROFILE) || defined(BRIEF_TRACE)
+#error BRIEF_TASKS switches tasks within the plain, threaded or verified core only
+#endif
+    /*  Cooperative tasks, selected with BRIEF_TASKS; several loop words running at once, each at
+        its own pace, rather than one loop word throttled with loopTicks. Each task has its own data
+        and return stacks and program counter, kept in the machine's task table while it's not
+        running. After the loop word, loop() gives each task in turn a slice; from where it left
+        off until it yields or has run its budget of instructions. Upon returning, a task's word is
+        run again from the start in its next slice (loopTicks then counting its own iterations).
+
+        A slice runs interpreted code only, at least one instruction. Verified definitions called
+        run unchecked to completion within it.
+
+          yield   -                 end the running task's slice here (see run(fuel))
+          spawn   word budget - id  add a task (budget 0 for until yielding; id -1 if the table is full)
+          kill    id -              remove a task (ending the slice at once if it's the running one)
+          tasks   -                 send TASK_EVENT_ID: id (8), word (16), p (16), iterations (16) for each
+
+        Tasks' stacks start out empty; the main stacks (left by code the PC runs) are put aside
+        while a task runs. Tasks are removed upon resetBoard. */
+
+#define TASK_FRAME (1 + 7 * MAX_TASKS) // largest event payload (id and each task)
+
+    void swapTask(Machine::Task& t) // helper (not Brief instruction); exchange stacks and registers with those of t
+    {
+        Cell x;
+        for (uint8_t k = 0; k <= DATA_STACK_SIZE; k++)
+        {
+            x = vm->dstackCells[k];
+            vm->dstackCells[k] = t.dstackCells[k];
+            t.dstackCells[k] = x;
+        }
+        for (uint8_t k = 0; k < RETURN_STACK_SIZE; k++)
+        {
+            x = vm->rstack[k];
+            vm->rstack[k] = t.rstack[k];
+            t.rstack[k] = x;
+        }
+        uint8_t depth = vm->s - vm->dstackCells;
+        uint8_t rdepth = vm->r - vm->rstack + 1;
+        vm->s = vm->dstackCells + t.depth;
+        vm->r = vm->rstack + t.rdepth - 1;
+        t.depth = depth;
+        t.rdepth = rdepth;
+        int16_t p = vm->p;
+        vm->p = t.p;
+        t.p = p;
+        int16_t iterations = vm->loopIterations;
+        vm->loopIterations = t.iterations;
+        t.iterations = iterations;
+    }
+
+    void schedule() // helper (not Brief instruction); a slice for each task, round robin
+    {
+        for (vm->task = 0; vm->task < MAX_TASKS; vm->task++)
+        {
+            Machine::Task& t = vm->tasks[vm->task];
+            if (t.word < 0) continue;
+            swapTask(t);
+            if (vm->p < 0) // start the word (again)
+            {
+                vm->r = vm->rstack - 1;
+                rpush(-1); // causing run() to fall through upon completion
+                vm->p = t.word;
+            }
+            if (run(t.budget > 0 ? t.budget : -1)) vm->loopIterations++;
+            swapTask(t); // (stacks of a task killed within its slice left in the free entry)
+        }
+        vm->task = -1;
+    }
+
+    void spawn()
+    {
+        int16_t budget = pop();
+        int16_t word = pop();
+        for (int8_t i = 0; i < MAX_TASKS; i++)
+        {
+            Machine::Task& t = vm->tasks[i];
+            if (t.word >= 0 || i == vm->task) continue; // (the running task's entry holds the main stacks)
+            t.word = word;
+            t.budget = budget;
+            t.p = -1;
+            t.iterations = 0;
+            t.depth = 0;
+            t.rdepth = 0;
+            t.dstackCells[0] = 0;
+            push(i);
+            return;
+        }
+        push(-1);
+    }
+
+    void kill()
+    {
+        int16_t i = pop();
+        if (i < 0 || i >= MAX_TASKS) return;
+        vm->tasks[i].word = -1;
+        if (i == vm->task) yield();
+    }
+
+    void tasks()
+    {
+        int16_t here = vm->here;
+        if (vm->locals - TASK_FRAME > vm->here) vm->here = vm->locals - TASK_FRAME;
+        push(TASK_EVENT_ID);
+        eventHeader();
+        for (uint8_t i = 0; i < MAX_TASKS; i++)
+        {
+            Machine::Task& t = vm->tasks[i];
+            if (t.word < 0) continue;
+            bool running = i == vm->task; // (its registers are in the machine)
+            push(i);
+            eventBody8();
+            push(t.word);
+            eventBody16();
+            push(running ? vm->p : t.p);
+            eventBody16();
+            push(running ? vm->loopIterations : t.iterations);
+            eventBody16();
+        }
+        eventFooter();
+        vm->here = here;
+    }
+#undef TASK_FRAME
+#endif
+
+#ifdef BRIEF_PERIODIC
+    /*  Periodic words, selected with BRIEF_PERIODIC; control loops run at fixed rates by loop()
+        itself rather than by a loop word testing loopTicks or milliseconds. Each is released every
+        so many milliseconds, timed by micros() from one release to the next so that the rate
+        doesn't drift with lateness. loop() runs those due (before the loop word), each to
+        completion, those with lower priority numbers first; equal priorities go by rate (shorter
+        periods first, rate monotonic). Nothing is done between releases beyond comparing the
+        clock with the soonest of them.
+
+        A word still running at its next release has overrun its deadline. One running so late that
+        a whole period has gone by skips the releases missed; each is counted as an overrun as well.
+        Lateness (jitter) and run time are kept in microseconds.
+
+          every   word period priority - id  run word every period ms (id -1 if the table is full)
+          cancel  id -                       stop running it
+          timing  clear -                    send TIMING_EVENT_ID: id (8), runs (16), overruns (16),
+                                             worst and mean lateness (16, 16) and worst run time (16)
+                                             for each; clearing them if the flag is non-zero
+
+        Periodic words are cancelled upon resetBoard. */
+
+#define TIMING_FRAME (1 + 11 * MAX_PERIODIC) // largest event payload (id and each word)
+
+    inline uint16_t saturate(uint32_t x) // helper (not Brief instruction)
+    {
+        return x > UINT16_MAX ? UINT16_MAX : x;
+    }
+
+    void dispatch() // helper (not Brief instruction); run periodic words due, by priority
+    {
+        uint32_t now = micros();
+        if ((int32_t)(now - vm->due) < 0) return; // none due yet
+        for (;;)
+        {
+            int8_t next = -1; // due as of now, first by priority then rate
+            for (int8_t i = 0; i < MAX_PERIODIC; i++)
+            {
+                Machine::Periodic& e = vm->periodic[i];
+                if (e.word < 0 || (int32_t)(now - e.release) < 0) continue;
+                if (next >= 0)
+                {
+                    Machine::Periodic& n = vm->periodic[next];
+                    if (e.priority > n.priority || (e.priority == n.priority && e.period >= n.period)) continue;
+                }
+                next = i;
+            }
+            if (next < 0) break;
+            Machine::Periodic& e = vm->periodic[next];
+            uint32_t period = (uint32_t)e.period * 1000;
+            uint32_t start = micros();
+            uint32_t late = start - e.release;
+            if (late >= period) // releases missed altogether
+            {
+                e.overruns = saturate((uint32_t)e.overruns + late / period);
+                e.release += late / period * period;
+                late %= period;
+            }
+            e.release += period; // (after 'now'; run once per pass)
+            e.runs = saturate((uint32_t)e.runs + 1);
+            e.lateness += late;
+            if (late > e.jitter) e.jitter = saturate(late);
+#ifdef BRIEF_SLICED
+            execAside(e.word);
+#else
+            exec(e.word);
+#endif
+            uint32_t end = micros();
+            if ((int32_t)(end - e.release) > 0) e.overruns = saturate((uint32_t)e.overruns + 1); // past its deadline
+            if (end - start > e.time) e.time = saturate(end - start);
+        }
+        vm->due = now + 0x40000000; // soonest release (or a while from now if none)
+        for (uint8_t i = 0; i < MAX_PERIODIC; i++)
+        {
+            Machine::Periodic& e = vm->periodic[i];
+            if (e.word >= 0 && (int32_t)(e.release - vm->due) < 0) vm->due = e.release;
+        }
+    }
+
+    void every()
+    {
+        int8_t priority = pop();
+        int16_t period = pop();
+        int16_t word = pop();
+        for (int8_t i = 0; i < MAX_PERIODIC && period > 0; i++)
+        {
+            Machine::Periodic& e = vm->periodic[i];
+            if (e.word >= 0) continue;
+            e.word = word;
+            e.period = period;
+            e.priority = priority;
+            e.release = vm->due = micros(); // due at once
+            e.runs = e.overruns = e.jitter = e.time = 0;
+            e.lateness = 0;
+            push(i);
+            return;
+        }
+        push(-1);
+    }
+
+    void cancel()
+    {
+        int16_t i = pop();
+        if (i >= 0 && i < MAX_PERIODIC) vm->periodic[i].word = -1;
+    }
+
+    void timing()
+    {
+        bool clear = pop() != 0;
+        int16_t here = vm->here;
+        if (vm->locals - TIMING_FRAME > vm->here) vm->here = vm->locals - TIMING_FRAME;
+        push(TIMING_EVENT_ID);
+        eventHeader();
+        for (uint8_t i = 0; i < MAX_PERIODIC; i++)
+        {
+            Machine::Periodic& e = vm->periodic[i];
+            if (e.word < 0) continue;
+            push(i);
+            eventBody8();
+            push(e.runs);
+            eventBody16();
+            push(e.overruns);
+            eventBody16();
+            push(e.jitter);
+            eventBody16();
+            push(e.runs == 0 ? 0 : saturate(e.lateness / e.runs));
+            eventBody16();
+            push(e.time);
+            eventBody16();
+            if (clear)
+            {
+                e.runs = e.overruns = e.jitter = e.time = 0;
+                e.lateness = 0;
+            }
+        }
+        eventFooter();
+        vm->here = here;
+    }
+#undef TIMING_FRAME
+#endif
+
+    /*  Upon first connecting to a board, the PC will execute a reset so that assumptions about
+        dictionary contents and such hold true. */ 
+
+    void resetBoard() // likely called initialy upon connecting from PC
+    {
+        clr();
+        vm->here = vm->last = 0;
+        vm->locals = MEM_SIZE;
+#ifdef BRIEF_PAGED
+        vm->paged = PAGED_BASE;
+#endif
+#ifdef BRIEF_VERIFIED
+        unverifyAll();
+#endif
+#ifdef BRIEF_JIT
+        jitFlush();
+#endif
+#ifdef BRIEF_AOT
+        staleCompiled(0, imageSize); // (reloaded upon setup)
+#endif
+        vm->loopword = -1;
+        vm->loopIterations = 0;
+#ifdef BRIEF_TASKS
+        for (uint8_t i = 0; i < MAX_TASKS; i++)
+        {
+            vm->tasks[i].word = -1;
+        }
+        if (vm->task >= 0) yield(); // (reset from within a task)
+#endif
+#ifdef BRIEF_PERIODIC
+        for (uint8_t i = 0; i < MAX_PERIODIC; i++)
+        {
+            vm->periodic[i].word = -1;
+        }
+#endif
+#ifdef BRIEF_DELTAS
+        push(-1);
+        keyframe(); // (the PC starting afresh)
+#endif
+        if (vm == &primary) reflectaFrames::reset(); // (the protocol is the primary machine's)
+    }
+
+    /*  Here begins all of the Arduino-specific instructions.
+
+        Starting with basic setup and reading/write to GPIO pins. Note we treat HIGH/LOW values as
+        Brief-style booleans (-1 or 0) to play well with the logical and conditional operations. */
+
+    void pinMode()
+    {
+        ::pinMode(pop(), pop());
+    }
+
+    void digitalRead()
+    {
+        push(TRACED(58, ::digitalRead(pop()) ? -1 : 0));
+    }
+
+    void digitalWrite()
+    {
+        ::digitalWrite(pop(), pop() == 0 ? LOW : HIGH);
+    }
+
+    void analogRead()
+    {
+        push(TRACED(60, ::analogRead(pop())));
+    }
+
+    void analogWrite()
+    {
+        ::analogWrite(pop(), pop());
+    }
+
+    /*  I2C support comes from several instructions, essentially mapping composable, zero-operand
+        instructions to functions in the Arduino library:
+
+          http://arduino.cc/en/Reference/Wire
+
+        Brief words (addresses/quotations) may be hooked to respond to Wire events. */
+
+    /*
+    void wireBegin()
+    {
+        Wire.begin(); // join bus as master (slave not supported)
+    }
+
+    void wireRequestFrom()
+    {
+        Wire.requestFrom(pop(), pop());
+    }
+
+    void wireAvailable()
+    {
+        push(Wire.available());
+    }
+
+    void wireRead()
+    {
+        while (Wire.available() < 1); // TODO: blocking?
+        push(Wire.read());
+    }
+
+    void wireBeginTransmission()
+    {
+        Wire.beginTransmission((uint8_t)pop());
+    }
+
+    void wireWrite()
+    {
+        Wire.write((uint8_t)pop());
+    }
+
+    void wireEndTransmission()
+    {
+        Wire.endTransmission();
+    }
+
+    int16_t onReceiveWord = -1;
+
+    void wireOnReceive(int16_t count)
+    {
+        if (onReceiveWord != -1)
+        {
+            push(count);
+            exec(onReceiveWord);
+        }
+    }
+
+    void wireSetOnReceive()
+    {
+        onReceiveWord = pop();
+        Wire.onReceive(wireOnReceive);
+    }
+
+    int16_t onRequestWord = -1;
+
+    void wireOnRequest()
+    {
+        if (onRequestWord != -1)
+        {
+            exec(onRequestWord);
+        }
+    }
+
+    void wireSetOnRequest()
+    {
+        onRequestWord = pop();
+        Wire.onRequest(wireOnRequest);
+    }
+    */
+
+    /*  Brief word addresses (or quotations) may be set to run upon interrupts.  For more info on
+        the argument values and behavior, see:
+
+          http://arduino.cc/en/Reference/AttachInterrupt
+
+        We keep a mapping of up to MAX_INTERRUPTS (6) words. */
+
+#ifdef BRIEF_DEFERRED
+    void queueInterrupt(uint8_t n); // (below)
+#endif
+
+    void interrupt(uint8_t n) // helper (not Brief instruction)
+    {
+#ifdef BRIEF_DEFERRED
+        queueInterrupt(n); // word run later by loop()
+#else
+        int16_t w = vm->isrs[n];
+        if (w != -1) exec(w);
+#endif
+    }
+
+    void interrupt0() // helper (not Brief instruction)
+    {
+        interrupt(0);
+    }
+
+    void interrupt1() // helper (not Brief instruction)
+    {
+        interrupt(1);
+    }
+
+    void interrupt2() // helper (not Brief instruction)
+    {
+        interrupt(2);
+    }
+
+    void interrupt3() // helper (not Brief instruction)
+    {
+        interrupt(3);
+    }
+
+    void interrupt4() // helper (not Brief instruction)
+    {
+        interrupt(4);
+    }
+
+    void interrupt5() // helper (not Brief instruction)
+    {
+        interrupt(5);
+    }
+
+    void attach(uint8_t interrupt, uint8_t mode) // helper (not Brief instruction); ISR calling the word bound
+    {
+#ifdef BRIEF_SNAPSHOT
+        vm->isrModes[interrupt] = mode;
+#endif
+        switch (interrupt)
+        {
+            case 0 : attachInterrupt(0, interrupt0, mode); break;
+            case 1 : attachInterrupt(1, interrupt1, mode); break;
+            case 2 : attachInterrupt(2, interrupt2, mode); break;
+            case 3 : attachInterrupt(3, interrupt3, mode); break;
+            case 4 : attachInterrupt(4, interrupt4, mode); break;
+            case 5 : attachInterrupt(5, interrupt5, mode); break;
+        }
+    }
+
+    void attachISR()
+    {
+        uint8_t mode = pop();
+        uint8_t interrupt = pop();
+        int16_t word = pop();
+        if (interrupt >= MAX_INTERRUPTS) return;
+        vm->isrs[interrupt] = word;
+        attach(interrupt, mode);
+    }
+
+    void detachISR()
+    {
+        uint8_t interrupt = pop();
+        if (interrupt >= MAX_INTERRUPTS) return;
+        vm->isrs[interrupt] = -1;
+        detachInterrupt(interrupt);
+    }
+
+#ifdef BRIEF_SNAPSHOT
+#ifdef BRIEF_AOT
+#error BRIEF_SNAPSHOT would overwrite the image of words translated ahead of time
+#endif
+    /*  Dictionary snapshots, selected with BRIEF_SNAPSHOT, so that the board comes up running what
+        it was last given rather than waiting on the PC to send it all again. 'snapshot' writes the
+        dictionary beneath 'here' to EEPROM at SNAPSHOT_ADDRESS after a header holding 'here',
+        'last', the loop word and the ISR words (with their modes), and setup() copies it all back
+        in before sending the boot event, reattaching the interrupts.
+
+        The header begins with a version and the build (memory size, cell size, fused instructions
+        and so on); an image from any other build isn't restored, nor one failing its checksum
+        (Fletcher-16 over header and image), such as one left part written by a reset. Only bytes
+        that differ are written (eeprom_update_block), each some 3ms on AVR, with the board doing
+        nothing else meanwhile; restoring is a block read. 'resetBoard snapshot' leaves the board
+        to boot empty.
+
+          snapshot  -  -  save the dictionary (VM error 'out of memory' if it won't fit) */
+
+#define SNAPSHOT_VERSION 1
+
+    struct Snapshot // helper (not Brief instruction); header ahead of the image
+    {
+        uint8_t version; // SNAPSHOT_VERSION
+        uint8_t build; // options changing what the image means (see snapshotBuild())
+        uint16_t memSize; // MEM_SIZE
+        int16_t here, last, loopword;
+        int16_t isrs[MAX_INTERRUPTS];
+        uint8_t isrModes[MAX_INTERRUPTS];
+#ifdef BRIEF_DEFERRED
+        int8_t isrPins[MAX_INTERRUPTS];
+#endif
+#ifdef BRIEF_ROM
+        int16_t romSize; // (another library isn't the one called)
+#endif
+        uint16_t checksum; // of the header (checksum zero), then the image
+    };
+
+    uint8_t snapshotBuild() // helper (not Brief instruction)
+    {
+        uint8_t build = 0;
+#ifdef BRIEF_CELL32
+        build |= 1;
+#endif
+#ifdef BRIEF_FUSED
+        build |= 2; // (instructions fused into definitions)
+#endif
+#ifdef BRIEF_DEFERRED
+        build |= 4; // (isrPins in the header)
+#endif
+#ifdef BRIEF_ROM
+        build |= 8; // (calls into the library; its size in the header)
+#endif
+        return build | MAX_INTERRUPTS << 4;
+    }
+
+    uint16_t fletcher(uint16_t sum, const uint8_t* bytes, int16_t count) // helper (not Brief instruction)
+    {
+        uint16_t a = sum & 0xFF, b = sum >> 8;
+        for (int16_t i = 0; i < count; i++)
+        {
+            a = (a + bytes[i]) % 255;
+            b = (b + a) % 255;
+        }
+        return b << 8 | a;
+    }
+
+    uint16_t snapshotChecksum(Snapshot& h) // helper (not Brief instruction)
+    {
+        uint16_t stored = h.checksum;
+        h.checksum = 0;
+        uint16_t sum = fletcher(fletcher(0, (const uint8_t*)&h, sizeof(h)), vm->memory, h.here);
+        h.checksum = stored;
+        return sum;
+    }
+
+    void snapshot()
+    {
+        if (SNAPSHOT_ADDRESS + sizeof(Snapshot) + vm->here > E2END + 1)
+        {
+            error(VM_ERROR_OUT_OF_MEMORY);
+            return;
+        }
+        Snapshot h = Snapshot(); // (zeroed, padding and all; checksummed)
+        h.version = SNAPSHOT_VERSION;
+        h.build = snapshotBuild();
+        h.memSize = MEM_SIZE;
+        h.here = vm->here;
+        h.last = vm->last;
+        h.loopword = vm->loopword;
+#ifdef BRIEF_ROM
+        h.romSize = romSize;
+#endif
+        for (uint8_t i = 0; i < MAX_INTERRUPTS; i++)
+        {
+            int16_t w = vm->isrs[i];
+            bool kept = w >= 0 && w < vm->here; // (not those left by resetBoard)
+#ifdef BRIEF_ROM
+            kept = kept || inRom(w); // (library words too)
+#endif
+            h.isrs[i] = kept ? w : -1;
+            h.isrModes[i] = vm->isrModes[i];
+#ifdef BRIEF_DEFERRED
+            h.isrPins[i] = vm->isrPins[i];
+#endif
+        }
+        h.checksum = snapshotChecksum(h);
+        eeprom_update_block(vm->memory, (void*)(SNAPSHOT_ADDRESS + sizeof(Snapshot)), vm->here);
+        eeprom_update_block(&h, (void*)SNAPSHOT_ADDRESS, sizeof(h)); // (last; valid only once all's written)
+    }
+
+    bool restore() // helper (not Brief instruction); dictionary from the snapshot, if there's a good one
+    {
+        Snapshot h;
+        eeprom_read_block(&h, (const void*)SNAPSHOT_ADDRESS, sizeof(h));
+        if (h.version != SNAPSHOT_VERSION || h.build != snapshotBuild() || h.memSize != MEM_SIZE ||
+            h.here < 0 || h.here > MEM_SIZE || SNAPSHOT_ADDRESS + sizeof(Snapshot) + h.here > E2END + 1) return false;
+#ifdef BRIEF_ROM
+        if (h.romSize != romSize) return false;
+#endif
+        eeprom_read_block(vm->memory, (const void*)(SNAPSHOT_ADDRESS + sizeof(Snapshot)), h.here);
+        if (h.checksum != snapshotChecksum(h)) return false; // (what's read lies beyond 'here')
+        vm->here = h.here;
+        vm->last = h.last;
+        vm->loopword = h.loopword;
+        for (uint8_t i = 0; i < MAX_INTERRUPTS; i++)
+        {
+            vm->isrs[i] = h.isrs[i];
+#ifdef BRIEF_DEFERRED
+            vm->isrPins[i] = h.isrPins[i];
+#endif
+            if (h.isrs[i] != -1) attach(i, h.isrModes[i]);
+        }
+        return true;
+    }
+#endif
+
+#ifdef BRIEF_PAGED
+#define PAGING_FRAME (1 + 2 * 6) // largest event payload (id and counts)
+
+    void paging() // (see the paged dictionary, above)
+    {
+        bool clear = pop() != 0;
+        int16_t here = vm->here;
+        if (vm->locals - PAGING_FRAME > vm->here) vm->here = vm->locals - PAGING_FRAME;
+        push(PAGING_EVENT_ID);
+        eventHeader();
+        uint32_t counts[] = { pageHits, pageMisses, pagePrefetches, pagePrefetchesUsed, pageWrites };
+        for (uint8_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+        {
+            push(counts[i] > UINT16_MAX ? UINT16_MAX : counts[i]);
+            eventBody16();
+        }
+        push(vm->paged);
+        eventBody16();
+        eventFooter();
+        vm->here = here;
+        if (clear) pageHits = pageMisses = pagePrefetches = pagePrefetchesUsed = pageWrites = 0;
+    }
+#undef PAGING_FRAME
+#endif
+
+#ifdef BRIEF_DEFERRED
+#if ISR_QUEUE_SIZE & (ISR_QUEUE_SIZE - 1) || ISR_QUEUE_SIZE > 128
+#error ISR_QUEUE_SIZE must be a power of two, up to 128
+#endif
+    /*  Deferred interrupts, selected with BRIEF_DEFERRED. Running a word from within the ISR
+        itself keeps interrupts masked for the whole of it and tramples the registers and stacks of
+        whatever was running at the time. Instead, each ISR only queues the interrupt number, the
+        time (micros()) and, if so set, the value of a pin, and loop() runs the words of those
+        queued since, in turn, before anything else.
+
+        The queue is a ring of ISR_QUEUE_SIZE written only by ISRs (advancing the head) and read
+        only by loop() (advancing the tail), so neither need mask the other. Interrupts arriving
+        with the ring full are dropped and counted, and loop() sends ISR_EVENT_ID with the interrupt
+        number (8) and count (8) of each that lost any since last sent.
+
+          isrPin    pin interrupt -     sample pin upon each interrupt (-1 for none)
+          isrEvent  - value time        within the word run; pin value (as digitalRead; 0 if
+                                        none) and micros() upon the interrupt */
+
+#define ISR_FRAME (1 + 2 * MAX_INTERRUPTS) // largest event payload (id and each interrupt)
+
+    void queueInterrupt(uint8_t n) // helper (not Brief instruction); within the ISR
+    {
+        uint8_t head = vm->isrHead;
+        if ((uint8_t)(head - vm->isrTail) == ISR_QUEUE_SIZE) // full
+        {
+            if (vm->isrLost[n] != UINT8_MAX) vm->isrLost[n]++;
+            return;
+        }
+        uint8_t k = head & (ISR_QUEUE_SIZE - 1);
+        int8_t pin = vm->isrPins[n];
+        vm->isrIds[k] = n;
+        vm->isrValues[k] = pin >= 0 && ::digitalRead(pin);
+        vm->isrTimes[k] = micros();
+        vm->isrHead = head + 1; // (published once filled in)
+    }
+
+    void deferred() // helper (not Brief instruction); run the words of interrupts queued since
+    {
+        while (vm->isrTail != vm->isrHead)
+        {
+            uint8_t k = vm->isrTail & (ISR_QUEUE_SIZE - 1);
+            uint8_t n = vm->isrIds[k];
+            vm->isrValue = vm->isrValues[k];
+            vm->isrTime = vm->isrTimes[k];
+            vm->isrTail++; // (free for the ISR again)
+            int16_t w = vm->isrs[n];
+            if (w < 0) continue; // (detached meanwhile)
+#ifdef BRIEF_SLICED
+            execAside(w);
+#else
+            exec(w);
+#endif
+        }
+        bool lost = false;
+        for (uint8_t i = 0; i < MAX_INTERRUPTS; i++) lost = lost || vm->isrLost[i] != vm->isrReported[i];
+        if (!lost) return;
+        int16_t here = vm->here;
+#ifdef BRIEF_SLICED
+        vm->here = queueEnd(); // (clear of code left part way and frames held)
+#endif
+        if (vm->locals - ISR_FRAME > vm->here) vm->here = vm->locals - ISR_FRAME;
+        push(ISR_EVENT_ID);
+        eventHeader();
+        for (uint8_t i = 0; i < MAX_INTERRUPTS; i++)
+        {
+            uint8_t count = vm->isrLost[i]; // (counted on by the ISR meanwhile)
+            if (count == vm->isrReported[i]) continue;
+            push(i);
+            eventBody8();
+            push((uint8_t)(count - vm->isrReported[i]));
+            eventBody8();
+            vm->isrReported[i] = count;
+        }
+        eventFooter();
+        vm->here = here;
+    }
+
+    void isrPin()
+    {
+        uint8_t interrupt = pop();
+        int8_t pin = pop();
+        if (interrupt < MAX_INTERRUPTS) vm->isrPins[interrupt] = pin;
+    }
+
+    void isrEvent()
+    {
+        push(TRACED(87, vm->isrValue ? -1 : 0));
+        push(TRACED(87, (Cell)vm->isrTime));
+    }
+#undef ISR_FRAME
+#endif
+
+    /*  Servo support also comes by simple mapping of composable, zero-operand instructions to
+        Arduino library calls:
+
+          http://arduino.cc/en/Reference/Servo
+
+        We keep up to MAX_SERVOS (48) servo instances attached. */
+
+    /*
+    Servo servos[MAX_SERVOS];
+
+    void servoAttach()
+    {
+        int16_t pin = pop();
+        servos[pin].attach(pin);
+    }
+
+    void servoDetach()
+    {
+        servos[pop()].detach();
+    }
+
+    void servoWriteMicros()
+    {
+        servos[pop()].writeMicroseconds(pop());
+    }
+    */
+
+    // A couple of stragglers...
+
+    void milliseconds()
+    {
+        push(TRACED(64, millis()));
+    }
+
+    void pulseIn()
+    {
+        push(TRACED(65, ::pulseIn(pop(), pop())));
+    }
+
+#ifdef BRIEF_PROFILE
+
+    /*  The 'profile' instruction sends the counters kept by run() up to the PC as a series of
+        PROFILE_EVENT_ID events, each beginning with a byte saying what follows:
+
+          0  Stacks         deepest data stack (8), deepest return stack (8)
+          1  Instructions   instruction (8), count (16); repeated for each executed, up to 16
+          2  Definitions    address (16), calls (16), micros (32); repeated, up to 4
+
+        Counts are cleared afterward if the flag on the stack is non-zero. Events are packed at the
+        top of free dictionary space rather than at 'here' as usual; clear of the code that called
+        'profile' when sent to run at once (it sits at 'here' and goes on after). */
+
+#define PROFILE_FRAME 50 // largest event payload (id, kind and 16 instruction counts)
+
+    void profileHeader(uint8_t kind) // helper (not Brief instruction)
+    {
+        push(PROFILE_EVENT_ID);
+        eventHeader();
+        push(kind);
+        eventBody8();
+    }
+
+    void profileBody16(int16_t value) // helper (not Brief instruction)
+    {
+        push(value);
+        eventBody16();
+    }
+
+    void profile()
+    {
+        bool clear = pop() != 0;
+        int16_t here = vm->here;
+        if (vm->locals - PROFILE_FRAME > vm->here) vm->here = vm->locals - PROFILE_FRAME;
+
+        profileHeader(0);
+        push(profileDepth);
+        eventBody8();
+        push(profileRdepth);
+        eventBody8();
+        eventFooter();
+
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < MAX_PRIMITIVES; i++)
+        {
+            if (profileCounts[i] == 0) continue;
+            if (n == 0) profileHeader(1);
+            push(i);
+            eventBody8();
+            profileBody16(profileCounts[i]);
+            if (++n == 16)
+            {
+                eventFooter();
+                n = 0;
+            }
+        }
+        if (n != 0) eventFooter();
+
+        for (uint8_t w = 0; w < profileWordCount; w++)
+        {
+            if (w % 4 == 0) profileHeader(2);
+            profileBody16(profileWords[w].address);
+            profileBody16(profileWords[w].calls);
+            profileBody16(profileWords[w].micros >> 16);
+            profileBody16(profileWords[w].micros);
+            if (w % 4 == 3 || w == profileWordCount - 1) eventFooter();
+        }
+
+        if (clear)
+        {
+            for (uint8_t i = 0; i < MAX_PRIMITIVES; i++) profileCounts[i] = 0;
+            for (uint8_t i = 0; i < RETURN_STACK_SIZE; i++) profileFrames[i] = -1; // (those running go untimed)
+            profileWordCount = 0;
+            profileDepth = profileRdepth = 0;
+        }
+        vm->here = here;
+    }
+#undef PROFILE_FRAME
+#endif
+
+#ifdef BRIEF_TRACE
+
+    /*  The 'trace' instruction sends the trace up to the PC, along with the dictionary it runs upon,
+        as a series of TRACE_EVENT_ID events each beginning with a byte saying what follows:
+
+          0  State          here, last, locals, loop word, loop iterations, records (16 each)
+          1  Dictionary     address (16), then up to 32 bytes from there; beneath 'here' and locals
+          2  Records        up to 8 records; kind (8), op (8), a (16), b (16); oldest first
+
+        If the flag on the stack is non-zero, it's sent up again upon the next error (once). As with
+        'profile', events are packed at the top of free dictionary space and without using the data
+        stack (which may be what overflowed). Nothing is sent while replaying. */
+
+#define TRACE_FRAME 50 // largest event payload (id, kind and 8 records)
+
+    void traceByte(uint8_t b) // helper (not Brief instruction)
+    {
+        memset(vm->eventBuffer++, b);
+    }
+
+    void traceWord(int16_t x) // helper (not Brief instruction)
+    {
+        traceByte(x >> 8);
+        traceByte(x);
+    }
+
+    void traceHeader(uint8_t kind) // helper (not Brief instruction)
+    {
+        vm->eventBuffer = vm->here;
+        traceByte(TRACE_EVENT_ID);
+        traceByte(kind);
+    }
+
+    void sendTrace()
+    {
+        if (replaying != 0) return;
+        traceSending = true;
+        int16_t here = vm->here;
+        if (vm->locals - TRACE_FRAME > vm->here) vm->here = vm->locals - TRACE_FRAME;
+        uint16_t oldest = traceWrapped ? traceNext : 0, count = traceWrapped ? TRACE_SIZE : traceNext;
+
+        traceHeader(0);
+        traceWord(here);
+        traceWord(vm->last);
+        traceWord(vm->locals);
+        traceWord(vm->loopword);
+        traceWord(vm->loopIterations);
+        traceWord(count);
+        eventFooter();
+
+        for (int16_t address = 0; address < MEM_SIZE; address += 32)
+        {
+            if (address < here) // dictionary
+            {
+                traceHeader(1);
+                traceWord(address);
+                for (int16_t a = address; a < address + 32 && a < here; a++) traceByte(vm->memory[a]);
+                eventFooter();
+            }
+            else if (address + 32 > vm->locals) // locals
+            {
+                int16_t from = address < vm->locals ? vm->locals : address;
+                traceHeader(1);
+                traceWord(from);
+                for (int16_t a = from; a < address + 32 && a < MEM_SIZE; a++) traceByte(vm->memory[a]);
+                eventFooter();
+            }
+        }
+
+        for (uint16_t n = 0; n < count; n++)
+        {
+            if (n % 8 == 0) traceHeader(2);
+            TraceRecord* t = &trace[(oldest + n) % TRACE_SIZE];
+            traceByte(t->kind);
+            traceByte(t->op);
+            traceWord(t->a);
+            traceWord(t->b);
+            if (n % 8 == 7 || n == count - 1) eventFooter();
+        }
+
+        vm->here = here;
+        traceSending = false;
+    }
+
+#undef TRACE_FRAME
+
+    void traceOp() // send trace up to PC (arming it to be sent upon error if flag)
+    {
+        traceArmed = pop() != 0;
+        sendTrace();
+    }
+
+    uint16_t replay(const TraceRecord* records, uint16_t count) // replay trace upon selected machine
+    {
+        uint16_t start = 0;
+        while (start < count && records[start].kind != TRACE_EXEC) start++; // (bottom of the ring may be partial)
+        for (uint16_t i = count; i-- > start; ) // undo stores, newest first
+        {
+            if (records[i].kind == TRACE_STORE && Machine::inMemory(records[i].a)) vm->memory[records[i].a] = records[i].op;
+        }
+        replaying = records;
+        replayNext = start;
+        replayCount = count;
+        replayStopped = -1;
+        replayStarted = false;
+        vm->s = vm->dstackCells;
+        while (replayStopped < 0)
+        {
+            if (replayNext == count)
+            {
+                replayStopped = count;
+            }
+            else if (records[replayNext].kind == TRACE_EXEC)
+            {
+                exec(records[replayNext].a);
+            }
+            else if (records[replayNext].kind == TRACE_FRAME) // bytes into place (as Reflecta would) and received
+            {
+                uint16_t length = (uint16_t)(records[replayNext].op | records[replayNext].b << 8);
+                uint8_t* frame = vm->memory + vm->here;
+                for (uint16_t i = 0; i < length && vm->here + i < MEM_SIZE && replayNext + 1 + i / 5 < count; i++)
+                {
+                    const TraceRecord* t = &records[replayNext + 1 + i / 5];
+                    uint8_t k = i % 5;
+                    frame[i] = k == 0 ? t->op : k == 1 ? t->a >> 8 : k == 2 ? t->a : k == 3 ? t->b >> 8 : t->b;
+                }
+                frameReceived(records[replayNext].a, length, frame);
+            }
+            else
+            {
+                replayStopped = replayNext; // only an exec() or frame begins anything
+            }
+        }
+        replaying = 0;
+        return replayStopped;
+    }
+#endif
+
+#ifdef BRIEF_FUSED
+
+    /*  Superinstructions, selected with BRIEF_FUSED. Common pairs of instructions in new definitions
+        (see frameReceived) are fused into single instructions, bound from 66 up, saving a dispatch
+        each time they run. The candidates come from what the IL translator and idiomatic Brief
+        emit; BRIEF_PAIRS can be used to find others worth fusing for a particular workload.
+
+        The PC keeps track of where each definition lands in the dictionary, so code can't move or
+        shrink. Instead, only the opcode of the first instruction is rewritten and the fused
+        instruction steps over the second, which is left in place. Branching directly to the second
+        still works just as before. */
+
+    void fusedLit8Add() // lit8 add
+    {
+        lit8(); vm->p++;
+        add();
+    }
+
+    void fusedLit8EventOp() // lit8 eventOp
+    {
+        lit8(); vm->p++;
+        eventOp();
+    }
+
+    void fusedDupZbranch() // dup zbranch
+    {
+        dup(); vm->p++;
+        zbranch();
+    }
+
+    void fusedLocalFetch16() // local fetch16
+    {
+        local(); vm->p++;
+        fetch16();
+    }
+
+    void fusedLocalStore16() // local store16
+    {
+        local(); vm->p++;
+        store16();
+    }
+
+    void fusedEqZbranch() // eq zbranch
+    {
+        eq(); vm->p++;
+        zbranch();
+    }
+
+    void fusedNeqZbranch() // neq zbranch
+    {
+        neq(); vm->p++;
+        zbranch();
+    }
+
+    void fusedGtZbranch() // gt zbranch
+    {
+        gt(); vm->p++;
+        zbranch();
+    }
+
+    void fusedGeqZbranch() // geq zbranch
+    {
+        geq(); vm->p++;
+        zbranch();
+    }
+
+    void fusedLtZbranch() // lt zbranch
+    {
+        lt(); vm->p++;
+        zbranch();
+    }
+
+    void fusedLeqZbranch() // leq zbranch
+    {
+        leq(); vm->p++;
+        zbranch();
+    }
+
+    struct Fusion
+    {
+        void (*first)(); // pair of instructions (as bound)
+        void (*second)();
+        uint8_t fused; // instruction taking the place of the first
+        void (*instruction)(); // (as bound)
+    };
+
+    const Fusion fusions[] = {
+        { lit8,  add,     66, fusedLit8Add },
+        { lit8,  eventOp, 67, fusedLit8EventOp },
+        { dup,   zbranch, 68, fusedDupZbranch },
+        { local, fetch16, 69, fusedLocalFetch16 },
+        { local, store16, 70, fusedLocalStore16 },
+        { eq,    zbranch, 71, fusedEqZbranch },
+        { neq,   zbranch, 72, fusedNeqZbranch },
+        { gt,    zbranch, 73, fusedGtZbranch },
+        { geq,   zbranch, 74, fusedGeqZbranch },
+        { lt,    zbranch, 75, fusedLtZbranch },
+        { leq,   zbranch, 76, fusedLeqZbranch } };
+
+    void fuse(int16_t start, int16_t end) // rewrite fusable pairs within a new definition
+    {
+        int16_t a = start;
+        while (a < end)
+        {
+            uint8_t i = vm->memory[a];
+            int16_t b = a + length(i); // following instruction
+            if ((i & 0x80) == 0 && b < end && (vm->memory[b] & 0x80) == 0 && b + length(vm->memory[b]) <= end)
+            {
+                for (uint8_t k = 0; k < sizeof(fusions) / sizeof(Fusion); k++)
+                {
+                    const Fusion* f = &fusions[k];
+                    if (instructions[i] == f->first && instructions[vm->memory[b]] == f->second &&
+                        instructions[f->fused] == f->instruction)
+                    {
+                        vm->memory[a] = f->fused;
+                        b += length(vm->memory[b]); // second is stepped over (not fused again)
+                        break;
+                    }
+                }
+            }
+            a = b;
+        }
+    }
+
+#endif // BRIEF_FUSED
+
+#ifdef BRIEF_VERIFIED
+
+    /*  Definitions are verified as they arrive (see frameReceived), selected with BRIEF_VERIFIED.
+
+        The verifier walks every path through a new definition checking that operands and branch
+        targets stay within it, that calls go to the start of definitions already verified, and
+        that the stacks are used consistently; the same depths wherever paths join and wherever
+        the definition returns. What comes out is a summary: how many items the definition expects
+        on the data stack, its net effect and how much deeper each stack gets beneath it.
+
+        A call to a verified definition, when the stacks at hand meet its summary, is then run by
+        runVerified() with no stack or program counter checks at all. Memory indexed by computed
+        addresses (fetches, stores and locals) is still checked of course.
+
+        Anything the verifier can't reason about leaves the definition unverified and it runs the
+        checked way as always. That is: call, choice and chooseIf (computed targets), pick, roll,
+        clr and resetBoard (computed depths), recursion other than a tail call to itself, and any
+        instruction bound by the hosting project.
+
+        Summaries are dropped along with those of any later definitions calling down into them
+        when verified code is stored into, forgotten, reset or instructions are rebound. Only bytes
+        the verifier found reachable count as code; stores into quotations (which is how variables
+        are made) are left be. */
+
+    struct Verified
+    {
+        int16_t address; // start of definition
+        int16_t end; // one past the last byte
+        int16_t low; // lowest definition reached by calls (own address if none)
+        uint8_t needs; // data stack items expected upon entry
+        int8_t effect; // net data stack effect
+        uint8_t depth; // max data stack growth beyond entry
+        uint8_t rdepth; // max return stack growth beyond entry
+    };
+
+    Verified verified[MAX_VERIFIED]; // summaries in order of address
+    uint8_t verifiedCount = 0;
+    uint8_t verifiedStarts[MEM_SIZE / 8]; // bit per address; start of a verified definition
+    uint8_t verifiedBytes[MEM_SIZE / 8]; // bit per address; reachable code of a verified definition
+    int16_t verifiedEnd = 0; // end of last verified definition (stores beneath are watched)
+    uint8_t upsets = 0; // bumped whenever what runVerified() relies upon may have changed
+
+    bool verifiedAt(int16_t address) // helper (not Brief instruction)
+    {
+        return vm == &primary && (uint16_t)address < MEM_SIZE && (verifiedStarts[address >> 3] >> (address & 7)) & 1;
+    }
+
+    bool verifiedCode(int16_t address) // helper (not Brief instruction)
+    {
+        return (uint16_t)address < MEM_SIZE && (verifiedBytes[address >> 3] >> (address & 7)) & 1;
+    }
+
+    Verified* findVerified(int16_t address) // helper (not Brief instruction)
+    {
+        if (verifiedAt(address))
+        {
+            for (uint8_t i = 0; i < verifiedCount; i++)
+            {
+                if (verified[i].address == address) return &verified[i];
+            }
+        }
+        return 0;
+    }
+
+    void dropVerified(uint8_t k) // drop summary k and those calling down into it
+    {
+        int16_t address = verified[k].address;
+        uint8_t n = k;
+        for (uint8_t i = k; i < verifiedCount; i++)
+        {
+            Verified* v = &verified[i];
+            if (i == k || v->low <= address)
+            {
+                verifiedStarts[v->address >> 3] &= ~(1 << (v->address & 7));
+                for (int16_t a = v->address; a < v->end; a++)
+                {
+                    verifiedBytes[a >> 3] &= ~(1 << (a & 7));
+                }
+            }
+            else
+            {
+                verified[n++] = *v;
+            }
+        }
+        verifiedCount = n;
+        verifiedEnd = n > 0 ? verified[n - 1].end : 0;
+        upsets++;
+    }
+
+    void unverify(int16_t address) // verified code at address is changing
+    {
+        for (uint8_t i = 0; i < verifiedCount; i++)
+        {
+            if (address >= verified[i].address && address < verified[i].end)
+            {
+                dropVerified(i);
+                return;
+            }
+        }
+    }
+
+    void unverifyAll()
+    {
+        for (int16_t i = 0; i < MEM_SIZE / 8; i++)
+        {
+            verifiedStarts[i] = verifiedBytes[i] = 0;
+        }
+        verifiedCount = 0;
+        verifiedEnd = 0;
+        upsets++;
+    }
+
+    void forgetVerified() // drop summaries of definitions beyond 'here'
+    {
+        while (vm == &primary && verifiedCount > 0 && verified[verifiedCount - 1].end > vm->here)
+        {
+            dropVerified(verifiedCount - 1);
+        }
+    }
+
+/*  The stack effect of each built-in instruction (0-65) packed into a byte; items popped, items
+    pushed, operand bytes and what is done to the return stack. Control flow (ret, branch, zbranch
+    and quote) is handled by the verifier itself. */
+
+#define EFFECT(in, out, operands, rs) ((in) | (out) << 2 | (operands) << 4 | (rs) << 6)
+#define RS_PUSH 1
+#define RS_POP  2
+#define RS_PEEK 3 // must be non-empty
+#define NEVER   0xFF // can't be verified
+
+    const uint8_t effects[] = {
+        NEVER,                  // ret (special)
+        EFFECT(0, 1, 1, 0),     // lit8
+        EFFECT(0, 1, 2, 0),     // lit16
+        NEVER,                  // branch (special)
+        NEVER,                  // zbranch (special)
+        NEVER,                  // quote (special)
+        EFFECT(1, 0, 0, 0),     // eventHeader
+        EFFECT(1, 0, 0, 0),     // eventBody8
+        EFFECT(1, 0, 0, 0),     // eventBody16
+        EFFECT(0, 0, 0, 0),     // eventFooter
+        EFFECT(2, 0, 0, 0),     // eventOp
+        EFFECT(1, 1, 0, 0),     // fetch8
+        EFFECT(2, 0, 0, 0),     // store8
+        EFFECT(1, 1, 0, 0),     // fetch16
+        EFFECT(2, 0, 0, 0),     // store16
+        EFFECT(2, 1, 0, 0),     // add
+        EFFECT(2, 1, 0, 0),     // sub
+        EFFECT(2, 1, 0, 0),     // mul
+        EFFECT(2, 1, 0, 0),     // div
+        EFFECT(2, 1, 0, 0),     // mod
+        EFFECT(2, 1, 0, 0),     // andb
+        EFFECT(2, 1, 0, 0),     // orb
+        EFFECT(2, 1, 0, 0),     // xorb
+        EFFECT(2, 1, 0, 0),     // shift
+        EFFECT(2, 1, 0, 0),     // eq
+        EFFECT(2, 1, 0, 0),     // neq
+        EFFECT(2, 1, 0, 0),     // gt
+        EFFECT(2, 1, 0, 0),     // geq
+        EFFECT(2, 1, 0, 0),     // lt
+        EFFECT(2, 1, 0, 0),     // leq
+        EFFECT(1, 1, 0, 0),     // notb
+        EFFECT(1, 1, 0, 0),     // neg
+        EFFECT(1, 1, 0, 0),     // inc
+        EFFECT(1, 1, 0, 0),     // dec
+        EFFECT(1, 0, 0, 0),     // drop
+        EFFECT(1, 2, 0, 0),     // dup
+        EFFECT(2, 2, 0, 0),     // swap
+        NEVER,                  // pick
+        NEVER,                  // roll
+        NEVER,                  // clr
+        EFFECT(1, 0, 0, RS_PUSH), // pushr
+        EFFECT(0, 1, 0, RS_POP),  // popr
+        EFFECT(0, 1, 0, RS_PEEK), // peekr
+        EFFECT(1, 0, 0, 0),     // forget
+        EFFECT(1, 0, 0, RS_PUSH), // alloc
+        EFFECT(0, 0, 0, RS_POP),  // free
+        EFFECT(0, 0, 0, RS_PEEK), // tail (pops and pushes back)
+        EFFECT(1, 1, 0, 0),     // local
+        EFFECT(1, 1, 0, 0),     // localFetch16
+        EFFECT(2, 0, 0, 0),     // localStore16
+        NEVER,                  // call
+        NEVER,                  // choice
+        NEVER,                  // chooseIf
+        EFFECT(0, 1, 0, 0),     // loopTicks
+        EFFECT(1, 0, 0, 0),     // setLoop
+        EFFECT(0, 0, 0, 0),     // stopLoop
+        NEVER,                  // resetBoard
+        EFFECT(2, 0, 0, 0),     // pinMode
+        EFFECT(1, 1, 0, 0),     // digitalRead
+        EFFECT(2, 0, 0, 0),     // digitalWrite
+        EFFECT(1, 1, 0, 0),     // analogRead
+        EFFECT(2, 0, 0, 0),     // analogWrite
+        EFFECT(3, 0, 0, 0),     // attachISR
+        EFFECT(1, 0, 0, 0),     // detachISR
+        EFFECT(0, 1, 0, 0),     // milliseconds
+        EFFECT(2, 1, 0, 0) };   // pulseIn
+
+    uint8_t operands(uint8_t i) // helper (not Brief instruction)
+    {
+        if ((i & 0x80) || (i >= 3 && i <= 5)) return 1; // call, branch, zbranch, quote
+        return i < sizeof(effects) && effects[i] != NEVER ? (effects[i] >> 4) & 3 : 0;
+    }
+
+/*  Depths are kept relative to entry, for each address of the definition, in the free dictionary
+    space just above it (one byte data stack, one byte return stack). A definition for which there
+    isn't room simply isn't verified. Paths are swept in address order until nothing changes; only
+    backward branches cause another sweep. */
+
+#define UNKNOWN INT8_MAX
+
+    bool reach(int8_t* depths, int16_t len, int16_t from, int16_t a, int16_t d, int16_t rd, bool* again) // helper
+    {
+        if (a < 0 || a >= len) return false; // leaving the definition
+        if (d < -DATA_STACK_SIZE || d > DATA_STACK_SIZE || rd > RETURN_STACK_SIZE) return false;
+        if (depths[a] == UNKNOWN)
+        {
+            depths[a] = d;
+            depths[len + a] = rd;
+            if (a <= from) *again = true; // sweep again
+            return true;
+        }
+        return depths[a] == d && depths[len + a] == rd; // paths agree where they join
+    }
+
+    void verify(int16_t start, int16_t end) // summarize a new definition if it can run unchecked
+    {
+        int16_t len = end - start;
+        if (vm != &primary || verifiedCount >= MAX_VERIFIED || len <= 0 || len > (vm->locals - vm->here) / 2) return;
+        int8_t* depths = (int8_t*)vm->memory + vm->here; // data then return stack depths reaching each address
+        for (int16_t a = 0; a < len; a++)
+        {
+            depths[a] = UNKNOWN;
+        }
+        depths[0] = depths[len] = 0;
+
+        int16_t lowest = 0, highest = 0, rhighest = 0, exit = UNKNOWN, low = start;
+        bool again = true;
+        while (again)
+        {
+            again = false;
+            for (int16_t a = 0; a < len; a++)
+            {
+                int16_t d = depths[a], rd = depths[len + a];
+                if (d == UNKNOWN) continue;
+                uint8_t i = vm->memory[start + a];
+                int16_t n = operands(i);
+                if (a + n >= len) return; // operands beyond the end
+                if (i < MAX_PRIMITIVES && (custom[i >> 3] >> (i & 7)) & 1) return;
+                int16_t next = a + 1 + n, target = -1; // fall through and/or branch
+                if (i & 0x80) // call
+                {
+                    int16_t callee = ((i << 8) & 0x7F00) | vm->memory[start + a + 1];
+                    if (a + 2 >= len) return; // return following (TCO) unknown
+                    bool tco = vm->memory[start + a + 2] == 0;
+                    if (callee == start)
+                    {
+                        if (!tco) return; // recursion (unbounded)
+                        next = 0; // tail call to self is a loop
+                    }
+                    else
+                    {
+                        Verified* v = findVerified(callee);
+                        if (v == 0) return;
+                        lowest = min(lowest, d - v->needs);
+                        highest = max(highest, d + v->depth);
+                        rhighest = max(rhighest, rd + !tco + v->rdepth);
+                        low = min(low, v->low);
+                        d += v->effect;
+                        if (tco) i = 0; // returning (below)
+                    }
+                }
+                else if (i == 4) // zbranch
+                {
+                    lowest = min(lowest, --d);
+                    target = a + 1 + (int8_t)vm->memory[start + a + 1];
+                }
+                else if (i == 3) // branch
+                {
+                    next = a + 1 + (int8_t)vm->memory[start + a + 1];
+                }
+                else if (i == 5) // quote (jumping over quotation)
+                {
+                    highest = max(highest, ++d);
+                    next += vm->memory[start + a + 1];
+                }
+                else if (i != 0)
+                {
+                    uint8_t e = i < sizeof(effects) ? effects[i] : NEVER;
+                    if (e == NEVER) return;
+                    d -= e & 3;
+                    lowest = min(lowest, d);
+                    d += (e >> 2) & 3;
+                    highest = max(highest, d);
+                    switch (e >> 6)
+                    {
+                        case RS_PUSH: rhighest = max(rhighest, ++rd); break;
+                        case RS_POP: if (--rd < 0) return; break;
+                        case RS_PEEK: if (rd < 1) return; break;
+                    }
+                }
+                if (i == 0) // return (or TCO)
+                {
+                    if (rd != 0 || (exit != UNKNOWN && exit != d)) return;
+                    exit = d;
+                    continue;
+                }
+                if (!reach(depths, len, a, next, d, rd, &again)) return;
+                if (target >= 0 && !reach(depths, len, a, target, d, rd, &again)) return;
+            }
+        }
+
+        for (int16_t a = 0; a < len; a++) // not branching into operands
+        {
+            if (depths[a] == UNKNOWN) continue;
+            for (int16_t n = operands(vm->memory[start + a]); n > 0; n--)
+            {
+                if (depths[a + n] != UNKNOWN) return;
+            }
+        }
+
+        if (-lowest + highest > DATA_STACK_SIZE || 1 + rhighest > RETURN_STACK_SIZE) return;
+        for (int16_t a = 0; a < len; a++) // mark reachable code (instructions and operands)
+        {
+            if (depths[a] == UNKNOWN) continue;
+            for (int16_t n = operands(vm->memory[start + a]); n >= 0; n--)
+            {
+                int16_t b = start + a + n;
+                verifiedBytes[b >> 3] |= 1 << (b & 7);
+            }
+        }
+        Verified* v = &verified[verifiedCount++];
+        v->address = start;
+        v->end = end;
+        v->low = low;
+        v->needs = -lowest;
+        v->effect = exit == UNKNOWN ? 0 : exit;
+        v->depth = highest;
+        v->rdepth = rhighest;
+        verifiedStarts[start >> 3] |= 1 << (start & 7);
+        verifiedEnd = end;
+    }
+
+#undef EFFECT
+#undef RS_PUSH
+#undef RS_POP
+#undef RS_PEEK
+#undef NEVER
+#undef UNKNOWN
+
+    bool safe(int16_t address) // may the verified definition at address run unchecked right now?
+    {
+#ifdef BRIEF_FUEL
+        if (vm->fuel >= 0) return false; // running on a budget (counted instruction by instruction)
+#endif
+        Verified* v = findVerified(address);
+        int16_t depth = vm->s - vm->dstack() + 1, rdepth = vm->r - vm->rstack + 1;
+        return v != 0 && depth >= v->needs && depth + v->depth <= DATA_STACK_SIZE &&
+               rdepth >= 1 && rdepth + v->rdepth <= RETURN_STACK_SIZE;
+    }
+
+/*  Verified code runs here until it returns from the definition it was entered at, or until
+    something upsets the verifier's assumptions (an error or a change to verified code), in which
+    case it carries on in the checked run() from wherever it was. Only the hot instructions are
+    inline; the rest are called through the table as usual. Only ever the primary machine's. */
+
+    void runVerified() // run verified code at p (see safe())
+    {
+        uint8_t* const memory = primary.memory;
+        Cell* const base = primary.r; // returning beneath this leaves the definition
+        uint8_t before = upsets;
+        int16_t pc = primary.p;
+        Cell* sp = primary.s;
+        Cell* rp = primary.r;
+        Cell x;
+        uint8_t i;
+#ifdef BRIEF_BENCH
+        uint32_t count = 0;
+#endif
+#define CODE(a) (verifiedCode(a) || verifiedCode((a) + 1)) // 16-bit store into verified code
+        for (;;)
+        {
+#ifdef BRIEF_BENCH
+            count++;
+#endif
+            i = memory[pc++];
+            if (i & 0x80) // address to call
+            {
+                if (memory[pc + 1] != 0) *++rp = pc + 1; // not followed by return (TCO)
+                pc = ((i << 8) & 0x7F00) | memory[pc];
+                continue;
+            }
+            switch (i)
+            {
+                case 0: pc = *rp--; if (rp < base) goto leave; continue; // ret
+                case 1: *++sp = (int8_t)memory[pc++]; continue; // lit8
+                case 2: *++sp = (int16_t)(memory[pc] << 8 | memory[pc + 1]); pc += 2; continue; // lit16
+                case 3: pc += (int8_t)memory[pc]; continue; // branch
+                case 4: pc += *sp-- == 0 ? (int8_t)memory[pc] : 1; continue; // zbranch
+                case 5: x = memory[pc++]; *++sp = pc; pc += x; continue; // quote
+                case 11: if ((UCell)*sp >= MEM_SIZE) break; *sp = memory[*sp]; continue; // fetch8
+                case 12: x = *sp; if ((UCell)x >= MEM_SIZE || verifiedCode(x)) break; // store8
+                         memory[x] = sp[-1]; sp -= 2; continue;
+                case 13: if ((UCell)*sp >= MEM_SIZE - 1) break; // fetch16
+                         *sp = (int16_t)(memory[*sp] << 8 | memory[*sp + 1]); continue;
+                case 14: x = *sp; if ((UCell)x >= MEM_SIZE - 1 || CODE(x)) break; // store16
+                         memory[x] = sp[-1] >> 8; memory[x + 1] = sp[-1]; sp -= 2; continue;
+                case 15: sp--; *sp += sp[1]; continue; // add
+                case 16: sp--; *sp -= sp[1]; continue; // sub
+                case 17: sp--; *sp *= sp[1]; continue; // mul
+                case 20: sp--; *sp &= sp[1]; continue; // andb
+                case 21: sp--; *sp |= sp[1]; continue; // orb
+                case 22: sp--; *sp ^= sp[1]; continue; // xorb
+                case 24: sp--; *sp = boolval(*sp == sp[1]); continue; // eq
+                case 25: sp--; *sp = boolval(*sp != sp[1]); continue; // neq
+                case 26: sp--; *sp = boolval(*sp > sp[1]); continue; // gt
+                case 27: sp--; *sp = boolval(*sp >= sp[1]); continue; // geq
+                case 28: sp--; *sp = boolval(*sp < sp[1]); continue; // lt
+                case 29: sp--; *sp = boolval(*sp <= sp[1]); continue; // leq
+                case 30: *sp = ~*sp; continue; // notb
+                case 31: *sp = -*sp; continue; // neg
+                case 32: ++*sp; continue; // inc
+                case 33: --*sp; continue; // dec
+                case 34: sp--; continue; // drop
+                case 35: sp[1] = *sp; sp++; continue; // dup
+                case 36: x = *sp; *sp = sp[-1]; sp[-1] = x; continue; // swap
+                case 40: *++rp = *sp--; continue; // pushr
+                case 41: *++sp = *rp--; continue; // popr
+                case 42: *++sp = *rp; continue; // peekr
+                case 47: *sp += primary.locals; continue; // local
+                case 48: x = primary.locals + *sp; if ((UCell)x >= MEM_SIZE - 1) break; // localFetch16
+                         *sp = (int16_t)(memory[x] << 8 | memory[x + 1]); continue;
+                case 49: x = primary.locals + *sp; if ((UCell)x >= MEM_SIZE - 1 || CODE(x)) break; // localStore16
+                         memory[x] = sp[-1] >> 8; memory[x + 1] = sp[-1]; sp -= 2; continue;
+#ifdef BRIEF_FUSED
+                case 66: *sp += (int8_t)memory[pc]; pc += 2; continue; // lit8 add
+                case 68: pc += *sp == 0 ? 1 + (int8_t)memory[pc + 1] : 2; continue; // dup zbranch
+                case 69: x = primary.locals + *sp; if ((UCell)x >= MEM_SIZE - 1) break; // local fetch16
+                         *sp = (int16_t)(memory[x] << 8 | memory[x + 1]); pc++; continue;
+                case 70: x = primary.locals + *sp; if ((UCell)x >= MEM_SIZE - 1 || CODE(x)) break; // local store16
+                         memory[x] = sp[-1] >> 8; memory[x + 1] = sp[-1]; sp -= 2; pc++; continue;
+#define ZBRANCH_IF(cmp) sp -= 2; pc += sp[1] cmp sp[2] ? 2 : 1 + (int8_t)memory[pc + 1]; continue
+                case 71: ZBRANCH_IF(==); // eq zbranch
+                case 72: ZBRANCH_IF(!=); // neq zbranch
+                case 73: ZBRANCH_IF(>); // gt zbranch
+                case 74: ZBRANCH_IF(>=); // geq zbranch
+                case 75: ZBRANCH_IF(<); // lt zbranch
+                case 76: ZBRANCH_IF(<=); // leq zbranch
+#undef ZBRANCH_IF
+#endif
+            }
+            // everything else (and the above when their checks fail) through the table
+            primary.s = sp; primary.r = rp; primary.p = pc;
+            instructions[i]();
+            sp = primary.s; rp = primary.r; pc = primary.p;
+            if (upsets != before) goto leave; // carry on checked
+        }
+
+    leave:
+        primary.s = sp; primary.r = rp; primary.p = pc;
+#ifdef BRIEF_BENCH
+        dispatches += count;
+#endif
+#undef CODE
+    }
+
+#endif // BRIEF_VERIFIED
+
+#ifdef BRIEF_THREADED
+
+    /*  Threaded interpreter core (GCC computed goto), selected with BRIEF_THREADED.
+
+        Rather than calling through the instruction table, each built-in instruction is a label
+        within run() and dispatch jumps directly from one to the next. The program counter, stack
+        pointers and top of stack live in locals (registers) and are written back to the machine
+        only when leaving run() or calling out to a function.
+
+        Anything not handled inline goes the slow way through instructions[]. That is user-bound
+        instructions, built-ins that have been rebound, and built-ins whose stack or memory
+        preconditions don't hold. Errors and custom bindings therefore behave exactly as in the
+        plain core.
+
+        GCC is kept from merging the dispatch at the end of each instruction into a single shared
+        indirect jump (which would defeat the point) by turning off cross-jumping and GCSE here. */
+
+#ifndef __clang__
+    __attribute__((optimize("no-gcse", "no-crossjumping")))
+#endif
+    void run() // run code at p
+    {
+        static void* table[MAX_PRIMITIVES];
+        if (rebound)
+        {
+            for (int16_t j = 0; j < MAX_PRIMITIVES; j++)
+            {
+                table[j] = &&slow; // bound function
+            }
+#define NATIVE(i, f) if (instructions[i] == f) table[i] = &&do_##f
+            NATIVE(0,  ret);
+            NATIVE(1,  lit8);
+            NATIVE(2,  lit16);
+            NATIVE(3,  branch);
+            NATIVE(4,  zbranch);
+            NATIVE(5,  quote);
+            NATIVE(11, fetch8);
+            NATIVE(12, store8);
+            NATIVE(13, fetch16);
+            NATIVE(14, store16);
+            NATIVE(15, add);
+            NATIVE(16, sub);
+            NATIVE(17, mul);
+            NATIVE(18, div);
+            NATIVE(19, mod);
+            NATIVE(20, andb);
+            NATIVE(21, orb);
+            NATIVE(22, xorb);
+            NATIVE(23, shift);
+            NATIVE(24, eq);
+            NATIVE(25, neq);
+            NATIVE(26, gt);
+            NATIVE(27, geq);
+            NATIVE(28, lt);
+            NATIVE(29, leq);
+            NATIVE(30, notb);
+            NATIVE(31, neg);
+            NATIVE(32, inc);
+            NATIVE(33, dec);
+            NATIVE(34, drop);
+            NATIVE(35, dup);
+            NATIVE(36, swap);
+            NATIVE(40, pushr);
+            NATIVE(41, popr);
+            NATIVE(42, peekr);
+            NATIVE(47, local);
+            NATIVE(48, localFetch16);
+            NATIVE(49, localStore16);
+            NATIVE(50, call);
+            NATIVE(51, choice);
+            NATIVE(52, chooseIf);
+#ifdef BRIEF_FUSED
+            NATIVE(66, fusedLit8Add);
+            NATIVE(68, fusedDupZbranch);
+            NATIVE(69, fusedLocalFetch16);
+            NATIVE(70, fusedLocalStore16);
+            NATIVE(71, fusedEqZbranch);
+            NATIVE(72, fusedNeqZbranch);
+            NATIVE(73, fusedGtZbranch);
+            NATIVE(74, fusedGeqZbranch);
+            NATIVE(75, fusedLtZbranch);
+            NATIVE(76, fusedLeqZbranch);
+#endif
+#undef NATIVE
+            rebound = false;
+        }
+
+        Machine* const m = vm;
+        uint8_t (&memory)[MEM_SIZE] = m->memory; // (addressed off m)
+        Cell (&rstack)[RETURN_STACK_SIZE] = m->rstack;
+        int16_t pc = m->p; // program counter
+        Cell* sp = m->s; // data stack pointer
+        Cell tos = *sp; // top of stack (stale in memory until written back)
+        Cell* rp = m->r; // return stack pointer
+        uint8_t i; // current instruction
+        Cell x, y, z;
+#ifdef BRIEF_FUEL
+        int16_t fuel = m->fuel; // instructions left in the slice (-1 unlimited)
+#define FUEL        if (fuel > 0) fuel--; else if (fuel == 0) goto done;
+#define FUEL_SYNC   m->fuel = fuel;
+#define FUEL_RELOAD fuel = m->fuel;
+#else
+#define FUEL
+#define FUEL_SYNC
+#define FUEL_RELOAD
+#endif
+
+#define SYNC    { *sp = tos; m->s = sp; m->r = rp; m->p = pc; FUEL_SYNC }
+#define RELOAD  { sp = m->s; tos = *sp; rp = m->r; pc = m->p; FUEL_RELOAD }
+#define PUSH(v) { *sp++ = tos; tos = (v); }
+#define POP(v)  { v = tos; tos = *--sp; }
+#define NEED(n) if (sp < m->dstackCells + (n)) goto slow // n items on the data stack
+#define ROOM(n) if (sp > m->dstackCells + DATA_STACK_SIZE - (n)) goto slow // space to push n
+#define RNEED   if (rp < rstack) goto slow
+#define RROOM   if (rp >= rstack + RETURN_STACK_SIZE - 1) goto slow
+#define CODE(n) if ((uint16_t)(pc + (n)) > MEM_SIZE) goto slow // n operand bytes at pc
+#define DATA(a, n) if ((UCell)(a) > MEM_SIZE - (n)) goto slow // n bytes at address a
+#define DONE    if (pc < 0) goto done
+#ifdef BRIEF_VERIFIED
+#define CODE_STORE(a) if ((a) < verifiedEnd && m == &primary && (verifiedCode(a) || verifiedCode((a) + 1))) goto slow // (see unverify)
+#else
+#define CODE_STORE(a)
+#endif
+#ifdef BRIEF_BENCH
+        uint32_t count = 0;
+#define COUNT   count++;
+#else
+#define COUNT
+#endif
+#define NEXT    { COUNT FUEL if ((uint16_t)pc >= MEM_SIZE) goto fault; \
+                  i = memory[pc++]; if (i & 0x80) goto jump; goto *table[i]; }
+#define BINARY(expr) NEED(2); sp--; tos = (expr); NEXT
+#define ZBRANCH_IF(cmp) NEED(2); CODE(2); POP(x); POP(y); pc += y cmp x ? 2 : 1 + (int8_t)memory[pc + 1]; DONE; NEXT
+
+        NEXT;
+
+    jump: // address to call
+        if ((uint16_t)(pc + 1) >= MEM_SIZE) goto slowJump;
+        if (memory[pc + 1] != 0) // not followed by return (TCO)
+        {
+            if (rp >= rstack + RETURN_STACK_SIZE - 1) goto slowJump;
+            *++rp = pc + 1; // return address
+        }
+        pc = ((i << 8) & 0x7F00) | memory[pc];
+#ifdef BRIEF_VERIFIED
+        if (verifiedAt(pc))
+        {
+            SYNC;
+            if (safe(m->p)) runVerified(); // unchecked until it returns
+            RELOAD;
+            DONE;
+        }
+#endif
+        NEXT;
+
+    slowJump:
+        SYNC;
+        if (mem(m->p + 1) != 0) rpush(m->p + 1);
+        m->p = ((i << 8) & 0x7F00) | mem(m->p);
+        RELOAD;
+        DONE;
+        NEXT;
+
+    fault: // program counter outside of memory
+        SYNC;
+        i = mem(m->p++); // error (and return instruction)
+        RELOAD;
+        // fall through
+
+    slow: // call through the instruction table
+        SYNC;
+        instructions[i]();
+        RELOAD;
+        DONE;
+        NEXT;
+
+    do_ret:          RNEED; pc = *rp--; DONE; NEXT;
+    do_lit8:         ROOM(1); CODE(1); PUSH((int8_t)memory[pc]); pc++; NEXT;
+    do_lit16:        ROOM(1); CODE(2); PUSH((int16_t)(memory[pc] << 8 | memory[pc + 1])); pc += 2; NEXT;
+    do_branch:       CODE(1); pc += (int8_t)memory[pc]; DONE; NEXT;
+    do_zbranch:      NEED(1); CODE(1); POP(x); pc += x == 0 ? (int8_t)memory[pc] : 1; DONE; NEXT;
+    do_quote:        ROOM(1); CODE(1); x = memory[pc++]; PUSH(pc); pc += x; NEXT;
+    do_fetch8:       NEED(1); DATA(tos, 1); tos = memory[tos]; NEXT;
+    do_store8:       NEED(2); DATA(tos, 1); CODE_STORE(tos); memory[tos] = sp[-1]; sp -= 2; tos = *sp; NEXT;
+    do_fetch16:      NEED(1); DATA(tos, 2); tos = (int16_t)(memory[tos] << 8 | memory[tos + 1]); NEXT;
+    do_store16:      NEED(2); DATA(tos, 2); CODE_STORE(tos); memory[tos] = sp[-1] >> 8; memory[tos + 1] = sp[-1];
+                     sp -= 2; tos = *sp; NEXT;
+    do_add:          BINARY(*sp + tos);
+    do_sub:          BINARY(*sp - tos);
+    do_mul:          BINARY(*sp * tos);
+    do_div:          BINARY(*sp / tos);
+    do_mod:          BINARY(*sp % tos);
+    do_andb:         BINARY(*sp & tos);
+    do_orb:          BINARY(*sp | tos);
+    do_xorb:         BINARY(*sp ^ tos);
+    do_shift:        BINARY(tos < 0 ? *sp << -tos : *sp >> tos);
+    do_eq:           BINARY(boolval(*sp == tos));
+    do_neq:          BINARY(boolval(*sp != tos));
+    do_gt:           BINARY(boolval(*sp > tos));
+    do_geq:          BINARY(boolval(*sp >= tos));
+    do_lt:           BINARY(boolval(*sp < tos));
+    do_leq:          BINARY(boolval(*sp <= tos));
+    do_notb:         NEED(1); tos = ~tos; NEXT;
+    do_neg:          NEED(1); tos = -tos; NEXT;
+    do_inc:          NEED(1); tos++; NEXT;
+    do_dec:          NEED(1); tos--; NEXT;
+    do_drop:         NEED(1); tos = *--sp; NEXT;
+    do_dup:          NEED(1); ROOM(1); PUSH(tos); NEXT;
+    do_swap:         NEED(2); x = sp[-1]; sp[-1] = tos; tos = x; NEXT;
+    do_pushr:        NEED(1); RROOM; POP(x); *++rp = x; NEXT;
+    do_popr:         RNEED; ROOM(1); PUSH(*rp--); NEXT;
+    do_peekr:        RNEED; ROOM(1); PUSH(*rp); NEXT;
+    do_local:        NEED(1); tos += m->locals; NEXT;
+    do_localFetch16: NEED(1); x = m->locals + tos; DATA(x, 2); tos = (int16_t)(memory[x] << 8 | memory[x + 1]); NEXT;
+    do_localStore16: NEED(2); x = m->locals + tos; DATA(x, 2); CODE_STORE(x); memory[x] = sp[-1] >> 8; memory[x + 1] = sp[-1];
+                     sp -= 2; tos = *sp; NEXT;
+    do_call:         NEED(1); RROOM; *++rp = pc; POP(pc); DONE; NEXT;
+    do_choice:       NEED(3); RROOM; x = tos; y = sp[-1]; z = sp[-2]; sp -= 3; tos = *sp;
+                     *++rp = pc; pc = z == 0 ? x : y; DONE; NEXT;
+    do_chooseIf:     NEED(2); RROOM; x = tos; y = sp[-1]; sp -= 2; tos = *sp;
+                     if (y != 0) { *++rp = pc; pc = x; } DONE; NEXT;
+#ifdef BRIEF_FUSED
+    do_fusedLit8Add:      NEED(1); ROOM(1); CODE(2); tos += (int8_t)memory[pc]; pc += 2; NEXT;
+    do_fusedDupZbranch:   NEED(1); ROOM(1); CODE(2); pc += tos == 0 ? 1 + (int8_t)memory[pc + 1] : 2; DONE; NEXT;
+    do_fusedLocalFetch16: NEED(1); x = m->locals + tos; DATA(x, 2); tos = (int16_t)(memory[x] << 8 | memory[x + 1]); pc++; NEXT;
+    do_fusedLocalStore16: NEED(2); x = m->locals + tos; DATA(x, 2); CODE_STORE(x); memory[x] = sp[-1] >> 8; memory[x + 1] = sp[-1];
+                          sp -= 2; tos = *sp; pc++; NEXT;
+    do_fusedEqZbranch:    ZBRANCH_IF(==);
+    do_fusedNeqZbranch:   ZBRANCH_IF(!=);
+    do_fusedGtZbranch:    ZBRANCH_IF(>);
+    do_fusedGeqZbranch:   ZBRANCH_IF(>=);
+    do_fusedLtZbranch:    ZBRANCH_IF(<);
+    do_fusedLeqZbranch:   ZBRANCH_IF(<=);
+#endif
+
+    done:
+        SYNC;
+#ifdef BRIEF_BENCH
+        dispatches += count;
+#endif
+
+#undef SYNC
+#undef RELOAD
+#undef PUSH
+#undef POP
+#undef NEED
+#undef ROOM
+#undef RNEED
+#undef RROOM
+#undef CODE
+#undef DATA
+#undef DONE
+#undef CODE_STORE
+#undef COUNT
+#undef FUEL
+#undef FUEL_SYNC
+#undef FUEL_RELOAD
+#undef NEXT
+#undef BINARY
+#undef ZBRANCH_IF
+    }
+
+#endif // BRIEF_THREADED
+
+#ifdef BRIEF_AOT
+
+    /*  Words translated to C++ ahead of time (see host/aot.cpp), selected with BRIEF_AOT. The
+        generated source carries the dictionary image they were translated from, loaded upon setup,
+        and the table of compiled words (sorted by address) through which exec() and calls made by
+        interpreted code find them. Compiled words call each other natively; their return addresses
+        live on the native stack rather than the return stack.
+
+        A compiled word stands in for its bytecode only as long as that is unchanged. Storing into
+        the bytes it was translated from, or forgetting/resetting the dictionary beneath it, marks it
+        stale and the bytecode is interpreted from then on. Data living within the image (variables
+        for example) only stales the quotations holding it, which are never called anyway. */
+
+    void (*compiledWord(int16_t address))() // compiled function for word at address (or 0)
+    {
+        if (vm != &primary) return 0; // (image loaded into the primary machine only)
+        int16_t low = 0, high = compiledCount - 1;
+        while (low <= high)
+        {
+            int16_t mid = (low + high) / 2;
+            if (compiled[mid].address == address)
+            {
+                return compiled[mid].stale ? 0 : compiled[mid].word;
+            }
+            if (compiled[mid].address < address) low = mid + 1;
+            else high = mid - 1;
+        }
+        return 0;
+    }
+
+    void staleCompiled(int16_t low, int16_t high) // bytes [low, high) no longer as translated
+    {
+        if (vm != &primary) return;
+        for (uint8_t i = 0; i < compiledCount; i++)
+        {
+            if (compiled[i].low < high && compiled[i].high > low) compiled[i].stale = true;
+        }
+    }
+
+    void callWord(int16_t address)
+    {
+        void (*word)() = compiledWord(address);
+        if (word != 0)
+        {
+            word();
+        }
+        else // interpret until it returns
+        {
+            int16_t resume = vm->p;
+            rpush(-1); // causing run() to fall through upon return
+            vm->p = address;
+            run();
+            vm->p = resume;
+        }
+    }
+
+    void loadImage() // dictionary as translated
+    {
+        for (int16_t a = 0; a < imageSize; a++)
+        {
+            vm->memory[a] = pgm_read_byte(image + a);
+        }
+        vm->here = vm->last = imageSize;
+        for (uint8_t i = 0; i < compiledCount; i++)
+        {
+            compiled[i].stale = false;
+        }
+    }
+
+#endif // BRIEF_AOT
+
+    /*  The Brief VM needs to be hooked into the main setup and loop on the hosting project. It's
+        also expected that Reflecta framing is hooked.  A minimal *.ino would contain something like
+        what you find in the main Brief.ino.
+
+        Brief setup hooks into Reflecta framing, and binds all of the instruction functions from
+        above. After setup, the hosting project is free to bind its own custom functions as well! */
+
+    void setup()
+    {
+        // we want to allocate frames from the dictionary
+        reflectaFrames::setBufferAllocationCallback(frameAllocation);
+
+        // we want to process frames by executing bytecode
+        reflectaFrames::setFrameReceivedCallback(frameReceived);
+
+        resetBoard();
+#ifdef BRIEF_PAGED
+        pagesReset();
+#endif
+
+        bind(0,  ret); // assumed in frameReceived
+        bind(1,  lit8);
+        bind(2,  lit16);
+        bind(3,  branch); // used only by IL translation
+        bind(4,  zbranch); // used only by IL translation
+        bind(5,  quote);
+        bind(6,  eventHeader);
+        bind(7,  eventBody8);
+        bind(8,  eventBody16);
+        bind(9,  eventFooter);
+        bind(10, eventOp);
+        bind(11, fetch8);
+        bind(12, store8);
+        bind(13, fetch16);
+        bind(14, store16);
+        bind(15, add);
+        bind(16, sub);
+        bind(17, mul);
+        bind(18, div);
+        bind(19, mod);
+        bind(20, andb);
+        bind(21, orb);
+        bind(22, xorb);
+        bind(23, shift);
+        bind(24, eq);
+        bind(25, neq);
+        bind(26, gt);
+        bind(27, geq);
+        bind(28, lt);
+        bind(29, leq);
+        bind(30, notb);
+        bind(31, neg);
+        bind(32, inc);
+        bind(33, dec);
+        bind(34, drop);
+        bind(35, dup);
+        bind(36, swap);
+        bind(37, pick);
+        bind(38, roll);
+        bind(39, clr);
+        bind(40, pushr);
+        bind(41, popr);
+        bind(42, peekr);
+        bind(43, forget);
+        bind(44, alloc);
+        bind(45, free);
+        bind(46, tail);
+        bind(47, local);
+        bind(48, localFetch16);
+        bind(49, localStore16);
+        bind(50, call);
+        bind(51, choice);
+        bind(52, chooseIf);
+        bind(53, loopTicks);
+        bind(54, setLoop);
+        bind(55, stopLoop);
+        bind(56, resetBoard);
+        bind(57, pinMode);
+        bind(58, digitalRead);
+        bind(59, digitalWrite);
+        bind(60, analogRead);
+        bind(61, analogWrite);
+        bind(62, attachISR);
+        bind(63, detachISR);
+        bind(64, milliseconds);
+        bind(65, pulseIn);
+
+#ifdef BRIEF_FUSED
+        bind(66, fusedLit8Add);
+        bind(67, fusedLit8EventOp);
+        bind(68, fusedDupZbranch);
+        bind(69, fusedLocalFetch16);
+        bind(70, fusedLocalStore16);
+        bind(71, fusedEqZbranch);
+        bind(72, fusedNeqZbranch);
+        bind(73, fusedGtZbranch);
+        bind(74, fusedGeqZbranch);
+        bind(75, fusedLtZbranch);
+        bind(76, fusedLeqZbranch);
+#endif
+#ifdef BRIEF_PROFILE
+        bind(77, profile);
+#endif
+#ifdef BRIEF_TRACE
+        bind(78, traceOp);
+#endif
+#ifdef BRIEF_FUEL
+        bind(79, yield);
+#endif
+#ifdef BRIEF_TASKS
+        bind(80, spawn);
+        bind(81, kill);
+        bind(82, tasks);
+#endif
+#ifdef BRIEF_PERIODIC
+        bind(83, every);
+        bind(84, cancel);
+        bind(85, timing);
+#endif
+#ifdef BRIEF_DEFERRED
+        bind(86, isrPin);
+        bind(87, isrEvent);
+#endif
+#ifdef BRIEF_DELTAS
+        bind(88, eventDelta);
+        bind(89, keyframe);
+#endif
+#ifdef BRIEF_SNAPSHOT
+        bind(90, snapshot);
+#endif
+#ifdef BRIEF_PAGED
+        bind(91, paging);
+#endif
+#ifdef BRIEF_COMPACT
+        bind(92, compact);
+#endif
+
+#ifdef BRIEF_VERIFIED
+        for (int16_t i = 0; i < MAX_PRIMITIVES / 8; i++)
+        {
+            custom[i] = 0; // built-ins as bound above
+        }
+#endif
+
+        for (int16_t i = 0; i < MAX_INTERRUPTS; i++)
+        {
+            vm->isrs[i] = -1;
+        }
+
+#ifdef BRIEF_PROFILE
+        for (int16_t i = 0; i < RETURN_STACK_SIZE; i++)
+        {
+            profileFrames[i] = -1;
+        }
+#endif
+
+#ifdef BRIEF_AOT
+        loadImage();
+#endif
+#ifdef BRIEF_SNAPSHOT
+        restore(); // (running as before the reset)
+#endif
+
+        event(BOOT_EVENT_ID, 0); // boot event
+#ifdef BRIEF_COALESCED
+        flushEvents();
+#endif
+    }
+
+    void loop()
+    {
+#ifdef BRIEF_DEFERRED
+        deferred();
+#endif
+#ifdef BRIEF_PERIODIC
+        dispatch();
+#endif
+#ifdef BRIEF_SLICED
+        if (vm->held >= 0)
+        {
+            slice(); // carry on
+        }
+        else
+        {
+            while (vm->held < 0 && vm->queued > 0) unqueue(); // frames held meanwhile
+            if (vm->held < 0 && vm->loopword >= 0) begin(vm->loopword, 0);
+        }
+#else
+        if (vm->loopword >= 0)
+        {
+            exec(vm->loopword);
+            vm->loopIterations++;
+        }
+#endif
+#ifdef BRIEF_TASKS
+        schedule();
+#endif
+#ifdef BRIEF_PAGED
+        prefetch(); // ahead of the next pass
+#endif
+#ifdef BRIEF_COALESCED
+        flushEventsDue(); // end of the tick
+#endif
+    }
+}
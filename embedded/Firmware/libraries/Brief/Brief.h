@@ -1,55 +1,372 @@
-/* Brief.h
-
-   Scriptable firmware for interfacing hardware with the Microsoft Robotics for Windows libraries
-   and for running real time control loops. */
-
-#define __STDC_LIMIT_MACROS
-//#include <Arduino.h>
-//#include <Servo.h>
-#include <ReflectaFramesSerial.h>
-//#include <Wire.h>
-
-#ifndef BRIEF_H
-#define BRIEF_H
-
-#define MEM_SIZE          512  // dictionary and local/args space
-#define DATA_STACK_SIZE   4    // evaluation stack elements (int32s)
-#define RETURN_STACK_SIZE 4    // return and locals stack elements (int32s)
-
-#define MAX_PRIMITIVES    128  // max number of primitive (7-bit) instructions
-#define MAX_INTERRUPTS    6    // max number of ISR words
-//#define MAX_SERVOS        48   // max number of servos
-
-#define BOOT_EVENT_ID     0xFF // event sent upon 'setup' (not reset)
-#define VM_EVENT_ID       0xFC // event sent upon VM error
-
-#define VM_ERROR_RETURN_STACK_UNDERFLOW 0
-#define VM_ERROR_RETURN_STACK_OVERFLOW  1
-#define VM_ERROR_DATA_STACK_UNDERFLOW   2
-#define VM_ERROR_DATA_STACK_OVERFLOW    3
-#define VM_ERROR_OUT_OF_MEMORY          4
-
-namespace brief
-{
-    /* The following setup() and loop() are expected to be added to the main *.ino (before Reflecta)
-       as you will find in Brief.ino. */
-
-    void setup(); // initialize everything, bind primitives, hook Reflecta
-    void loop(); // execute loop word (execute/define driven by Reflecta)
-
-    /* The following are meant for those wanting to bind their own functions into the Brief system.
-       New functions can be bound to the instruction table, they can push/pop data to interact with
-       other Brief instructions, and they may emit errors up to the PC. */
-
-    void bind(uint8_t i, void (*f)()); // add function to instruction table
-    void push(int16_t x); // push data to evaluation stack
-    int16_t pop(); // pop data from evaluation stack
-    void error(uint8_t code); // error events
-
-    /* If, for some reason, you want to manually execute Brief bytecode in memory without going
-       through the Reflecta protocol: */
-
-    void exec(int16_t address); // execute code at given address
-}
-
-#endif // BRIEF_H
+/* Brief.h
+
+   Scriptable firmware for interfacing hardware with the Microsoft Robotics for Windows libraries
+   and for running real time control loops. */
+
+#define __STDC_LIMIT_MACROS
+//#include <Arduino.h>
+//#include <Servo.h>
+#include <ReflectaFramesSerial.h>
+//#include <Wire.h>
+
+#ifndef BRIEF_H
+#define BRIEF_H
+
+#define MEM_SIZE          512  // dictionary and local/args space
+#define DATA_STACK_SIZE   4    // evaluation stack elements (cells)
+#define RETURN_STACK_SIZE 4    // return and locals stack elements (cells)
+
+#define MAX_PRIMITIVES    128  // max number of primitive (7-bit) instructions
+#define MAX_INTERRUPTS    6    // max number of ISR words
+#define MAX_VERIFIED      16   // max number of verified definitions (BRIEF_VERIFIED)
+#define JIT_THRESHOLD     2    // calls before compiling a definition (BRIEF_JIT; 1 is upon first)
+#define PROFILE_WORDS     8    // max number of definitions timed (BRIEF_PROFILE)
+#define TRACE_SIZE        128  // trace ring records (BRIEF_TRACE; 6 bytes each)
+#define MAX_TASKS         4    // max number of cooperative tasks (BRIEF_TASKS)
+#define MAX_PERIODIC      4    // max number of periodic words (BRIEF_PERIODIC)
+#define SLICE_FUEL        256  // instructions run per slice by loop() (BRIEF_SLICED)
+#define ISR_QUEUE_SIZE    8    // interrupts queued for loop() (BRIEF_DEFERRED; a power of two)
+#define BATCH_SIZE        64   // bytes of events coalesced into one frame (BRIEF_COALESCED; up to 255)
+#define BATCH_WINDOW      0    // milliseconds events may wait to be sent (BRIEF_COALESCED; 0 for each loop())
+#define DELTA_CHANNELS    8    // channels of delta-coded samples (BRIEF_DELTAS)
+#define KEYFRAME_INTERVAL 32   // samples per channel between keyframes (BRIEF_DELTAS; up to 255)
+#define SNAPSHOT_ADDRESS  0    // EEPROM offset of the dictionary image (BRIEF_SNAPSHOT)
+#define ROM_BASE          0x4000 // address of the library built into flash (BRIEF_ROM; above MEM_SIZE)
+#define PAGED_BASE        0x0800 // address of the paged dictionary (BRIEF_PAGED; above MEM_SIZE)
+#define PAGED_LIMIT       0x8000 // and just past it (BRIEF_PAGED; up to ROM_BASE with BRIEF_ROM)
+#define PAGE_SIZE         32     // bytes per page (BRIEF_PAGED; a power of two)
+#define RESIDENT_PAGES    4      // pages held in RAM (BRIEF_PAGED)
+#define PREFETCH_QUEUE    4      // calls into pages not resident, awaiting prefetch by loop() (BRIEF_PAGED; a power of two)
+//#define MAX_SERVOS        48   // max number of servos
+
+//#define BRIEF_CELL32           // 32-bit stack cells (16-bit otherwise)
+
+//#define BRIEF_THREADED         // threaded (computed goto) interpreter core; GCC only
+//#define BRIEF_VERIFIED         // verify definitions upon arrival and run them unchecked when safe
+//#define BRIEF_FUSED            // fuse common pairs in definitions (binds instructions 66-76)
+//#define BRIEF_PAIRS            // count adjacent instruction pairs run (plain core; host profiling)
+//#define BRIEF_JIT              // compile hot definitions to x86-64 (host build; see host/BriefJit.cpp)
+//#define BRIEF_AOT              // run words translated to C++ ahead of time (link host/aot.cpp output)
+//#define BRIEF_THREADS          // machines selected per thread (host build; see host/Farm.h)
+//#define BRIEF_PROFILE          // count instructions and calls, time definitions (plain core; see 'profile')
+//#define BRIEF_TRACE            // record instructions, inputs and frames for replay (plain core; see 'trace')
+//#define BRIEF_TASKS            // cooperative tasks with stacks of their own, run by loop() (see 'spawn')
+//#define BRIEF_PERIODIC         // words run by loop() at fixed rates, by priority (see 'every')
+//#define BRIEF_SLICED           // code from the PC and the loop word run by loop() in slices (see slice())
+//#define BRIEF_DEFERRED         // ISRs queue interrupts, their words run by loop() (see 'isrEvent')
+//#define BRIEF_COALESCED        // events sent up together, a frame per loop() (see flushEvents())
+//#define BRIEF_DELTAS           // samples sent as zigzag varint deltas, with keyframes (see 'eventDelta')
+//#define BRIEF_SNAPSHOT         // dictionary image saved to EEPROM, restored upon setup (see 'snapshot')
+//#define BRIEF_ROM              // library words run in place from flash at ROM_BASE (plain core; see mem())
+//#define BRIEF_PAGED            // dictionary paged in from external storage at PAGED_BASE (plain core; see 'paging')
+//#define BRIEF_COMPACT          // words taken out of the midst of the dictionary, the rest relocated (plain core; see 'compact')
+
+#if defined(BRIEF_TASKS) || defined(BRIEF_SLICED)
+#define BRIEF_FUEL             // run() counting down instructions (see run(fuel) below)
+#endif
+
+#define BOOT_EVENT_ID     0xFF // event sent upon 'setup' (not reset)
+#define VM_EVENT_ID       0xFC // event sent upon VM error
+#define PROFILE_EVENT_ID  0xFB // events sent by 'profile' (BRIEF_PROFILE)
+#define TRACE_EVENT_ID    0xFA // events sent by 'trace' (BRIEF_TRACE)
+#define TASK_EVENT_ID     0xF9 // event sent by 'tasks' (BRIEF_TASKS)
+#define TIMING_EVENT_ID   0xF8 // event sent by 'timing' (BRIEF_PERIODIC)
+#define ISR_EVENT_ID      0xF7 // event sent upon interrupts lost (BRIEF_DEFERRED)
+#define BATCH_EVENT_ID    0xF6 // events coalesced into one frame (BRIEF_COALESCED)
+#define PAGING_EVENT_ID   0xF5 // event sent by 'paging' (BRIEF_PAGED)
+
+#define VM_ERROR_RETURN_STACK_UNDERFLOW 0
+#define VM_ERROR_RETURN_STACK_OVERFLOW  1
+#define VM_ERROR_DATA_STACK_UNDERFLOW   2
+#define VM_ERROR_DATA_STACK_OVERFLOW    3
+#define VM_ERROR_OUT_OF_MEMORY          4
+
+namespace brief
+{
+    /* The state of a Brief VM; dictionary, stacks and registers. Sizes are template parameters so
+       that every bounds check compares against a constant, and so that a board can be given just
+       what it needs. Cells are the stack items (int16_t or int32_t); values in the dictionary
+       (lit16, fetch16/store16, locals, events) are 16-bit either way.
+
+       Brief.cpp implements the VM for Machine (below), sized by MEM_SIZE, DATA_STACK_SIZE,
+       RETURN_STACK_SIZE and BRIEF_CELL32. Any number of Machines may exist, each independent of the
+       others; the instructions act upon the one selected. */
+
+    template <typename CellType> struct Unsigned; // cell of the same width, unsigned (bounds checks)
+    template <> struct Unsigned<int16_t> { typedef uint16_t Type; };
+    template <> struct Unsigned<int32_t> { typedef uint32_t Type; };
+
+    template <int16_t MemSize, uint8_t DataStackSize, uint8_t ReturnStackSize, typename CellType>
+    struct VM
+    {
+        typedef CellType Cell;
+        typedef typename Unsigned<CellType>::Type UCell;
+        enum { MEMORY = MemSize, DATA_STACK = DataStackSize, RETURN_STACK = ReturnStackSize };
+
+        uint8_t memory[MemSize]; // dictionary (and local/arg space for IL semantics)
+        Cell dstackCells[DataStackSize + 1]; // eval stack plus a spare cell below the bottom
+        Cell rstack[ReturnStackSize]; // return stack (and locals in Brief)
+        Cell* s; // data stack pointer (resting on the spare cell when empty)
+        Cell* r; // return stack pointer
+        int16_t p; // program counter (VM instruction pointer)
+        int16_t here; // dictionary 'here' pointer
+        int16_t last; // last definition address
+        int16_t locals; // local allocation pointer
+        int16_t eventBuffer; // index into event buffer (reusing dictionary)
+        int16_t loopword; // address of loop word
+        int16_t loopIterations; // number of iterations since 'setup'
+        int16_t isrs[MAX_INTERRUPTS]; // ISR words
+#ifdef BRIEF_PAGED
+        int16_t paged; // paged dictionary 'here' (definitions sent to be paged go there)
+#endif
+#ifdef BRIEF_SNAPSHOT
+        uint8_t isrModes[MAX_INTERRUPTS]; // mode each was attached with (saved by 'snapshot')
+#endif
+        void (*sendEvent)(uint8_t* event, uint16_t length); // events up to the PC (through Reflecta if 0)
+#ifdef BRIEF_DEFERRED
+        volatile uint8_t isrIds[ISR_QUEUE_SIZE]; // interrupts queued by ISRs (see 'isrEvent' in Brief.cpp)
+        volatile uint8_t isrValues[ISR_QUEUE_SIZE]; // pin sampled by each
+        volatile uint32_t isrTimes[ISR_QUEUE_SIZE]; // micros() upon each
+        volatile uint8_t isrHead, isrTail; // next written (by ISRs only) and read (by loop() only)
+        volatile uint8_t isrLost[MAX_INTERRUPTS]; // interrupts dropped with the queue full (by ISRs)
+        uint8_t isrReported[MAX_INTERRUPTS]; // those of them sent up so far
+        int8_t isrPins[MAX_INTERRUPTS]; // pin sampled upon each interrupt (-1 if none)
+        uint8_t isrValue; // interrupt being handled
+        uint32_t isrTime;
+#endif
+#ifdef BRIEF_COALESCED
+        uint8_t batch[BATCH_SIZE]; // events to be sent up together (see flushEvents() in Brief.cpp)
+        uint8_t batched; // bytes of it (0 if none)
+        uint32_t batchStart; // millis() upon the first
+#endif
+#ifdef BRIEF_DELTAS
+        int16_t deltaPrevious[DELTA_CHANNELS]; // value last sent on each channel (see 'eventDelta' in Brief.cpp)
+        uint8_t deltaSince[DELTA_CHANNELS]; // samples since its last keyframe (KEYFRAME_INTERVAL for one next)
+#endif
+#ifdef BRIEF_TASKS
+        struct Task // cooperative task (see 'spawn' in Brief.cpp); stacks and registers while not running
+        {
+            int16_t word; // address run (again upon returning; -1 if free)
+            int16_t budget; // instructions per slice (0 for until yielding)
+            int16_t p; // where it left off (-1 to start the word afresh)
+            int16_t iterations; // times the word has returned (loopTicks within the task)
+            uint8_t depth, rdepth; // items on its stacks
+            Cell dstackCells[DataStackSize + 1];
+            Cell rstack[ReturnStackSize];
+        };
+        Task tasks[MAX_TASKS];
+        int8_t task; // running (-1 if none)
+#endif
+#ifdef BRIEF_FUEL
+        int16_t fuel; // instructions left in the running slice (-1 unlimited, 0 once yielded)
+#endif
+#ifdef BRIEF_SLICED
+        int16_t held; // bytes at 'here' of code left part way (0 for the loop word, -1 if nothing is)
+        int16_t queue, queued; // frames received meanwhile; length (2 bytes) then the frame, each in turn
+#endif
+#ifdef BRIEF_PERIODIC
+        struct Periodic // word run at a fixed rate (see 'every' in Brief.cpp)
+        {
+            int16_t word; // address run (-1 if free)
+            int16_t period; // milliseconds
+            int8_t priority; // lower first among those due
+            uint32_t release; // micros() it's next due
+            uint16_t runs, overruns; // releases run and those missed altogether
+            uint16_t jitter, time; // worst lateness and run time (microseconds)
+            uint32_t lateness; // total lateness (microseconds; mean is lateness / runs)
+        };
+        Periodic periodic[MAX_PERIODIC];
+        uint32_t due; // soonest release of any
+#endif
+
+        VM() : s(dstackCells), r(rstack - 1), p(0), here(0), last(0), locals(MemSize),
+               eventBuffer(MemSize), loopword(-1), loopIterations(0), sendEvent(0)
+        {
+            for (uint8_t i = 0; i < MAX_INTERRUPTS; i++) isrs[i] = -1;
+#ifdef BRIEF_PAGED
+            paged = PAGED_BASE;
+#endif
+#ifdef BRIEF_SNAPSHOT
+            for (uint8_t i = 0; i < MAX_INTERRUPTS; i++) isrModes[i] = 0;
+#endif
+#ifdef BRIEF_DEFERRED
+            for (uint8_t i = 0; i < MAX_INTERRUPTS; i++)
+            {
+                isrLost[i] = isrReported[i] = 0;
+                isrPins[i] = -1;
+            }
+            isrHead = isrTail = 0;
+            isrValue = 0;
+            isrTime = 0;
+#endif
+#ifdef BRIEF_COALESCED
+            batched = 0;
+            batchStart = 0;
+#endif
+#ifdef BRIEF_DELTAS
+            for (uint8_t i = 0; i < DELTA_CHANNELS; i++)
+            {
+                deltaPrevious[i] = 0;
+                deltaSince[i] = KEYFRAME_INTERVAL;
+            }
+#endif
+#ifdef BRIEF_TASKS
+            for (uint8_t i = 0; i < MAX_TASKS; i++) tasks[i].word = -1;
+            task = -1;
+#endif
+#ifdef BRIEF_FUEL
+            fuel = -1;
+#endif
+#ifdef BRIEF_SLICED
+            held = -1;
+            queue = queued = 0;
+#endif
+#ifdef BRIEF_PERIODIC
+            for (uint8_t i = 0; i < MAX_PERIODIC; i++) periodic[i].word = -1;
+            due = 0;
+#endif
+        }
+
+        Cell* dstack() { return dstackCells + 1; } // bottom of the data stack
+
+        static bool inMemory(Cell address) { return (UCell)address < (UCell)MemSize; }
+        bool canPush() const { return s < dstackCells + DataStackSize; }
+        bool canPop() const { return s > dstackCells; }
+        bool canRpush() const { return r < rstack + ReturnStackSize - 1; }
+        bool canRpop() const { return r >= rstack; }
+    };
+
+#ifdef BRIEF_CELL32
+    typedef VM<MEM_SIZE, DATA_STACK_SIZE, RETURN_STACK_SIZE, int32_t> Machine;
+#else
+    typedef VM<MEM_SIZE, DATA_STACK_SIZE, RETURN_STACK_SIZE, int16_t> Machine;
+#endif
+
+    typedef Machine::Cell Cell;
+    typedef Machine::UCell UCell;
+
+    extern Machine primary; // set up by setup() (the JIT, AOT and verifier serve this one only)
+#ifdef BRIEF_THREADS
+    extern thread_local Machine* vm; // selected by the calling thread (instructions act upon this one)
+#else
+    extern Machine* vm; // selected (instructions act upon this one)
+#endif
+    void select(Machine& machine); // act upon another machine from now on
+
+    /* The following setup() and loop() are expected to be added to the main *.ino (before Reflecta)
+       as you will find in Brief.ino. */
+
+    void setup(); // initialize everything, bind primitives, hook Reflecta
+    void loop(); // execute loop word (execute/define driven by Reflecta)
+
+    /* The following are meant for those wanting to bind their own functions into the Brief system.
+       New functions can be bound to the instruction table, they can push/pop data to interact with
+       other Brief instructions, and they may emit errors up to the PC. */
+
+    void bind(uint8_t i, void (*f)()); // add function to instruction table
+    void push(Cell x); // push data to evaluation stack
+    Cell pop(); // pop data from evaluation stack
+    void error(uint8_t code); // error events
+
+    /* If, for some reason, you want to manually execute Brief bytecode in memory without going
+       through the Reflecta protocol: */
+
+    void exec(int16_t address); // execute code at given address
+
+    /* Or, finer grained, for those driving machines themselves (see host/Batch.h); with p and the
+       stacks set up as exec would (-1 at the bottom of the return stack): */
+
+    void run(); // carry on from p until returning to -1
+    void step(); // execute just the one instruction (or call) at p
+#ifdef BRIEF_FUEL
+    bool run(int16_t fuel); // as run(), for at most fuel instructions (-1 for no limit); false if left part way
+                            // (p and the stacks as they were left; run again to carry on)
+#endif
+
+#ifdef BRIEF_AOT
+    /* Words translated ahead of time by host/aot.cpp. The generated source defines these; the image
+       is loaded into the dictionary upon setup. Compiled words call callWord() for words they don't
+       know statically (interpreting them if there's nothing compiled). */
+
+    struct Compiled
+    {
+        int16_t address; // entry point
+        int16_t low, high; // bytes translated [low, high)
+        void (*word)(); // compiled function
+        bool stale; // bytes changed since (see staleCompiled)
+    };
+
+    extern const uint8_t image[]; // dictionary image (PROGMEM)
+    extern const int16_t imageSize;
+    extern Compiled compiled[]; // sorted by address
+    extern const uint8_t compiledCount;
+
+    void callWord(int16_t address); // call word from compiled code, returning once it has
+#endif
+
+#ifdef BRIEF_ROM
+    /* Library words built into the firmware, run in place from flash rather than uploaded into the
+       dictionary. The hosting project defines these; the library as the PC assembled it to live at
+       ROM_BASE (Compiler.Rom; see host/rom.cpp). Its words call those in the dictionary, and are called by them,
+       just as any other. */
+
+    extern const uint8_t rom[]; // library image (PROGMEM), addresses ROM_BASE up
+    extern const int16_t romSize;
+#endif
+
+#ifdef BRIEF_PAGED
+    /* Storage behind the paged dictionary (see 'paging' in Brief.cpp); SPI flash or an SD card on the
+       board, a file on the host. The hosting project defines these two, moving a page (PAGE_SIZE
+       bytes, page 0 at PAGED_BASE) at a time. */
+
+    void pageRead(uint16_t page, uint8_t* bytes);
+    void pageWrite(uint16_t page, const uint8_t* bytes);
+
+    void pageFlush(); // write back resident pages stored into (before power goes, say)
+
+    extern uint32_t pageHits, pageMisses; // fetches and stores finding their page resident, or not
+    extern uint32_t pagePrefetches, pagePrefetchesUsed; // pages brought in ahead by loop(), and those used since
+    extern uint32_t pageWrites; // pages written back
+    extern bool pagePrefetching; // bringing pages in ahead between passes (by default; off to compare)
+#endif
+
+#ifdef BRIEF_TRACE
+    /* Execution traces (see Brief.cpp), as sent up by 'trace' oldest first, replay upon a machine
+       holding the dictionary (and 'here', etc.) sent up along with them; see host/replay.cpp. */
+
+    enum TraceKind { TRACE_STEP, TRACE_EXEC, TRACE_STATE, TRACE_CELL, TRACE_INPUT, TRACE_STORE, TRACE_FRAME,
+                     TRACE_BYTES, TRACE_ERROR };
+
+    struct TraceRecord
+    {
+        uint8_t kind; // TraceKind
+        uint8_t op;
+        int16_t a, b;
+    };
+
+    uint16_t replay(const TraceRecord* records, uint16_t count); // upon the selected machine; the record it went astray at (count if none)
+#endif
+
+#if FRAMES_TX_RING > 0
+    /* Events (frames of them, batches counting once) refused by Reflecta for want of room in its
+       TX ring; lost telemetry (see reflectaFrames::txRefused). Those sent through vm->sendEvent
+       aren't counted. */
+
+    extern uint16_t eventsRefused;
+#endif
+
+#ifdef BRIEF_BENCH
+    /* Host benchmarking (see host/bench.cpp) counts every instruction and call dispatched. */
+
+    extern uint32_t dispatches;
+#endif
+
+#ifdef BRIEF_PAIRS
+    /* Profiling counts of each pair of adjacent instructions run one after the other; candidates
+       for fusing (see BRIEF_FUSED). Far too big for a board (64Kb); meant for the host build. */
+
+    extern uint32_t pairs[MAX_PRIMITIVES][MAX_PRIMITIVES];
+#endif
+}
+
+#endif // BRIEF_H
@@ -1,267 +1,564 @@
-/*
-ReflectaFramesSerial.cpp - Library for sending frames of information from a Microcontroller to a PC over a serial port.
-*/
-
-#include "ReflectaFramesSerial.h"
-
-// SLIP (http://www.ietf.org/rfc/rfc1055.txt) protocol special character definitions
-// Used to find end of frame when using a streaming communications protocol
-#define END            0xC0
-#define ESCAPE         0xDB
-#define ESCAPED_END    0xDC
-#define ESCAPED_ESCAPE 0xDD
-
-// State machine for incoming data.  Packet format is:
-// Frame Sequence #, SLIP escaped
-// Byte(s) of Payload, SLIP escaped
-// CRC8 of Sequence # & Payload bytes, SLIP escaped
-// SLIP END (0xc0)
-#define WAITING_FOR_SEQUENCE 0 // Beginning of a new frame, waiting for the Sequence number
-#define WAITING_FOR_BYTECODE 1 // Reading data until an END character is found
-#define PROCESS_PAYLOAD      2 // END character found, check CRC and deliver frame
-#define WAITING_FOR_RECOVERY 3 // Current frame is invalid, wait for an END character and start parsing again
-
-namespace reflectaFrames
-{
-  // Checksum for the incoming frame, calculated byte by byte using XOR.  Compared against the checksum byte
-  // which is stored in the last byte of the frame.
-  byte readChecksum = 0;
-  
-  // Checksum for the outgoing frame, calculated byte by byte using XOR.  Added to the payload as the last byte of the frame. 
-  byte writeChecksum = 0;
-  
-  // Sequence number of the incoming frames.  Compared against the sequence number at the beginning of the incoming frame
-  //  to detect out of sequence frames which would point towards lost data or corrupted data.
-  byte readSequence = 0;
-  
-  // Sequence number of the outgoing frames.
-  byte writeSequence = 0;
-  
-  // protocol parser escape state -- set when the ESC character is detected so the next character will be de-escaped
-  int escaped = 0;
-  
-  // protocol parser state
-  int state = WAITING_FOR_SEQUENCE;
-  
-  frameBufferAllocationFunction frameBufferAllocationCallback = NULL;
-  frameReceivedFunction frameReceivedCallback = NULL;
-  
-  void setFrameReceivedCallback(frameReceivedFunction frameReceived)
-  {
-    frameReceivedCallback = frameReceived;
-  }
-  
-  void setBufferAllocationCallback(frameBufferAllocationFunction frameBufferAllocation)
-  {
-    frameBufferAllocationCallback = frameBufferAllocation;
-  }
-  
-  void writeEscaped(byte b)
-  {
-    switch(b)
-    {
-      case END:
-        Serial.write(ESCAPE);
-        Serial.write(ESCAPED_END);
-        break;
-      case ESCAPE:
-        Serial.write(ESCAPE);
-        Serial.write(ESCAPED_ESCAPE);
-        break;
-      default:
-        Serial.write(b);
-        break;
-    }
-    writeChecksum ^= b;
-  }
-  
-  byte sendFrame(byte* frame, byte frameLength)
-  {
-    writeChecksum = 0;
-    writeEscaped(writeSequence);
-    for (byte frameIndex = 0; frameIndex < frameLength; frameIndex++)
-    {
-      writeEscaped(frame[frameIndex]);
-    }
-    writeEscaped(writeChecksum);
-    Serial.write(END);
-    
-    return writeSequence++;
-  }
-  
-  // Send a two byte frame notifying caller that something improper occured in the communications protocol
-  void sendError(byte eventId)
-  {
-    byte buffer[2];
-    buffer[0] = FRAMES_ERROR;
-    buffer[1] = eventId;
-    sendFrame(buffer, 2);
-  }
-  
-  void sendMessage(String message)
-  {
-    byte bufferLength = message.length() + 3;
-    byte buffer[bufferLength];
-    
-    buffer[0] = FRAMES_MESSAGE;
-    buffer[1] = message.length();
-    message.getBytes(buffer + 2, bufferLength - 2);
-    
-    // Strip off the trailing '\0' that Arduino String.getBytes insists on postpending
-    sendFrame(buffer, bufferLength - 1);
-  }
-  
-  int readUnescaped(byte &b)
-  {
-    b = Serial.read();
-    
-    if (escaped)
-    {
-      switch (b)
-      {
-        case ESCAPED_END:
-          b = END;
-          break;
-        case ESCAPED_ESCAPE:
-          b = ESCAPE;
-          break;
-        default:
-          sendError(FRAMES_ERROR_UNEXPECTED_ESCAPE);
-          state = WAITING_FOR_RECOVERY;
-          break;
-      }
-      escaped = 0;
-      readChecksum ^= b;
-    }
-    else
-    {
-      if (b == ESCAPE)
-      {
-        escaped = 1;
-        return 0; // read escaped value on next pass
-      }
-      if (b == END)
-      {
-        switch (state)
-        {
-          case WAITING_FOR_RECOVERY:
-            readChecksum = 0;
-            state = WAITING_FOR_SEQUENCE;
-            break;
-          case WAITING_FOR_BYTECODE:
-            state = PROCESS_PAYLOAD;
-            break;
-          default:
-            sendError(FRAMES_ERROR_UNEXPECTED_END);
-            state = WAITING_FOR_RECOVERY;
-            break;
-        }
-      }
-      else
-      {
-        readChecksum ^= b;
-      }
-    }
-    
-    return 1;
-  }
-  
-  const byte frameBufferSourceLength = 64;
-  byte* frameBufferSource = NULL;
-  
-  // Default frame buffer allocator for when caller does not set one.
-  byte frameBufferAllocation(byte** frameBuffer)
-  {
-    *frameBuffer = frameBufferSource;
-    return frameBufferSourceLength;
-  }
-  
-  // Reset the communications protocol
-  void reset()
-  {
-    readSequence = 0;
-    writeSequence = 0;
-    Serial.flush();
-  }
-  
-  // Configure the communications protocol and open the serial port, to be called inside Arduino setup()
-  void setup(int speed)
-  {
-    if (frameBufferAllocationCallback == NULL)
-    {
-      frameBufferSource = (byte*)malloc(frameBufferSourceLength);
-      frameBufferAllocationCallback = frameBufferAllocation;
-    }
-    
-    Serial.begin(speed);
-    Serial.flush();
-  }
-  
-  byte* frameBuffer;
-  byte frameBufferLength;
-  byte frameIndex = 0;
-
-  byte sequence;
-
-  // Millisecond counter for last time a frame was received.  Can be used to implement a 'deadman switch' when
-  // communications with a host PC are lost or interrupted.
-  uint32_t lastFrameReceived;
-  
-  // Read the uncoming data stream, to be called inside Arduino loop()
-  void loop()
-  {
-    byte b;
-    
-    while (Serial.available())
-    {
-      if (readUnescaped(b))
-      {
-        switch (state)
-        {
-          case WAITING_FOR_RECOVERY:
-            break;
-          case WAITING_FOR_SEQUENCE:
-            sequence = b;
-            if (++readSequence != sequence)
-            {
-              readSequence = sequence;
-              sendError(FRAMES_WARNING_OUT_OF_SEQUENCE);
-            }
-            frameBufferLength = frameBufferAllocationCallback(&frameBuffer);
-            frameIndex = 0; // Reset the buffer pointer to beginning
-            state = WAITING_FOR_BYTECODE;
-            break;
-          case WAITING_FOR_BYTECODE:
-            if (frameIndex == frameBufferLength)
-            {
-              sendError(FRAMES_ERROR_BUFFER_OVERFLOW);
-              state = WAITING_FOR_RECOVERY;
-              readChecksum = 0;
-            }
-            else
-            {
-              frameBuffer[frameIndex++] = b;
-            }
-            break;
-          case PROCESS_PAYLOAD:
-            lastFrameReceived = millis();
-            if (readChecksum == 0) // zero expected because finally XOR'd with itself
-            {
-              if (frameReceivedCallback != NULL)
-              {
-                frameReceivedCallback(readSequence, frameIndex - 1, frameBuffer);
-              }
-            }
-            else
-            {
-              sendError(FRAMES_ERROR_CRC_MISMATCH);
-              state = WAITING_FOR_RECOVERY;
-              readChecksum = 0;
-            }
-            state = WAITING_FOR_SEQUENCE;
-            break;
-        }
-      }
-    }
-  }
+/*
+ReflectaFramesSerial.cpp - Library for sending frames of information from a Microcontroller to a PC over a serial port.
+*/
+
+#include <string.h>
+#include "ReflectaFramesSerial.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// SLIP (http://www.ietf.org/rfc/rfc1055.txt) protocol special character definitions
+// Used to find end of frame when using a streaming communications protocol
+#define END            0xC0
+#define ESCAPE         0xDB
+#define ESCAPED_END    0xDC
+#define ESCAPED_ESCAPE 0xDD
+
+// State machine for incoming data.  Packet format is:
+// Frame Sequence #, SLIP escaped
+// Byte(s) of Payload, SLIP escaped
+// CRC8 of Sequence # & Payload bytes, SLIP escaped
+// SLIP END (0xc0)
+#define WAITING_FOR_SEQUENCE 0 // Beginning of a new frame, waiting for the Sequence number
+#define WAITING_FOR_BYTECODE 1 // Reading data until an END character is found
+#define PROCESS_PAYLOAD      2 // END character found, check CRC and deliver frame
+#define WAITING_FOR_RECOVERY 3 // Current frame is invalid, wait for an END character and start parsing again
+
+namespace reflectaFrames
+{
+  // Checksum for the incoming frame, calculated byte by byte using XOR.  Compared against the checksum byte
+  // which is stored in the last byte of the frame.
+  byte readChecksum = 0;
+  
+  // Checksum for the outgoing frame, calculated byte by byte using XOR.  Added to the payload as the last byte of the frame. 
+  byte writeChecksum = 0;
+  
+  // Sequence number of the incoming frames.  Compared against the sequence number at the beginning of the incoming frame
+  //  to detect out of sequence frames which would point towards lost data or corrupted data.
+  byte readSequence = 0;
+  
+  // Sequence number of the outgoing frames.
+  byte writeSequence = 0;
+  
+  // protocol parser escape state -- set when the ESC character is detected so the next character will be de-escaped
+  int escaped = 0;
+  
+  // protocol parser state
+  int state = WAITING_FOR_SEQUENCE;
+  
+#ifdef FRAMES_RELIABLE
+  // Frames taken since last acknowledged; frames being dropped (out of sequence) since the last taken, and
+  // whether acknowledged since; when last acknowledged (millis)
+  bool ackDue = false;
+  bool dropping = false;
+  bool dropAcked = false;
+  uint32_t lastAck = 0;
+#endif
+  
+  frameBufferAllocationFunction frameBufferAllocationCallback = NULL;
+  frameReceivedFunction frameReceivedCallback = NULL;
+  
+  void setFrameReceivedCallback(frameReceivedFunction frameReceived)
+  {
+    frameReceivedCallback = frameReceived;
+  }
+  
+  void setBufferAllocationCallback(frameBufferAllocationFunction frameBufferAllocation)
+  {
+    frameBufferAllocationCallback = frameBufferAllocation;
+  }
+  
+#if FRAMES_TX_RING > 0
+  // Outgoing frames, SLIP escaped, waiting to be written out to the serial port.  Only ever whole frames are
+  // queued, each ending with END (which appears nowhere else once escaped).
+  byte txRing[FRAMES_TX_RING];
+  uint16_t txHead = 0; // where the next byte is queued
+  uint16_t txTail = 0; // next byte to be written out
+  uint16_t txCount = 0; // bytes queued
+  bool txBegun = false; // the frame at txTail is partly written out already
+  bool txDirect = false; // frame too large for the ring being written out at once
+  
+  uint16_t txHighWater = 0;
+  uint16_t txDropped = 0;
+  bool txRefused = false;
+  bool txOverflowed = false; // FRAMES_ERROR_TX_OVERFLOW yet to be sent
+  
+  uint16_t txNext(uint16_t i)
+  {
+    return i + 1 == FRAMES_TX_RING ? 0 : i + 1;
+  }
+  
+  uint16_t txPrevious(uint16_t i)
+  {
+    return i == 0 ? FRAMES_TX_RING - 1 : i - 1;
+  }
+  
+  // Write out as much as the serial port will take without waiting
+  void writeQueued()
+  {
+    while (txCount > 0)
+    {
+      int room = Serial.availableForWrite();
+      if (room <= 0) break;
+      uint16_t n = FRAMES_TX_RING - txTail; // contiguous
+      if (n > txCount) n = txCount;
+      if (n > (uint16_t)room) n = room;
+      Serial.write(txRing + txTail, n);
+      txBegun = txRing[txTail + n - 1] != END;
+      txTail = txTail + n == FRAMES_TX_RING ? 0 : txTail + n;
+      txCount -= n;
+    }
+  }
+  
+#ifdef FRAMES_TX_DROP_OLDEST
+  // Drop the frame queued longest, other than one partly written out already; false if there is none
+  bool dropOldest()
+  {
+    uint16_t start = txTail, kept = 0;
+    if (txBegun) // keep the rest of it
+    {
+      while (txRing[start] != END)
+      {
+        start = txNext(start);
+        kept++;
+      }
+      start = txNext(start);
+      kept++;
+    }
+    if (kept == txCount) return false;
+    uint16_t end = start, dropped = 1;
+    while (txRing[end] != END)
+    {
+      end = txNext(end);
+      dropped++;
+    }
+    end = txNext(end);
+    for (uint16_t k = 0; k < kept; k++) // (the rest of the frame begun moved up against the frame after)
+    {
+      start = txPrevious(start);
+      end = txPrevious(end);
+      txRing[end] = txRing[start];
+    }
+    txTail = end;
+    txCount -= dropped;
+    txDropped++;
+    return true;
+  }
+#endif
+  
+  uint16_t escapedLength(byte b)
+  {
+    return b == END || b == ESCAPE ? 2 : 1;
+  }
+  
+  // Make room for a frame of this many bytes (escaped) in the ring; false if there's none to be had
+  bool makeRoom(uint16_t length)
+  {
+    writeQueued();
+#ifdef FRAMES_TX_DROP_OLDEST
+    while (FRAMES_TX_RING - txCount < length && dropOldest()) ;
+#endif
+    return FRAMES_TX_RING - txCount >= length;
+  }
+#endif
+  
+  void writeByte(byte b)
+  {
+#if FRAMES_TX_RING > 0
+    if (txDirect)
+    {
+      Serial.write(b);
+      return;
+    }
+    txRing[txHead] = b;
+    txHead = txNext(txHead);
+    txCount++;
+#else
+    Serial.write(b);
+#endif
+  }
+  
+  void writeEscaped(byte b)
+  {
+    switch(b)
+    {
+      case END:
+        writeByte(ESCAPE);
+        writeByte(ESCAPED_END);
+        break;
+      case ESCAPE:
+        writeByte(ESCAPE);
+        writeByte(ESCAPED_ESCAPE);
+        break;
+      default:
+        writeByte(b);
+        break;
+    }
+    writeChecksum ^= b;
+  }
+  
+  byte sendFrame(byte* frame, uint16_t frameLength)
+  {
+#if FRAMES_TX_RING > 0
+    byte checksum = writeSequence;
+    uint32_t length = escapedLength(writeSequence) + 1; // (and END; escaped, a long frame may pass 65535)
+    for (uint16_t frameIndex = 0; frameIndex < frameLength; frameIndex++)
+    {
+      length += escapedLength(frame[frameIndex]);
+      checksum ^= frame[frameIndex];
+    }
+    length += escapedLength(checksum);
+    if (length > FRAMES_TX_RING) // never to fit; written out at once, after those queued, as without the ring
+    {
+      while (txCount > 0)
+      {
+        Serial.write(txRing[txTail]);
+        txTail = txNext(txTail);
+        txCount--;
+      }
+      txBegun = false;
+      txDirect = true;
+    }
+    else if (!makeRoom(length))
+    {
+      txDropped++;
+      txRefused = txOverflowed = true;
+      return writeSequence++; // (the PC seeing the gap)
+    }
+    txRefused = false;
+#endif
+    writeChecksum = 0;
+    writeEscaped(writeSequence);
+    for (uint16_t frameIndex = 0; frameIndex < frameLength; frameIndex++)
+    {
+      writeEscaped(frame[frameIndex]);
+    }
+    writeEscaped(writeChecksum);
+    writeByte(END);
+#if FRAMES_TX_RING > 0
+    txDirect = false;
+    if (txCount > txHighWater) txHighWater = txCount;
+    writeQueued();
+#endif
+    
+    return writeSequence++;
+  }
+  
+  // Send a two byte frame notifying caller that something improper occured in the communications protocol
+  void sendError(byte eventId)
+  {
+    byte buffer[2];
+    buffer[0] = FRAMES_ERROR;
+    buffer[1] = eventId;
+    sendFrame(buffer, 2);
+  }
+  
+  void sendMessage(String message)
+  {
+    byte bufferLength = message.length() + 3;
+    byte buffer[bufferLength];
+    
+    buffer[0] = FRAMES_MESSAGE;
+    buffer[1] = message.length();
+    message.getBytes(buffer + 2, bufferLength - 2);
+    
+    // Strip off the trailing '\0' that Arduino String.getBytes insists on postpending
+    sendFrame(buffer, bufferLength - 1);
+  }
+  
+#ifdef FRAMES_RELIABLE
+  // Acknowledge frames taken up to (and including) readSequence
+  void sendAck()
+  {
+    byte buffer[3];
+    buffer[0] = FRAMES_ACK;
+    buffer[1] = readSequence;
+    buffer[2] = FRAMES_WINDOW;
+    sendFrame(buffer, 3);
+    ackDue = false;
+    lastAck = millis();
+  }
+#endif
+  
+  int readUnescaped(byte &b)
+  {
+    if (escaped)
+    {
+      switch (b)
+      {
+        case ESCAPED_END:
+          b = END;
+          break;
+        case ESCAPED_ESCAPE:
+          b = ESCAPE;
+          break;
+        default:
+          sendError(FRAMES_ERROR_UNEXPECTED_ESCAPE);
+          state = WAITING_FOR_RECOVERY;
+          break;
+      }
+      escaped = 0;
+      readChecksum ^= b;
+    }
+    else
+    {
+      if (b == ESCAPE)
+      {
+        escaped = 1;
+        return 0; // read escaped value on next pass
+      }
+      if (b == END)
+      {
+        switch (state)
+        {
+          case WAITING_FOR_RECOVERY:
+            readChecksum = 0;
+            state = WAITING_FOR_SEQUENCE;
+            return 0; // (not itself the sequence number to follow)
+          case WAITING_FOR_BYTECODE:
+            state = PROCESS_PAYLOAD;
+            break;
+          default:
+            sendError(FRAMES_ERROR_UNEXPECTED_END);
+            state = WAITING_FOR_RECOVERY;
+            break;
+        }
+      }
+      else
+      {
+        readChecksum ^= b;
+      }
+    }
+    
+    return 1;
+  }
+  
+  const byte frameBufferSourceLength = 64;
+  byte* frameBufferSource = NULL;
+  
+  // Default frame buffer allocator for when caller does not set one.
+  uint16_t frameBufferAllocation(byte** frameBuffer)
+  {
+    *frameBuffer = frameBufferSource;
+    return frameBufferSourceLength;
+  }
+  
+  // Reset the communications protocol
+  void reset()
+  {
+    readSequence = 0;
+    writeSequence = 0;
+#ifdef FRAMES_RELIABLE
+    ackDue = dropping = dropAcked = false;
+#endif
+#if FRAMES_TX_RING > 0
+    while (txBegun && txCount > 0) // finish the frame begun (dropping those queued behind it)
+    {
+      byte b = txRing[txTail];
+      Serial.write(b);
+      txTail = txNext(txTail);
+      txCount--;
+      txBegun = b != END;
+    }
+    txHead = txTail = txCount = 0;
+    txBegun = txRefused = txOverflowed = false;
+#endif
+    Serial.flush();
+  }
+  
+  // Configure the communications protocol and open the serial port, to be called inside Arduino setup()
+  void setup(int speed)
+  {
+    if (frameBufferAllocationCallback == NULL)
+    {
+      frameBufferSource = (byte*)malloc(frameBufferSourceLength);
+      frameBufferAllocationCallback = frameBufferAllocation;
+    }
+    
+    Serial.begin(speed);
+    Serial.flush();
+  }
+  
+  byte* frameBuffer;
+  uint16_t frameBufferLength;
+  uint16_t frameIndex = 0;
+
+  byte sequence;
+
+  // Millisecond counter for last time a frame was received.  Can be used to implement a 'deadman switch' when
+  // communications with a host PC are lost or interrupted.
+  uint32_t lastFrameReceived;
+  
+  // First END or ESCAPE at or after p (else end).  Word at a time; by SIMD on hosts having it.
+  const byte* findSpecial(const byte* p, const byte* end)
+  {
+#if defined(__AVX2__)
+    const __m256i ends = _mm256_set1_epi8((char)END), escapes = _mm256_set1_epi8((char)ESCAPE);
+    for (; end - p >= 32; p += 32)
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i*)p);
+      uint32_t m = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, ends), _mm256_cmpeq_epi8(v, escapes)));
+      if (m != 0) return p + __builtin_ctz(m);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i ends16 = _mm_set1_epi8((char)END), escapes16 = _mm_set1_epi8((char)ESCAPE);
+    for (; end - p >= 16; p += 16)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)p);
+      uint32_t m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, ends16), _mm_cmpeq_epi8(v, escapes16)));
+      if (m != 0) return p + __builtin_ctz(m);
+    }
+#else
+    for (; end - p >= 4; p += 4) // (any byte of the word zero once XOR'd with END or ESCAPE in every byte)
+    {
+      uint32_t w;
+      memcpy(&w, p, 4);
+      uint32_t e = w ^ 0xC0C0C0C0UL, x = w ^ 0xDBDBDBDBUL;
+      if (((e - 0x01010101UL) & ~e & 0x80808080UL) | ((x - 0x01010101UL) & ~x & 0x80808080UL)) break;
+    }
+#endif
+    while (p < end && *p != END && *p != ESCAPE) p++;
+    return p;
+  }
+  
+  // Deal with one byte as received
+  void receive(byte b)
+  {
+    if (readUnescaped(b))
+    {
+      switch (state)
+      {
+        case WAITING_FOR_RECOVERY:
+          break;
+        case WAITING_FOR_SEQUENCE:
+          sequence = b;
+#ifdef FRAMES_RELIABLE
+          if ((byte)(readSequence + 1) != sequence) // following a gap, or sent again; dropped (see loop())
+          {
+            lastFrameReceived = millis();
+            dropping = true;
+            state = WAITING_FOR_RECOVERY;
+            break;
+          }
+#else
+          if (++readSequence != sequence)
+          {
+            readSequence = sequence;
+            sendError(FRAMES_WARNING_OUT_OF_SEQUENCE);
+          }
+#endif
+          frameBufferLength = frameBufferAllocationCallback(&frameBuffer);
+          frameIndex = 0; // Reset the buffer pointer to beginning
+          state = WAITING_FOR_BYTECODE;
+          break;
+        case WAITING_FOR_BYTECODE:
+          if (frameIndex == frameBufferLength)
+          {
+            sendError(FRAMES_ERROR_BUFFER_OVERFLOW);
+            state = WAITING_FOR_RECOVERY;
+            readChecksum = 0;
+#ifdef FRAMES_RELIABLE
+            readSequence = sequence; // taken all the same (no use sending it again)
+            ackDue = true;
+#endif
+          }
+          else
+          {
+            frameBuffer[frameIndex++] = b;
+          }
+          break;
+        case PROCESS_PAYLOAD:
+          lastFrameReceived = millis();
+          if (readChecksum == 0) // zero expected because finally XOR'd with itself
+          {
+#ifdef FRAMES_RELIABLE
+            readSequence = sequence; // taken
+            ackDue = true;
+            dropping = dropAcked = false;
+#endif
+            if (frameReceivedCallback != NULL && frameIndex > 0) // (checksum byte at least)
+            {
+              frameReceivedCallback(readSequence, frameIndex - 1, frameBuffer);
+            }
+          }
+          else
+          {
+            sendError(FRAMES_ERROR_CRC_MISMATCH);
+            state = WAITING_FOR_RECOVERY;
+            readChecksum = 0;
+          }
+          state = WAITING_FOR_SEQUENCE;
+          break;
+      }
+    }
+  }
+  
+  // Deal with a block of bytes as received.  Runs within a frame (up to the next END or ESCAPE) are copied
+  // straight into the frame buffer, or skipped while recovering; the rest go byte by byte.
+  void receive(const byte* p, const byte* end)
+  {
+    while (p < end)
+    {
+      if (!escaped && (state == WAITING_FOR_BYTECODE || state == WAITING_FOR_RECOVERY))
+      {
+        const byte* run = findSpecial(p, end);
+        if (state == WAITING_FOR_BYTECODE)
+        {
+          uint16_t room = frameBufferLength - frameIndex;
+          if (run - p > room) run = p + room; // (overflowing byte by byte below)
+          byte checksum = readChecksum;
+          byte* to = frameBuffer + frameIndex;
+          for (const byte* q = p; q < run; q++)
+          {
+            *to++ = *q;
+            checksum ^= *q;
+          }
+          readChecksum = checksum;
+          frameIndex += run - p;
+        }
+        p = run;
+        if (p == end) break;
+      }
+      receive(*p++);
+    }
+  }
+  
+  // Read the uncoming data stream, to be called inside Arduino loop()
+  void loop()
+  {
+#if FRAMES_TX_RING > 0
+    writeQueued();
+    if (txOverflowed)
+    {
+      txOverflowed = false;
+      sendError(FRAMES_ERROR_TX_OVERFLOW); // (refused again, pending again)
+    }
+#endif
+    byte block[FRAMES_RX_BLOCK];
+    int available;
+    while ((available = Serial.available()) > 0)
+    {
+      byte length = available < FRAMES_RX_BLOCK ? available : FRAMES_RX_BLOCK;
+      length = Serial.readBytes(block, length);
+      receive(block, block + length);
+    }
+#ifdef FRAMES_RELIABLE
+    if (ackDue || (dropping && !dropAcked))
+    {
+      sendAck();
+      dropAcked = dropping;
+    }
+    else if (dropping && millis() - lastFrameReceived >= FRAMES_ACK_TIMEOUT && millis() - lastAck >= FRAMES_ACK_TIMEOUT)
+    {
+      sendAck(); // (the PC may have missed it)
+    }
+#endif
+#if FRAMES_TX_RING > 0
+    writeQueued(); // (anything sent meanwhile)
+#endif
+  }
 }
\ No newline at end of file
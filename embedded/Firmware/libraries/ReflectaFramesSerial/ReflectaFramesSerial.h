@@ -1,59 +1,99 @@
-/*
-ReflectaFramesSerial.h - Library for sending frames of information from a Microcontroller to a PC over a serial port.
-*/
-
-#include <Arduino.h>
-
-#ifndef REFLECTA_FRAMES_H
-#define REFLECTA_FRAMES_H
-
-// An error occurred when parsing a data packet into the Reflecta protocol 
-#define FRAMES_MESSAGE                  0x7E
-#define FRAMES_ERROR                    0x7F
-
-// Types of parsing errors detected by Reflecta Frames
-#define FRAMES_WARNING_OUT_OF_SEQUENCE  0x00
-#define FRAMES_ERROR_UNEXPECTED_ESCAPE  0x01
-#define FRAMES_ERROR_CRC_MISMATCH       0x02
-#define FRAMES_ERROR_UNEXPECTED_END     0x03
-#define FRAMES_ERROR_BUFFER_OVERFLOW    0x04
-
-namespace reflectaFrames
-{
-  // Function definition for Frame Buffer Allocation function, to be optionally implemented by
-  // the calling library or application.
-  typedef byte (*frameBufferAllocationFunction)(byte** frameBuffer);
-  
-  // Function definition for the Frame Received function.
-  typedef void (*frameReceivedFunction)(byte sequence, byte frameLength, byte* frame);
-  
-  // Set the Frame Received Callback
-  void setFrameReceivedCallback(frameReceivedFunction frameReceived);
-  
-  // Set the Buffer Allocation Callback
-  void setBufferAllocationCallback(frameBufferAllocationFunction frameBufferAllocation);
-  
-  // Send a two byte frame notifying caller that something improper occured
-  void sendError(byte eventId);
-  
-  // Send a string message
-  void sendMessage(String message);
-  
-  // Send a frame of data returning the sequence id
-  byte sendFrame(byte* frame, byte frameLength);
-  
-  // Reset the communications protocol (zero the sequence numbers & flush the communications buffers) 
-  void reset();
-  
-  // Setup the communications protocol, to be called in Arduino setup()
-  void setup(int speed);
-  
-  // Service the incoming communications data, to be called in Arduino loop()
-  void loop();
-  
-  // Millisecond counter for last time a frame was received.  Can be used to implement a 'deadman switch' when
-  // communications with a host PC are lost or interrupted.
-  extern uint32_t lastFrameReceived;
-};
-
+/*
+ReflectaFramesSerial.h - Library for sending frames of information from a Microcontroller to a PC over a serial port.
+*/
+
+#include <Arduino.h>
+
+#ifndef REFLECTA_FRAMES_H
+#define REFLECTA_FRAMES_H
+
+// Frames taken, acknowledged to the PC (FRAMES_RELIABLE)
+#define FRAMES_ACK                      0x7A
+
+// An error occurred when parsing a data packet into the Reflecta protocol 
+#define FRAMES_MESSAGE                  0x7E
+#define FRAMES_ERROR                    0x7F
+
+// Types of parsing errors detected by Reflecta Frames
+#define FRAMES_WARNING_OUT_OF_SEQUENCE  0x00
+#define FRAMES_ERROR_UNEXPECTED_ESCAPE  0x01
+#define FRAMES_ERROR_CRC_MISMATCH       0x02
+#define FRAMES_ERROR_UNEXPECTED_END     0x03
+#define FRAMES_ERROR_BUFFER_OVERFLOW    0x04
+#define FRAMES_ERROR_TX_OVERFLOW        0x05 // frames refused for want of room in the TX ring (see txRefused)
+
+// Outgoing frames are queued, SLIP escaped, in a ring of this many bytes and written out as the serial port
+// has room for them (by sendFrame and loop()), rather than byte by byte, waiting whenever the port's own
+// buffer is full.  0 to write them out at once as before.
+#define FRAMES_TX_RING                  128
+
+// Frames that don't fit in the ring are refused (and counted in txDropped); sendFrame sets txRefused, and
+// once there's room again a FRAMES_ERROR_TX_OVERFLOW error frame goes up ahead of anything else.  Define
+// this to drop those queued longest (but not yet begun) to make room for them instead.  Either way the PC
+// sees the gap in sequence numbers.
+//#define FRAMES_TX_DROP_OLDEST
+
+// Incoming bytes are taken from the serial port in blocks of up to this many (on the stack) and decoded a
+// run at a time.
+#define FRAMES_RX_BLOCK                 32
+
+// Define this for acknowledged delivery of frames from the PC.  Frames are taken strictly in sequence; any
+// other (following a gap, or sent again once already taken) is dropped rather than warned of.  Those taken
+// are acknowledged together, a FRAMES_ACK frame (sequence number of the last taken, window) at the end of
+// loop().  The first dropped is acknowledged at once likewise, the PC going back to send again from the first
+// unacknowledged; and again every FRAMES_ACK_TIMEOUT milliseconds that nothing arrives while dropping.  The
+// PC may send up to FRAMES_WINDOW frames ahead of acknowledgement (see reflectaHost::Reliable on the host).
+//#define FRAMES_RELIABLE
+#define FRAMES_WINDOW                   4
+#define FRAMES_ACK_TIMEOUT              20
+
+namespace reflectaFrames
+{
+  // Function definition for Frame Buffer Allocation function, to be optionally implemented by
+  // the calling library or application.  Frames are delimited by END alone, so may be of any length the
+  // buffer allows (up to 65535 bytes).
+  typedef uint16_t (*frameBufferAllocationFunction)(byte** frameBuffer);
+  
+  // Function definition for the Frame Received function.
+  typedef void (*frameReceivedFunction)(byte sequence, uint16_t frameLength, byte* frame);
+  
+  // Set the Frame Received Callback
+  void setFrameReceivedCallback(frameReceivedFunction frameReceived);
+  
+  // Set the Buffer Allocation Callback
+  void setBufferAllocationCallback(frameBufferAllocationFunction frameBufferAllocation);
+  
+  // Send a two byte frame notifying caller that something improper occured
+  void sendError(byte eventId);
+  
+  // Send a string message
+  void sendMessage(String message);
+  
+  // Send a frame of data returning the sequence id.  With the TX ring, the frame may be refused rather than
+  // queued (the sequence id used all the same); txRefused tells whether it was.
+  byte sendFrame(byte* frame, uint16_t frameLength);
+  
+  // Reset the communications protocol (zero the sequence numbers & flush the communications buffers) 
+  void reset();
+  
+  // Setup the communications protocol, to be called in Arduino setup()
+  void setup(int speed);
+  
+  // Service the incoming communications data, to be called in Arduino loop()
+  void loop();
+  
+  // Millisecond counter for last time a frame was received.  Can be used to implement a 'deadman switch' when
+  // communications with a host PC are lost or interrupted.
+  extern uint32_t lastFrameReceived;
+
+#if FRAMES_TX_RING > 0
+  // Most bytes queued in the ring at once, and frames refused or dropped for want of room, since setup.
+  extern uint16_t txHighWater;
+  extern uint16_t txDropped;
+  
+  // The last frame sent was refused for want of room in the ring (not queued; never with FRAMES_TX_DROP_OLDEST).
+  extern bool txRefused;
+#endif
+};
+
 #endif
\ No newline at end of file
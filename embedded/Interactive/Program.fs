@@ -159,9 +159,9 @@ let rec rep line =
                     reflecta := Some client
                     squirt true [|56uy|] // reset
                     client.ErrorReceived.Add(fun e -> printfn "Error: %s" e.Message)
-                    client.FrameReceived.Add(fun e ->
-                        let id = e.Frame.[0]
-                        let data = e.Frame.[1..]
+                    let rec event (frame : byte[]) =
+                        let id = frame.[0]
+                        let data = frame.[1..]
                         let toInt d =
                             match Array.length d with
                             | 0 -> 0s
@@ -180,7 +180,14 @@ let rec rep line =
                                 | 3uy -> "Data stack overflow"
                                 | 4uy -> "Out of memory"
                                 | _ -> "Unknown")
-                        | _ -> printfn "Event (%i): %A" e.Frame.[0] e.Frame.[1..])
+                        | 0xF6uy -> // events coalesced into one frame; ID, length, data of each
+                            let rec unbatch i =
+                                if i + 2 <= data.Length && i + 2 + int data.[i + 1] <= data.Length then
+                                    Array.append [|data.[i]|] data.[i + 2 .. i + 1 + int data.[i + 1]] |> event
+                                    unbatch (i + 2 + int data.[i + 1])
+                            unbatch 0
+                        | _ -> printfn "Event (%i): %A" frame.[0] frame.[1..]
+                    client.FrameReceived.Add(fun e -> event e.Frame)
                     rep' stack' t
                 | _ -> failwith "Malformed connect syntax - usage: '7 connect"
             | "disconnect" ->
@@ -512,6 +512,18 @@ namespace Microsoft.Robotics.Microcontroller
                                         ReadUnescaped(out b); // END
                                         LocalReset();
                                         break;
+                                    case 0xF6: // events coalesced into one frame (ID, length, data of each)
+                                        var batch = new List<byte>();
+                                        while (ReadUnescaped(out b))
+                                            batch.Add(b);
+                                        batch.RemoveAt(batch.Count - 1); // CRC
+                                        for (var i = 0; i + 2 <= batch.Count && i + 2 + batch[i + 1] <= batch.Count; i += 2 + batch[i + 1])
+                                        {
+                                            if (batch[i] == 0xFC)
+                                                throw new ProtocolException(string.Format("Remote - VM error ({0})", batch[i + 2]));
+                                            OnData(batch[i], batch.GetRange(i + 2, batch[i + 1]).ToArray());
+                                        }
+                                        break;
                                     default: // user event
                                         var data = new List<byte>();
                                         while (ReadUnescaped(out b))
@@ -25,7 +25,8 @@ namespace Microsoft.Robotics.Tests.Reflecta
         private ReadState _state = ReadState.WaitingForSequence; // protocol parser state
         private byte? _readSequence;
         private byte[] _frameBuffer;
-        private byte _frameIndex;
+        private const int MaxFrameLength = 65536;
+        private int _frameIndex;
 
         public ReflectaClient(string portName)
         {
@@ -148,7 +149,7 @@ namespace Microsoft.Robotics.Tests.Reflecta
             _writeChecksum = 0;
             WriteEscaped(_writeSequence++);
 
-            for (byte index = 0; index < frame.Length; index++)
+            for (int index = 0; index < frame.Length; index++)
             {
                 WriteEscaped(frame[index]);
             }
@@ -194,6 +195,12 @@ namespace Microsoft.Robotics.Tests.Reflecta
                             _state = ReadState.WaitingForBytecode;
                             break;
                         case ReadState.WaitingForBytecode:
+                            if (_frameIndex == _frameBuffer.Length && _frameBuffer.Length < MaxFrameLength)
+                            {
+                                // frames are delimited, not counted (up to 65535 bytes and checksum)
+                                Array.Resize(ref _frameBuffer, Math.Min(_frameBuffer.Length * 2, MaxFrameLength));
+                            }
+
                             if (_frameIndex == _frameBuffer.Length)
                             {
                                 if (ErrorReceived != null)